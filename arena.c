@@ -0,0 +1,115 @@
+// Per-line arena allocator
+// Chunks form a list that survives arena_reset(), which only rewinds to the
+// first chunk. Once the chunks have grown to fit the largest line seen,
+// reading and running a command makes no further calls to malloc.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+
+static size_t align_up(size_t size)
+{
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// new chunk linked in after the current one
+static struct arena_chunk *add_chunk(struct arena *a, size_t min_size)
+{
+    size_t size = a->current ? a->current->size * 2 : ARENA_CHUNK_SIZE;
+    while (size < min_size)
+    {
+        size *= 2;
+    }
+
+    struct arena_chunk *chunk = malloc(sizeof(struct arena_chunk) + size);
+    if (chunk == NULL)
+    {
+        perror("malloc() error");
+        exit(EXIT_FAILURE);
+    }
+    chunk->size = size;
+
+    if (a->current == NULL)
+    {
+        chunk->next = NULL;
+        a->head = chunk;
+    }
+    else
+    {
+        chunk->next = a->current->next;
+        a->current->next = chunk;
+    }
+    return chunk;
+}
+
+void *arena_alloc(struct arena *a, size_t size)
+{
+    size = align_up(size ? size : 1);
+    if (a->current == NULL || a->used + size > a->current->size)
+    {
+        // reuse the next chunk from an earlier line if it is big enough
+        struct arena_chunk *next = a->current ? a->current->next : a->head;
+        if (next == NULL || next->size < size)
+        {
+            next = add_chunk(a, size);
+        }
+        a->current = next;
+        a->used = 0;
+    }
+
+    void *p = a->current->data + a->used;
+    a->used += size;
+    return p;
+}
+
+void *arena_grow(struct arena *a, void *old, size_t old_size, size_t new_size)
+{
+    old_size = align_up(old_size);
+    new_size = align_up(new_size);
+
+    // the last allocation of the chunk can grow in place
+    if (old != NULL && (char *)old + old_size == a->current->data + a->used &&
+        a->used - old_size + new_size <= a->current->size)
+    {
+        a->used = a->used - old_size + new_size;
+        return old;
+    }
+
+    void *p = arena_alloc(a, new_size);
+    if (old != NULL)
+    {
+        memcpy(p, old, old_size < new_size ? old_size : new_size);
+    }
+    return p;
+}
+
+char *arena_strndup(struct arena *a, const char *s, size_t len)
+{
+    char *copy = arena_alloc(a, len + 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+void arena_reset(struct arena *a)
+{
+    a->current = a->head;
+    a->used = 0;
+}
+
+void arena_free(struct arena *a)
+{
+    struct arena_chunk *chunk = a->head;
+    while (chunk != NULL)
+    {
+        struct arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    a->head = NULL;
+    a->current = NULL;
+    a->used = 0;
+}
@@ -0,0 +1,43 @@
+// Per-line arena allocator
+// Everything a command line needs is bump-allocated here and released all
+// at once by arena_reset() before the next line is read.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+struct arena_chunk
+{
+    struct arena_chunk *next;
+    size_t size;
+    char data[];
+};
+
+struct arena
+{
+    struct arena_chunk *head;    // first chunk, kept across resets
+    struct arena_chunk *current; // chunk allocations come from
+    size_t used;                 // bytes used in the current chunk
+};
+
+#define ARENA_INIT {NULL, NULL, 0}
+
+// size bytes aligned for any type, exits the shell when memory runs out
+void *arena_alloc(struct arena *a, size_t size);
+
+// grow an allocation made last or elsewhere, the old block is not reused
+void *arena_grow(struct arena *a, void *old, size_t old_size, size_t new_size);
+
+// copy of the first len bytes of s, NUL terminated
+char *arena_strndup(struct arena *a, const char *s, size_t len);
+
+// release every allocation, the chunks are kept for the next line
+void arena_reset(struct arena *a);
+
+// return the chunks to the system
+void arena_free(struct arena *a);
+
+#endif
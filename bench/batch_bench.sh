@@ -0,0 +1,35 @@
+#!/bin/bash
+# Benchmark for script mode
+# Runs the same generated script through the batch reader (shell script.sh)
+# and through the interactive path (shell -i < script.sh) and reports lines
+# per second for both. The lines are builtins, so the shell itself is measured.
+#
+# usage: bench/batch_bench.sh [shell] [lines]
+
+SHELL_BIN=${1:-./bin/shell}
+LINES=${2:-200000}
+SCRIPT=$(mktemp)
+trap 'rm -f "$SCRIPT"' EXIT
+
+for ((i = 0; i < LINES / 4; i++)); do
+    printf 'pwd\ncd .\nhash\n# comment\n'
+done > "$SCRIPT"
+
+now() {
+    date +%s.%N
+}
+
+# run_mode <label> <command...>
+run_mode() {
+    local label=$1
+    shift
+    local start end
+    start=$(now)
+    "$@" > /dev/null 2>&1
+    end=$(now)
+    awk -v l="$label" -v n="$LINES" -v s="$start" -v e="$end" \
+        'BEGIN { printf "%-12s %10.0f lines/s (%.3f s)\n", l ":", n / (e - s), e - s }'
+}
+
+run_mode "batch" "$SHELL_BIN" "$SCRIPT"
+run_mode "interactive" sh -c "\"$SHELL_BIN\" -i < \"$SCRIPT\""
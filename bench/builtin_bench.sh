@@ -0,0 +1,40 @@
+#!/bin/bash
+# Benchmark for the builtin registry
+# Runs a generated script of echo, printf, test and true lines, the kind
+# scripts repeat in loops, through the shell and through bash, and reports
+# lines per second. Pass an older shell as the second argument to compare
+# with one that started the external commands instead.
+#
+# usage: bench/builtin_bench.sh [shell] [other shell] [lines]
+
+SHELL_BIN=${1:-./bin/shell}
+OTHER_BIN=$2
+LINES=${3:-200000}
+SCRIPT=$(mktemp)
+trap 'rm -f "$SCRIPT"' EXIT
+
+for ((i = 0; i < LINES / 4; i++)); do
+    printf "echo line %d\nprintf '%%s=%%d\\\\n' count %d\ntest -n word\ntrue\n" "$i" "$i"
+done > "$SCRIPT"
+
+now() {
+    date +%s.%N
+}
+
+# run_mode <label> <command...>
+run_mode() {
+    local label=$1
+    shift
+    local start end
+    start=$(now)
+    "$@" > /dev/null 2>&1
+    end=$(now)
+    awk -v l="$label" -v n="$LINES" -v s="$start" -v e="$end" \
+        'BEGIN { printf "%-8s %10.0f lines/s (%.3f s)\n", l ":", n / (e - s), e - s }'
+}
+
+run_mode "shell" "$SHELL_BIN" "$SCRIPT"
+run_mode "bash" bash "$SCRIPT"
+if [ -n "$OTHER_BIN" ]; then
+    run_mode "other" "$OTHER_BIN" "$SCRIPT"
+fi
@@ -0,0 +1,111 @@
+// Benchmark for tab completion
+// Fills a directory with many files (200000 by default) and times one
+// completion keystroke in it: the first one, which reads and sorts the
+// listing, and the ones after it, which only search it. Then the same after
+// a cd, when the listing is loaded in the background while the user types.
+// Command name completion from $PATH is timed the same way.
+// The directory is kept between runs, pass a path to reuse it.
+//
+// build: gcc -O2 -I. bench/complete_bench.c complete.c vars.c glob.c arena.c -pthread -o bin/complete_bench
+// usage: bin/complete_bench [files] [dir]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "complete.h"
+#include "vars.h"
+
+#define KEYSTROKES 1000
+#define TYPING_MS 300 // from cd to the first Tab
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// time one completion of line, returns ms
+static double complete_once(const char *line, size_t *total)
+{
+    struct completion c;
+    memset(&c, 0, sizeof(c));
+    double start = now_ms();
+    complete_line(line, strlen(line), strlen(line), &c);
+    double elapsed = now_ms() - start;
+    *total = c.total;
+    return elapsed;
+}
+
+static void report(const char *label, const char **lines, int count)
+{
+    size_t total;
+    double first = complete_once(lines[0], &total);
+    double sum = 0, max = 0;
+    for (int i = 0; i < KEYSTROKES; i++)
+    {
+        double ms = complete_once(lines[i % count], &total);
+        sum += ms;
+        max = ms > max ? ms : max;
+    }
+    printf("%-22s first %8.3f ms, then mean %6.3f ms, max %6.3f ms\n", label, first, sum / KEYSTROKES, max);
+}
+
+int main(int argc, char **argv)
+{
+    // PATH is read from the shell variables
+    extern char **environ;
+    vars_init(environ);
+
+    int files = argc > 1 ? atoi(argv[1]) : 200000;
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s", argc > 2 ? argv[2] : "/tmp/complete_bench");
+    snprintf(dir + strlen(dir), sizeof(dir) - strlen(dir), ".%d", files);
+
+    struct stat st;
+    if (stat(dir, &st) == -1)
+    {
+        printf("creating %d files in %s\n", files, dir);
+        if (mkdir(dir, 0777) == -1)
+        {
+            perror("mkdir() error");
+            return 1;
+        }
+        for (int i = 0; i < files; i++)
+        {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/file_%07d.txt", dir, i);
+            int fd = open(path, O_WRONLY | O_CREAT, 0666);
+            if (fd == -1)
+            {
+                perror("open() error");
+                return 1;
+            }
+            close(fd);
+        }
+    }
+    if (chdir(dir) == -1)
+    {
+        perror("chdir() error");
+        return 1;
+    }
+
+    // prefixes matching everything, a block of files and a single one
+    const char *file_lines[] = {"cat file_01", "cat file_", "cat file_0012345", "cat file_0199", "cat nothing"};
+    const char *command_lines[] = {"gr", "l", "ca", "zzz"};
+    report("files, cold", file_lines, 5);
+    report("commands, cold", command_lines, 4);
+
+    // as a line editing shell does it: load ahead, then again on cd
+    complete_prefetch();
+    usleep(TYPING_MS * 1000);
+    complete_forget_cwd();
+    usleep(TYPING_MS * 1000);
+    report("files, after cd", file_lines, 5);
+    report("commands, loaded ahead", command_lines, 4);
+    return 0;
+}
@@ -0,0 +1,57 @@
+#!/bin/bash
+# Benchmark for the builtin cat, head and wc
+# First a generated script that calls them on a small file over and over,
+# as scripts do, through the shell and through bash, which starts the
+# coreutils each time. Then their throughput on one large file next to
+# coreutils. Pass an older shell as the second argument to compare with one
+# that started the external commands.
+#
+# usage: bench/coreutils_bench.sh [shell] [other shell] [lines] [megabytes]
+
+SHELL_BIN=${1:-./bin/shell}
+OTHER_BIN=$2
+LINES=${3:-30000}
+MEGABYTES=${4:-512}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+seq 1 100 > "$DIR/small"
+for ((i = 0; i < LINES / 3; i++)); do
+    printf 'cat small\nhead -n 3 small\nwc -l small\n'
+done > "$DIR/script"
+# words and lines of varying length
+seq 1 5000000 | awk '{ printf "%s word%s%s", $1, (NR % 7 ? " " : "\n"), (NR % 3 ? "" : "\t") }' | head -c $((MEGABYTES << 20)) > "$DIR/large"
+
+now() {
+    date +%s.%N
+}
+
+# run_mode <label> <unit> <count> <command...>
+run_mode() {
+    local label=$1 unit=$2 count=$3
+    shift 3
+    local start end
+    start=$(now)
+    (cd "$DIR" && "$@" > /dev/null 2>&1)
+    end=$(now)
+    awk -v l="$label" -v u="$unit" -v n="$count" -v s="$start" -v e="$end" \
+        'BEGIN { printf "%-18s %10.0f %s (%.3f s)\n", l ":", n / (e - s), u, e - s }'
+}
+
+SHELL_BIN=$(realpath "$SHELL_BIN")
+run_mode "shell script" lines/s "$LINES" "$SHELL_BIN" script
+run_mode "bash script" lines/s "$LINES" bash script
+if [ -n "$OTHER_BIN" ]; then
+    run_mode "other script" lines/s "$LINES" "$(realpath "$OTHER_BIN")" script
+fi
+
+# warm the page cache, then the big file
+cat "$DIR/large" > /dev/null
+run_mode "shell cat > file" MB/s "$MEGABYTES" "$SHELL_BIN" -c 'cat large > copy'
+run_mode "cat > file" MB/s "$MEGABYTES" sh -c 'cat large > copy'
+run_mode "shell cat | ..." MB/s "$MEGABYTES" sh -c "\"$SHELL_BIN\" -c 'cat large' | cat > /dev/null"
+run_mode "cat | ..." MB/s "$MEGABYTES" sh -c 'cat large | cat > /dev/null'
+run_mode "shell wc" MB/s "$MEGABYTES" "$SHELL_BIN" -c 'wc large'
+run_mode "wc" MB/s "$MEGABYTES" wc large
+run_mode "shell wc -m" MB/s "$MEGABYTES" "$SHELL_BIN" -c 'wc -m large'
+run_mode "wc -m" MB/s "$MEGABYTES" env LC_ALL=C.UTF-8 wc -m large
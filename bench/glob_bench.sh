@@ -0,0 +1,44 @@
+#!/bin/bash
+# Benchmark for pathname expansion
+# Builds an archive-like tree of directories full of .gz files and expands
+# patterns over it through the shell and through bash with globstar, with
+# the results going to true so only the expansion is timed.
+#
+# usage: bench/glob_bench.sh [shell] [directories] [files per directory]
+
+SHELL_BIN=${1:-./bin/shell}
+DIRS=${2:-200}
+FILES=${3:-1000}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+for ((d = 0; d < DIRS; d++)); do
+    mkdir -p "$DIR/logs/host$d/$((d % 12))"
+    (cd "$DIR/logs/host$d/$((d % 12))" && seq -f "%g.gz" 1 "$FILES" | xargs touch && touch notes.txt)
+done
+
+now() {
+    date +%s.%N
+}
+
+# run_mode <label> <matches> <command...>
+run_mode() {
+    local label=$1 count=$2
+    shift 2
+    local start end
+    start=$(now)
+    (cd "$DIR" && "$@" > /dev/null 2>&1)
+    end=$(now)
+    awk -v l="$label" -v n="$count" -v s="$start" -v e="$end" \
+        'BEGIN { printf "%-22s %10.0f matches/s (%.3f s)\n", l ":", n / (e - s), e - s }'
+}
+
+SHELL_BIN=$(realpath "$SHELL_BIN")
+ALL=$((DIRS * FILES))
+run_mode "shell logs/**/*.gz" "$ALL" "$SHELL_BIN" -c 'true logs/**/*.gz'
+run_mode "bash logs/**/*.gz" "$ALL" bash -O globstar -c 'true logs/**/*.gz'
+run_mode "shell logs/*/*/1*.gz" $((DIRS * (FILES / 9))) "$SHELL_BIN" -c 'true logs/*/*/1*.gz'
+run_mode "bash logs/*/*/1*.gz" $((DIRS * (FILES / 9))) bash -c 'true logs/*/*/1*.gz'
+# the same directories read for several patterns
+run_mode "shell 3 patterns" $((3 * DIRS)) "$SHELL_BIN" -c 'true logs/*/*/*.txt logs/*/*/99.gz logs/*/*/5.g?'
+run_mode "bash 3 patterns" $((3 * DIRS)) bash -c 'true logs/*/*/*.txt logs/*/*/99.gz logs/*/*/5.g?'
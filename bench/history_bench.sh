@@ -0,0 +1,43 @@
+#!/bin/bash
+# Benchmark for the history
+# Generates a history file with many lines (1M by default), then times
+# shell startup with it next to startup with an empty one, the first use of
+# the history, and a search once the index is built.
+# The file is kept between runs, pass a path to reuse it.
+#
+# usage: bench/history_bench.sh [shell] [entries] [file]
+
+SHELL_BIN=$(realpath "${1:-./bin/shell}")
+ENTRIES=${2:-1000000}
+FILE=${3:-/tmp/history_bench.$ENTRIES}
+
+if [ ! -f "$FILE" ]; then
+    echo "creating $ENTRIES history lines in $FILE"
+    seq -f 'git commit -m "change %g" && make -j8 test' 1 "$ENTRIES" > "$FILE"
+fi
+
+now() {
+    date +%s.%N
+}
+
+# run_mode <label> <history file> <input>
+run_mode() {
+    local label=$1 file=$2 input=$3
+    local copy start end
+    copy=$(mktemp)
+    cp "$file" "$copy"
+    start=$(now)
+    printf '%b' "$input" | SHELL_HISTFILE=$copy SHELL_HISTSIZE=$ENTRIES "$SHELL_BIN" -i > /dev/null 2>&1
+    end=$(now)
+    rm -f "$copy"
+    awk -v l="$label" -v s="$start" -v e="$end" 'BEGIN { printf "%-28s %8.3f ms\n", l ":", (e - s) * 1000 }'
+}
+
+EMPTY=$(mktemp)
+run_mode "startup, empty history" "$EMPTY" 'exit\n'
+run_mode "startup, $ENTRIES lines" "$FILE" 'exit\n'
+run_mode "first use (history 1)" "$FILE" 'history 1\nexit\n'
+# recent commands need a small part of the index, a miss needs all of it
+run_mode "100 searches, recent hits" "$FILE" "$(for i in $(seq 100); do printf '!?change %d\"?\\n' $((ENTRIES - i * 7)); done)exit\\n"
+run_mode "1 search, miss" "$FILE" '!?no such command?\nexit\n'
+rm -f "$EMPTY"
@@ -0,0 +1,105 @@
+// Benchmark for the process launcher
+// Launches a command over and over through launch_command, once with
+// posix_spawn and once with fork+exec, and reports commands per second.
+// A ballast allocation stands in for a shell with a large history and caches.
+//
+// build: gcc -O2 -I. bench/launch_bench.c launch.c redirect.c pathcache.c vars.c glob.c arena.c -o bin/launch_bench
+// usage: bin/launch_bench [-n runs] [-m ballast_mb] [command [args...]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "launch.h"
+#include "pathcache.h"
+#include "vars.h"
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// launch and reap the command n times, returns commands per second
+static double run(enum launch_mode mode, const char *path, char **args, int n)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+
+    double start = now_ms();
+    for (int i = 0; i < n; i++)
+    {
+        launch_mode = mode;
+        struct launch l = {path, args, -1, -1, -1, NULL, 0, &mask};
+        pid_t pid = launch_command(&l);
+        if (pid == -1)
+        {
+            perror(args[0]);
+            exit(EXIT_FAILURE);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+    }
+    double elapsed = now_ms() - start;
+    return n / (elapsed / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+    // commands get the environment of the benchmark
+    extern char **environ;
+    vars_init(environ);
+
+    int runs = 2000;
+    size_t ballast_mb = 256;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            runs = atoi(optarg);
+            break;
+        case 'm':
+            ballast_mb = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n runs] [-m ballast_mb] [command [args...]]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    char *default_args[] = {"true", NULL};
+    char **args = optind < argc ? &argv[optind] : default_args;
+
+    const char *path = path_lookup(args[0]);
+    if (path == NULL)
+    {
+        fprintf(stderr, "%s: command not found\n", args[0]);
+        return EXIT_FAILURE;
+    }
+
+    // touch every page so fork has real page tables to copy
+    size_t ballast_size = ballast_mb << 20;
+    char *ballast = malloc(ballast_size ? ballast_size : 1);
+    if (ballast == NULL)
+    {
+        perror("malloc() error");
+        return EXIT_FAILURE;
+    }
+    memset(ballast, 1, ballast_size);
+
+    double spawn_rate = run(LAUNCH_SPAWN, path, args, runs);
+    double fork_rate = run(LAUNCH_FORK, path, args, runs);
+
+    printf("command: %s, runs: %d, ballast: %zu MB\n", args[0], runs, ballast_mb);
+    printf("posix_spawn: %10.1f commands/s\n", spawn_rate);
+    printf("fork+exec:   %10.1f commands/s\n", fork_rate);
+    printf("speedup:     %10.2fx\n", spawn_rate / fork_rate);
+
+    free(ballast);
+    return 0;
+}
@@ -0,0 +1,155 @@
+// Benchmark for the lexer and parser
+// Tokenizes and parses every line of a corpus many times and reports MB/s.
+// Without a corpus file a mix of typical command lines is generated; a real
+// one can be made from a history file, e.g. cut -c8- ~/.bash_history.
+//
+// build: gcc -O2 -I. bench/lexer_bench.c lexer.c parser.c arena.c -o bin/lexer_bench
+// usage: bin/lexer_bench [-r repeats] [corpus]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "arena.h"
+#include "lexer.h"
+#include "parser.h"
+
+static const char *sample_lines[] = {
+    "ls -la /var/log",
+    "grep -rn \"TODO: fix\" src/ include/ | sort | uniq -c > todo.txt",
+    "cat access.log | awk '{print $1}' | sort | uniq -c | sort -rn | head -20",
+    "find . -name '*.o' -newer Makefile 2>/dev/null",
+    "tar czf backup-2024.tar.gz --exclude=node_modules project/ &",
+    "echo \"user=$USER home=\\\"$HOME\\\"\" >> env.log",
+    "gcc -O2 -Wall -Wextra -I include -o build/shell shell.c relay.c launch.c",
+    "ssh deploy@10.0.0.12 'systemctl restart app' < /dev/null",
+    "cut -d, -f2,5 data/2024-01-01.csv | sed 's/,/\\t/g' | wc -l",
+    "make -j8 2>build.err",
+    "make && ./run_tests || echo 'tests failed' >&2; rm -f *.o",
+    "{ date; uptime; df -h /; } > status.txt 2>&1",
+    "(cd build && cmake -DCMAKE_BUILD_TYPE=Release .. && make -j8) &",
+};
+
+static double now_s()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    int repeats = 200;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:")) != -1)
+    {
+        if (opt != 'r')
+        {
+            fprintf(stderr, "usage: %s [-r repeats] [corpus]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        repeats = atoi(optarg);
+    }
+
+    // load the corpus, or build one from the sample lines
+    char *corpus;
+    size_t size;
+    if (optind < argc)
+    {
+        FILE *f = fopen(argv[optind], "r");
+        if (f == NULL)
+        {
+            perror(argv[optind]);
+            return EXIT_FAILURE;
+        }
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        rewind(f);
+        corpus = malloc(size + 1);
+        size = fread(corpus, 1, size, f);
+        fclose(f);
+    }
+    else
+    {
+        size_t lines = 10000;
+        corpus = malloc(lines * 128);
+        size = 0;
+        for (size_t i = 0; i < lines; i++)
+        {
+            const char *line = sample_lines[i % (sizeof(sample_lines) / sizeof(sample_lines[0]))];
+            size += sprintf(corpus + size, "%s\n", line);
+        }
+    }
+    corpus[size] = '\0';
+
+    // split into lines once so only the lexer and parser are measured
+    size_t line_count = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        line_count += corpus[i] == '\n';
+    }
+    char **lines = malloc((line_count + 1) * sizeof(char *));
+    size_t *lengths = malloc((line_count + 1) * sizeof(size_t));
+    line_count = 0;
+    for (char *p = corpus, *nl; p < corpus + size; p = nl + 1)
+    {
+        nl = memchr(p, '\n', corpus + size - p);
+        if (nl == NULL)
+        {
+            nl = corpus + size;
+        }
+        lines[line_count] = p;
+        lengths[line_count++] = nl - p;
+    }
+
+    // syntax errors in a real corpus are expected, keep them off the terminal
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+
+    struct arena arena = ARENA_INIT;
+    long long tokens = 0;
+    double start = now_s();
+    for (int r = 0; r < repeats; r++)
+    {
+        for (size_t i = 0; i < line_count; i++)
+        {
+            struct token *list;
+            const char *error;
+            arena_reset(&arena);
+            int n = lex_line(&arena, lines[i], lengths[i], &list, &error);
+            tokens += n > 0 ? n : 0;
+        }
+    }
+    double lex_time = now_s() - start;
+
+    int errors = 0;
+    start = now_s();
+    for (int r = 0; r < repeats; r++)
+    {
+        for (size_t i = 0; i < line_count; i++)
+        {
+            struct node *tree;
+            struct redirect *heredocs;
+            arena_reset(&arena);
+            errors += parse_command(&arena, lines[i], lengths[i], &tree, &heredocs) != 0;
+        }
+    }
+    double parse_time = now_s() - start;
+
+    dup2(saved_stderr, STDERR_FILENO);
+
+    double mb = (double)size * repeats / (1024 * 1024);
+    printf("corpus: %zu lines, %zu bytes, %d repeats\n", line_count, size, repeats);
+    printf("lex:   %8.1f MB/s %12.0f lines/s %12.0f tokens/s\n", mb / lex_time, line_count * repeats / lex_time, tokens / lex_time);
+    printf("parse: %8.1f MB/s %12.0f lines/s (%d syntax errors per pass)\n", mb / parse_time, line_count * repeats / parse_time, errors / (repeats ? repeats : 1));
+
+    arena_free(&arena);
+    free(lines);
+    free(lengths);
+    free(corpus);
+    return 0;
+}
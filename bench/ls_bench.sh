@@ -0,0 +1,54 @@
+#!/bin/bash
+# Benchmark for the builtin ls
+# Generates a directory with many empty files (1M by default), then times
+# the shell's ls on it next to coreutils ls -l and reports entries per second.
+# The same number of files spread over 1000 directories times ls -R.
+# The directories are kept between runs, pass a path to reuse them.
+#
+# usage: bench/ls_bench.sh [shell] [entries] [directory]
+
+SHELL_BIN=$(realpath "${1:-./bin/shell}")
+ENTRIES=${2:-1000000}
+DIR=${3:-/tmp/ls_bench.$ENTRIES}
+
+if [ ! -d "$DIR" ]; then
+    echo "creating $ENTRIES files in $DIR"
+    mkdir -p "$DIR"
+    (cd "$DIR" && seq -f 'file%07g.txt' 1 "$ENTRIES" | xargs touch)
+fi
+
+TREE=$DIR.tree
+if [ ! -d "$TREE" ]; then
+    echo "creating $ENTRIES files in 1000 directories under $TREE"
+    for d in $(seq -f 'dir%03g' 0 999); do
+        mkdir -p "$TREE/${d:0:5}/$d"
+        (cd "$TREE/${d:0:5}/$d" && seq -f 'file%07g.txt' 1 $((ENTRIES / 1000)) | xargs touch)
+    done
+fi
+
+now() {
+    date +%s.%N
+}
+
+# run_mode <label> <command...>
+run_mode() {
+    local label=$1
+    shift
+    local start end
+    start=$(now)
+    (cd "$DIR" && "$@" > /dev/null)
+    end=$(now)
+    awk -v l="$label" -v n="$ENTRIES" -v s="$start" -v e="$end" \
+        'BEGIN { printf "%-14s %12.0f entries/s (%.3f s)\n", l ":", n / (e - s), e - s }'
+}
+
+# the first pass only warms the dentry and inode caches
+(cd "$DIR" && "$SHELL_BIN" -c ls > /dev/null)
+
+run_mode "shell ls" "$SHELL_BIN" -c ls
+run_mode "ls -l" ls -l --color=never
+
+DIR=$TREE
+(cd "$DIR" && "$SHELL_BIN" -c 'ls -R' > /dev/null)
+run_mode "shell ls -R" "$SHELL_BIN" -c 'ls -R'
+run_mode "ls -lR" ls -lR --color=never
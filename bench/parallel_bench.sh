@@ -0,0 +1,34 @@
+#!/bin/bash
+# Benchmark for the parallel builtin
+# Runs many short jobs (2000 by default) with the shell's parallel next to
+# xargs -P, which runs them the same way but lets their output interleave,
+# and GNU parallel when it is installed. Reports jobs per second.
+#
+# usage: bench/parallel_bench.sh [shell] [jobs] [parallel jobs]
+
+SHELL_BIN=$(realpath "${1:-./bin/shell}")
+JOBS=${2:-2000}
+WIDTH=${3:-$(nproc)}
+
+now() {
+    date +%s.%N
+}
+
+# run_mode <label> <command...>
+run_mode() {
+    local label=$1
+    shift
+    local start end
+    start=$(now)
+    seq "$JOBS" | "$@" > /dev/null
+    end=$(now)
+    awk -v l="$label" -v n="$JOBS" -v s="$start" -v e="$end" \
+        'BEGIN { printf "%-16s %8.0f jobs/s (%.3f s)\n", l ":", n / (e - s), e - s }'
+}
+
+run_mode "shell parallel" "$SHELL_BIN" -c "parallel -j $WIDTH echo job"
+run_mode "shell parallel -k" "$SHELL_BIN" -c "parallel -k -j $WIDTH echo job"
+run_mode "xargs -P" xargs -P "$WIDTH" -n 1 /bin/echo job
+if parallel --version 2> /dev/null | grep -q GNU; then
+    run_mode "GNU parallel" parallel -j "$WIDTH" echo job
+fi
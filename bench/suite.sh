@@ -0,0 +1,97 @@
+#!/bin/bash
+# Benchmark suite
+# Drives the shell non-interactively through generated scripts and reports
+# commands per second for an external true, for builtins, for builtins with
+# redirections and for background jobs, then the lexer's MB/s from
+# lexer_bench and entries per second for the builtin ls. The results go to a
+# JSON file, one result per line, stamped with the git version. With a
+# baseline, an earlier result file, the change of every result is printed.
+#
+# usage: bench/suite.sh [shell] [lexer_bench] [output.json] [baseline.json]
+#        COMMANDS=<n> ENTRIES=<n> to change the sizes
+
+SHELL_BIN=$(realpath -m "${1:-./build/release/shell}")
+LEXER_BENCH=${2:-./build/release/lexer_bench}
+OUT=${3:-build/bench.json}
+BASELINE=$4
+COMMANDS=${COMMANDS:-20000}
+ENTRIES=${ENTRIES:-100000}
+for bin in "$SHELL_BIN" "$LEXER_BENCH"; do
+    if [ ! -x "$bin" ]; then
+        echo "suite.sh: $bin not found, run make first" >&2
+        exit 1
+    fi
+done
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+now() {
+    date +%s.%N
+}
+
+RESULTS=()
+
+# result <name> <value> <unit>
+result() {
+    printf '%-12s %14.1f %s\n' "$1:" "$2" "$3"
+    RESULTS+=("$(printf '    "%s": {"value": %.1f, "unit": "%s"}' "$1" "$2" "$3")")
+}
+
+# run_script <name> <count> <line...>: the lines repeated up to count
+# commands, run as one script file
+run_script() {
+    local name=$1 count=$2
+    shift 2
+    local script=$WORK/$name.sh
+    for ((i = 0; i < count / $#; i++)); do
+        printf '%s\n' "$@"
+    done > "$script"
+    local start end
+    start=$(now)
+    (cd "$WORK" && "$SHELL_BIN" "$script" > /dev/null 2>&1)
+    end=$(now)
+    result "$name" "$(awk -v n="$count" -v s="$start" -v e="$end" 'BEGIN { print n / (e - s) }')" "commands/s"
+}
+
+run_script true "$COMMANDS" /bin/true
+run_script builtin "$COMMANDS" true 'echo line' 'test -n word' pwd
+run_script redirect "$COMMANDS" 'echo line > out' 'cat < out' 'echo line 2>> err >> out' 'true > /dev/null'
+# a wait per 100 jobs keeps the job table short
+run_script background "$COMMANDS" $(for ((i = 0; i < 99; i++)); do echo '/bin/true&'; done) wait
+
+# lex:  <MB/s> MB/s ...
+result lexer "$("$LEXER_BENCH" | awk '$1 == "lex:" { print $2 }')" "MB/s"
+
+mkdir "$WORK/ls"
+(cd "$WORK/ls" && seq -f 'file%07g.txt' 1 "$ENTRIES" | xargs touch)
+(cd "$WORK/ls" && "$SHELL_BIN" -c ls > /dev/null)
+start=$(now)
+(cd "$WORK/ls" && "$SHELL_BIN" -c ls > /dev/null)
+end=$(now)
+result ls "$(awk -v n="$ENTRIES" -v s="$start" -v e="$end" 'BEGIN { print n / (e - s) }')" "entries/s"
+
+mkdir -p "$(dirname "$OUT")"
+{
+    printf '{\n'
+    printf '  "version": "%s",\n' "$(git describe --always --dirty 2> /dev/null || echo unknown)"
+    printf '  "date": "%s",\n' "$(date -u +%Y-%m-%dT%H:%M:%SZ)"
+    printf '  "host": "%s",\n' "$(uname -nrm)"
+    printf '  "results": {\n'
+    for ((i = 0; i < ${#RESULTS[@]}; i++)); do
+        printf '%s%s\n' "${RESULTS[i]}" "$([ $i -lt $((${#RESULTS[@]} - 1)) ] && echo ,)"
+    done
+    printf '  }\n'
+    printf '}\n'
+} > "$OUT"
+echo "results written to $OUT"
+
+# every result is on a line of its own, so awk reads both files
+if [ -n "$BASELINE" ]; then
+    echo "change from $BASELINE:"
+    awk -F'"' '
+        /"value"/ { v = $5; gsub(/[ :,]/, "", v) }
+        /"value"/ && FNR == NR { base[$2] = v; next }
+        /"value"/ && ($2 in base) && base[$2] > 0 {
+            printf "%-12s %+7.1f%%\n", $2 ":", (v / base[$2] - 1) * 100
+        }' "$BASELINE" "$OUT"
+fi
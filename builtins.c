@@ -0,0 +1,80 @@
+// Builtin registry
+// A builtin runs inside the shell, so its redirections are applied to the
+// shell's own descriptors around the call, see redirect_save().
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "builtins.h"
+#include "redirect.h"
+#include "pathcache.h"
+#include "jobs.h"
+#include "usage.h"
+#include "history.h"
+#include "vars.h"
+#include "trace.h"
+#include "cmd/ls.h"
+#include "cmd/bench.h"
+#include "cmd/parallel.h"
+#include "cmd/echo.h"
+#include "cmd/printf.h"
+#include "cmd/test.h"
+#include "cmd/true.h"
+#include "cmd/cat.h"
+#include "cmd/head.h"
+#include "cmd/wc.h"
+
+static const struct builtin builtins[] = {
+#define BUILTIN(name, run, flags) {name, run, flags},
+#include "builtins.def"
+#undef BUILTIN
+};
+
+// made by bin/gen_builtins from builtins.def
+#include "builtins_table.h"
+
+_Static_assert(BUILTIN_COUNT == sizeof(builtins) / sizeof(builtins[0]), "builtins_table.h is out of date, run bin/gen_builtins");
+
+const struct builtin *builtin_lookup(const char *name)
+{
+    int i = builtin_slots[builtin_hash(name, BUILTIN_SEED) & (BUILTIN_SLOTS - 1)];
+    return i != -1 && strcmp(builtins[i].name, name) == 0 ? &builtins[i] : NULL;
+}
+
+int builtin_call(const struct builtin *b, char **args)
+{
+    int status = b->run(args);
+    // output that cannot be written is this builtin's failure, not the
+    // next command's, so it goes out and is checked right away
+    if (fflush(stdout) == EOF || ferror(stdout))
+    {
+        fprintf(stderr, "%s: write error: %s\n", b->name, strerror(errno));
+        clearerr(stdout);
+        status = 1;
+    }
+    return status;
+}
+
+int builtin_run(const struct builtin *b, const struct stage *stage)
+{
+    int count = redirect_count(stage->redirects);
+    if (count == 0)
+    {
+        return builtin_call(b, stage->args);
+    }
+
+    struct saved_fd saved[count];
+    int saved_count = redirect_save(stage->redirects, saved);
+    if (saved_count == -1)
+    {
+        return 1;
+    }
+    int status = builtin_call(b, stage->args);
+    redirect_restore(saved, saved_count);
+    return status;
+}
@@ -0,0 +1,55 @@
+// Builtin registry
+// Builtins are listed in builtins.def. tools/gen_builtins.c finds a seed
+// for which the hash below puts every name in a slot of its own, and writes
+// the table, so looking up argv[0] is one hash and one strcmp.
+
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <stdint.h>
+#include "parser.h"
+
+enum builtin_flags
+{
+    // changes the shell itself, so it runs in the shell even with &;
+    // without this flag, & runs the external command of the same name
+    BUILTIN_SHELL = 1,
+};
+
+struct builtin
+{
+    const char *name;
+    int (*run)(char **args);
+    unsigned flags;
+};
+
+// FNV-1a with the seed mixed into the basis, shared with the generator
+static inline uint32_t builtin_hash(const char *name, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++)
+    {
+        h = (h ^ *p) * 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+// the builtin called name, or NULL
+const struct builtin *builtin_lookup(const char *name);
+
+// run a builtin with args, then write out its output; a write that fails
+// is reported as the builtin's and makes its status 1
+int builtin_call(const struct builtin *b, char **args);
+
+// run a builtin in the shell with the stage's redirections applied, and
+// put the shell's descriptors back afterwards
+// returns its exit status, 1 when a redirection failed
+int builtin_run(const struct builtin *b, const struct stage *stage);
+
+// in shell.c, they change the state of the shell
+int cd_builtin(char **args);
+int pwd_builtin(char **args);
+int clear_builtin(char **args);
+int exit_builtin(char **args);
+
+#endif
@@ -0,0 +1,335 @@
+// implementation of bench command
+// Every run is started with launch_command like any other command, in the
+// shell's process group so Ctrl+C stops the run and the benchmark together.
+// Wall time is taken around the launch and wait4(), CPU time comes from the
+// rusage. With two commands the runs alternate, so a change in machine load
+// hits both alike, and the difference of the means gets a Welch t interval.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "bench.h"
+#include "../launch.h"
+#include "../pathcache.h"
+
+#define MAX_COMMANDS 2
+
+struct bench_command
+{
+    char **args;
+    const char *path;
+    double *wall; // ms, one per measured run
+    double *cpu;  // ms of user plus system time
+    int runs;
+};
+
+struct bench_stats
+{
+    double min;
+    double median;
+    double p95;
+    double p99;
+    double mean;
+    double stddev;
+};
+
+// 97.5% quantiles of Student's t for 1 to 30 degrees of freedom
+static const double t_quantiles[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+    2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+static double t_quantile(double df)
+{
+    if (df < 1)
+    {
+        df = 1;
+    }
+    if (df <= 30)
+    {
+        return t_quantiles[(int)df - 1];
+    }
+    // close enough to the real curve past 30, and 1.96 in the limit
+    return 1.96 + 2.46 / df;
+}
+
+static double elapsed_ms(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+// run the command once, returns its wait status or -1 if it did not start
+static int run_once(struct bench_command *c, int in, int out, const sigset_t *mask, double *wall, double *cpu)
+{
+    struct launch l = {c->path, c->args, in, out, -1, NULL, getpgrp(), mask};
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid_t pid = launch_command(&l);
+    if (pid == -1)
+    {
+        fprintf(stderr, "bench: %s: %s\n", c->args[0], strerror(errno));
+        return -1;
+    }
+
+    int status;
+    struct rusage r;
+    while (wait4(pid, &status, 0, &r) == -1 && errno == EINTR)
+        ;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    *wall = elapsed_ms(&start, &end);
+    *cpu = (r.ru_utime.tv_sec + r.ru_stime.tv_sec) * 1000.0 + (r.ru_utime.tv_usec + r.ru_stime.tv_usec) / 1000.0;
+    return status;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// linear interpolation between the closest ranks
+static double percentile(const double *sorted, int n, double p)
+{
+    double rank = p * (n - 1);
+    int low = (int)rank;
+    if (low + 1 >= n)
+    {
+        return sorted[n - 1];
+    }
+    return sorted[low] + (sorted[low + 1] - sorted[low]) * (rank - low);
+}
+
+static void compute_stats(const double *samples, int n, struct bench_stats *s)
+{
+    double *sorted = malloc(n * sizeof(double));
+    if (sorted == NULL)
+    {
+        perror("malloc() error");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(sorted, samples, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), compare_doubles);
+
+    double sum = 0, squares = 0;
+    for (int i = 0; i < n; i++)
+    {
+        sum += sorted[i];
+    }
+    s->mean = sum / n;
+    for (int i = 0; i < n; i++)
+    {
+        squares += (sorted[i] - s->mean) * (sorted[i] - s->mean);
+    }
+    s->stddev = n > 1 ? sqrt(squares / (n - 1)) : 0;
+    s->min = sorted[0];
+    s->median = percentile(sorted, n, 0.5);
+    s->p95 = percentile(sorted, n, 0.95);
+    s->p99 = percentile(sorted, n, 0.99);
+    free(sorted);
+}
+
+static void print_stats_row(const char *label, const double *samples, int n)
+{
+    struct bench_stats s;
+    compute_stats(samples, n, &s);
+    printf("  %-8s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", label, s.min, s.median, s.p95, s.p99, s.mean, s.stddev);
+}
+
+static void print_command(const char *prefix, char **args)
+{
+    printf("%s", prefix);
+    for (int i = 0; args[i] != NULL; i++)
+    {
+        printf("%s%s", i ? " " : "", args[i]);
+    }
+    printf("\n");
+}
+
+// second command against the first, with a 95% interval of the difference
+static void compare(const char *label, const double *a, const double *b, int n)
+{
+    struct bench_stats sa, sb;
+    compute_stats(a, n, &sa);
+    compute_stats(b, n, &sb);
+
+    double va = sa.stddev * sa.stddev / n, vb = sb.stddev * sb.stddev / n;
+    double diff = sb.mean - sa.mean;
+    double margin = 0;
+    if (n > 1 && va + vb > 0)
+    {
+        // Welch-Satterthwaite degrees of freedom
+        double df = (va + vb) * (va + vb) / (va * va / (n - 1) + vb * vb / (n - 1));
+        margin = t_quantile(df) * sqrt(va + vb);
+    }
+
+    double ratio = sa.mean > 0 ? sb.mean / sa.mean : 0;
+    bool significant = diff - margin > 0 || diff + margin < 0;
+    printf("  %-8s %.3fx %s, difference %+.3f ms, 95%% CI [%+.3f, %+.3f] ms%s\n", label, ratio >= 1 ? ratio : (ratio > 0 ? 1 / ratio : 0),
+           ratio >= 1 ? "slower" : "faster", diff, diff - margin, diff + margin, significant ? "" : " (not significant)");
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: bench [-n runs] [-w warmup] [-i] [-s] -- command [args] [-- command [args]]\n");
+}
+
+int bench_builtin(char **args)
+{
+    int runs = 10, warmup = 1;
+    bool ignore_failures = false, show_output = false;
+
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && strcmp(args[i], "--") != 0; i++)
+    {
+        if ((strcmp(args[i], "-n") == 0 || strcmp(args[i], "-w") == 0) && args[i + 1] != NULL)
+        {
+            int value = atoi(args[i + 1]);
+            if (value < (args[i][1] == 'n' ? 1 : 0))
+            {
+                fprintf(stderr, "bench: %s: invalid count '%s'\n", args[i], args[i + 1]);
+                return 2;
+            }
+            *(args[i][1] == 'n' ? &runs : &warmup) = value;
+            i++;
+        }
+        else if (strcmp(args[i], "-i") == 0)
+        {
+            ignore_failures = true;
+        }
+        else if (strcmp(args[i], "-s") == 0)
+        {
+            show_output = true;
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (args[i] != NULL && strcmp(args[i], "--") == 0)
+    {
+        i++;
+    }
+
+    // split the rest at each "--"
+    struct bench_command commands[MAX_COMMANDS];
+    int count = 0;
+    while (args[i] != NULL)
+    {
+        if (count == MAX_COMMANDS)
+        {
+            fprintf(stderr, "bench: at most %d commands\n", MAX_COMMANDS);
+            return 2;
+        }
+        commands[count].args = &args[i];
+        while (args[i] != NULL && strcmp(args[i], "--") != 0)
+        {
+            i++;
+        }
+        if (args[i] != NULL)
+        {
+            args[i++] = NULL;
+        }
+        // every command needs a name, -- -- is not one
+        if (commands[count++].args[0] == NULL)
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (count == 0)
+    {
+        usage();
+        return 2;
+    }
+
+    for (int c = 0; c < count; c++)
+    {
+        commands[c].path = path_lookup(commands[c].args[0]);
+        if (commands[c].path == NULL)
+        {
+            fprintf(stderr, "bench: %s: command not found\n", commands[c].args[0]);
+            return 1;
+        }
+        commands[c].wall = calloc(runs, sizeof(double));
+        commands[c].cpu = calloc(runs, sizeof(double));
+        commands[c].runs = 0;
+    }
+
+    // runs read nothing and, unless asked, show nothing
+    int null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    int out = show_output ? -1 : null_fd;
+    sigset_t mask;
+    sigprocmask(SIG_SETMASK, NULL, &mask);
+    fflush(stdout);
+
+    int result = 0;
+    for (int r = -warmup; r < runs && result == 0; r++)
+    {
+        for (int c = 0; c < count && result == 0; c++)
+        {
+            struct bench_command *cmd = &commands[c];
+            double wall, cpu;
+            int status = run_once(cmd, null_fd, out, &mask, &wall, &cpu);
+            if (status == -1)
+            {
+                result = 1;
+            }
+            else if (WIFSIGNALED(status) && WTERMSIG(status) == SIGINT)
+            {
+                fprintf(stderr, "bench: interrupted\n");
+                result = 128 + SIGINT;
+            }
+            else if (status != 0 && !ignore_failures)
+            {
+                fprintf(stderr, "bench: %s: exited with status %d, -i ignores failures\n", cmd->args[0],
+                        WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+                result = 1;
+            }
+            else if (r >= 0)
+            {
+                cmd->wall[cmd->runs] = wall;
+                cmd->cpu[cmd->runs] = cpu;
+                cmd->runs++;
+            }
+        }
+    }
+    close(null_fd);
+
+    if (result == 0)
+    {
+        for (int c = 0; c < count; c++)
+        {
+            char prefix[32];
+            snprintf(prefix, sizeof(prefix), "Benchmark %d: ", c + 1);
+            print_command(prefix, commands[c].args);
+            printf("  %d runs, %d warmup\n", runs, warmup);
+            printf("  %-8s %10s %10s %10s %10s %10s %10s\n", "ms", "min", "median", "p95", "p99", "mean", "stddev");
+            print_stats_row("wall", commands[c].wall, runs);
+            print_stats_row("cpu", commands[c].cpu, runs);
+        }
+        if (count == 2)
+        {
+            printf("Benchmark 2 against 1:\n");
+            compare("wall", commands[0].wall, commands[1].wall, runs);
+            compare("cpu", commands[0].cpu, commands[1].cpu, runs);
+        }
+    }
+
+    for (int c = 0; c < count; c++)
+    {
+        free(commands[c].wall);
+        free(commands[c].cpu);
+    }
+    return result;
+}
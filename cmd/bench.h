@@ -0,0 +1,13 @@
+// implementation of bench command
+#ifndef CMD_BENCH_H
+#define CMD_BENCH_H
+
+// bench [-n runs] [-w warmup] [-i] [-s] -- command [args] [-- command [args]]
+// runs each command repeatedly and prints min, median, p95, p99, mean and
+// standard deviation of its wall and CPU time; two commands are run in
+// turns and compared with a 95% confidence interval of the difference
+// -i keeps going when a run fails, -s shows the commands' output
+// returns 0, 1 when a command failed, 2 on bad usage
+int bench_builtin(char **args);
+
+#endif
@@ -0,0 +1,185 @@
+// implementation of cat command
+// The data does not pass through the shell when the kernel can move it:
+// copy_file_range between regular files, which can share extents on
+// filesystems that support it, sendfile from a regular file to anything,
+// and splice when either end is a pipe. Each falls back to the next when
+// the kernel or the filesystem refuses, and read/write comes last. All of
+// them move the file offsets, so a fallback carries on where the last one
+// stopped.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include "cat.h"
+
+#define COPY_CHUNK (1 << 30)  // bytes asked for per call
+#define COPY_BUFFER (1 << 17) // for read/write
+
+enum copy_method
+{
+    COPY_RANGE,
+    COPY_SENDFILE,
+    COPY_SPLICE,
+    COPY_READ,
+};
+
+// errors meaning the method does not apply to these descriptors
+static bool unsupported(int err)
+{
+    return err == EINVAL || err == EXDEV || err == ENOSYS || err == EOPNOTSUPP || err == EBADF || err == ESPIPE;
+}
+
+static ssize_t copy_chunk(enum copy_method method, int in, int out)
+{
+    switch (method)
+    {
+    case COPY_RANGE:
+        return copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0);
+    case COPY_SENDFILE:
+        return sendfile(out, in, NULL, COPY_CHUNK);
+    default:
+        return splice(in, NULL, out, NULL, COPY_CHUNK, SPLICE_F_MOVE);
+    }
+}
+
+// copy in to out until the end of in
+// returns 0, or -1 with errno set; EINTR means Ctrl+C
+static int copy_fd(int in, int out, const char *name)
+{
+    struct stat in_st, out_st;
+    if (fstat(in, &in_st) == -1 || fstat(out, &out_st) == -1)
+    {
+        return -1;
+    }
+    bool in_file = S_ISREG(in_st.st_mode);
+    bool out_file = S_ISREG(out_st.st_mode);
+    bool pipes = S_ISFIFO(in_st.st_mode) || S_ISFIFO(out_st.st_mode);
+    if (in_file && out_file && in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino && in_st.st_size > 0)
+    {
+        fprintf(stderr, "cat: %s: input file is output file\n", name);
+        errno = 0;
+        return -1;
+    }
+
+    // files in /proc and /sys claim to be empty, only read sees their data
+    enum copy_method method = COPY_READ;
+    if (in_file && in_st.st_size > 0)
+    {
+        method = out_file ? COPY_RANGE : COPY_SENDFILE;
+    }
+    else if (pipes)
+    {
+        method = COPY_SPLICE;
+    }
+
+    while (method != COPY_READ)
+    {
+        ssize_t n = copy_chunk(method, in, out);
+        if (n > 0)
+        {
+            continue;
+        }
+        if (n == 0)
+        {
+            return 0;
+        }
+        if (!unsupported(errno))
+        {
+            return -1;
+        }
+        // the next method that applies
+        if (method == COPY_RANGE)
+        {
+            method = COPY_SENDFILE;
+        }
+        else if (method == COPY_SENDFILE && pipes)
+        {
+            method = COPY_SPLICE;
+        }
+        else
+        {
+            method = COPY_READ;
+        }
+    }
+
+    static char buf[COPY_BUFFER];
+    ssize_t n;
+    while ((n = read(in, buf, sizeof(buf))) > 0)
+    {
+        for (ssize_t done = 0; done < n;)
+        {
+            ssize_t w = write(out, buf + done, n - done);
+            if (w == -1)
+            {
+                return -1;
+            }
+            done += w;
+        }
+    }
+    return n == 0 ? 0 : -1;
+}
+
+int cat_builtin(char **args)
+{
+    static char *from_stdin[] = {"-", NULL};
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++)
+    {
+        if (strcmp(args[i], "--") == 0)
+        {
+            i++;
+            break;
+        }
+        if (strcmp(args[i], "-u") != 0)
+        {
+            fprintf(stderr, "cat: invalid option '%s'\n", args[i]);
+            return 1;
+        }
+    }
+    char **files = args[i] != NULL ? &args[i] : from_stdin;
+
+    // what echo and printf left in the buffer goes first
+    fflush(stdout);
+
+    int status = 0;
+    for (; *files != NULL; files++)
+    {
+        bool is_stdin = strcmp(*files, "-") == 0;
+        int fd = is_stdin ? STDIN_FILENO : open(*files, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            fprintf(stderr, "cat: %s: %s\n", *files, strerror(errno));
+            status = 1;
+            continue;
+        }
+        int result = copy_fd(fd, STDOUT_FILENO, *files);
+        int err = errno;
+        if (!is_stdin)
+        {
+            close(fd);
+        }
+        if (result == -1 && err == EINTR)
+        {
+            return 130;
+        }
+        // a reader that went away is not worth a message
+        if (result == -1 && err != 0 && err != EPIPE)
+        {
+            fprintf(stderr, "cat: %s: %s\n", *files, strerror(err));
+        }
+        if (result == -1)
+        {
+            status = 1;
+            if (err == EPIPE)
+            {
+                break;
+            }
+        }
+    }
+    return status;
+}
@@ -0,0 +1,11 @@
+// implementation of cat command
+#ifndef CMD_CAT_H
+#define CMD_CAT_H
+
+// cat [-u] [file...]
+// each file in turn to stdout, stdin for - or when there are none; -u is
+// accepted, the output is never buffered
+// returns 0, 1 when a file could not be read or written
+int cat_builtin(char **args);
+
+#endif
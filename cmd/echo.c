@@ -0,0 +1,65 @@
+// implementation of echo command
+// Writes through stdio, so the words of one echo go out in a single write
+// when builtin_call() flushes it, which also reports a failed write.
+#include <stdio.h>
+#include <stdbool.h>
+#include "echo.h"
+#include "printf.h"
+
+// -n, -e, -E or a mix of them, anything else is printed
+static bool is_option(const char *arg)
+{
+    if (arg[0] != '-' || arg[1] == '\0')
+    {
+        return false;
+    }
+    for (const char *p = arg + 1; *p; p++)
+    {
+        if (*p != 'n' && *p != 'e' && *p != 'E')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int echo_builtin(char **args)
+{
+    bool newline = true;
+    bool escapes = false;
+    int i = 1;
+    for (; args[i] != NULL && is_option(args[i]); i++)
+    {
+        for (const char *p = args[i] + 1; *p; p++)
+        {
+            newline = newline && *p != 'n';
+            escapes = *p == 'e' || (escapes && *p != 'E');
+        }
+    }
+
+    for (; args[i] != NULL; i++)
+    {
+        if (escapes)
+        {
+            if (!print_escaped(args[i], stdout))
+            {
+                newline = false;
+                break;
+            }
+        }
+        else
+        {
+            fputs(args[i], stdout);
+        }
+        if (args[i + 1] != NULL)
+        {
+            putchar(' ');
+        }
+    }
+    if (newline)
+    {
+        putchar('\n');
+    }
+
+    return 0;
+}
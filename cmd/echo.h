@@ -0,0 +1,12 @@
+// implementation of echo command
+#ifndef CMD_ECHO_H
+#define CMD_ECHO_H
+
+// echo [-neE] [arg...]
+// the arguments separated by spaces and followed by a newline, none with
+// -n; -e turns backslash escapes into the characters they stand for, and
+// \c ends the output there
+// returns 0; builtin_call() makes it 1 when the output could not be written
+int echo_builtin(char **args);
+
+#endif
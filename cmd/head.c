@@ -0,0 +1,165 @@
+// implementation of head command
+// Lines are found with memchr over blocks of input and each block goes out
+// in one write. When the input can seek, whatever was read past the last
+// line is given back with lseek, so a script reading the same stdin carries
+// on right after it, as it would after coreutils head.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "head.h"
+
+#define HEAD_BUFFER (1 << 16)
+#define DEFAULT_LINES 10
+
+static int write_all(const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(STDOUT_FILENO, buf, len);
+        if (n == -1)
+        {
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// copy the first count lines, or bytes, of fd to stdout
+// returns 0, or -1 with errno set
+static int head_fd(int fd, long long count, bool bytes)
+{
+    static char buf[HEAD_BUFFER];
+    while (count > 0)
+    {
+        size_t want = bytes && count < HEAD_BUFFER ? (size_t)count : HEAD_BUFFER;
+        ssize_t n = read(fd, buf, want);
+        if (n <= 0)
+        {
+            return n;
+        }
+
+        size_t take = n;
+        if (bytes)
+        {
+            count -= n;
+        }
+        else
+        {
+            const char *p = buf, *end = buf + n;
+            const char *newline;
+            while (count > 0 && (newline = memchr(p, '\n', end - p)) != NULL)
+            {
+                p = newline + 1;
+                count--;
+            }
+            take = count == 0 ? (size_t)(p - buf) : (size_t)n;
+        }
+        if (write_all(buf, take) == -1)
+        {
+            return -1;
+        }
+        if (take < (size_t)n)
+        {
+            // pipes cannot give it back, nobody else reads them after us
+            lseek(fd, (off_t)take - n, SEEK_CUR);
+        }
+    }
+    return 0;
+}
+
+// a count as given to -n or -c, -1 when it is not one
+static long long parse_count(const char *s)
+{
+    char *end;
+    errno = 0;
+    long long n = strtoll(s, &end, 10);
+    return end == s || *end != '\0' || errno != 0 || n < 0 ? -1 : n;
+}
+
+int head_builtin(char **args)
+{
+    static char *from_stdin[] = {"-", NULL};
+    long long count = DEFAULT_LINES;
+    bool bytes = false;
+
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++)
+    {
+        const char *value = NULL;
+        if (strcmp(args[i], "--") == 0)
+        {
+            i++;
+            break;
+        }
+        if (args[i][1] == 'n' || args[i][1] == 'c')
+        {
+            bytes = args[i][1] == 'c';
+            value = args[i][2] != '\0' ? args[i] + 2 : args[++i];
+        }
+        else if (args[i][1] >= '0' && args[i][1] <= '9')
+        {
+            bytes = false;
+            value = args[i] + 1;
+        }
+        else
+        {
+            fprintf(stderr, "head: invalid option '%s'\n", args[i]);
+            return 1;
+        }
+        count = value != NULL ? parse_count(value) : -1;
+        if (count == -1)
+        {
+            fprintf(stderr, "head: invalid number of %s: '%s'\n", bytes ? "bytes" : "lines", value != NULL ? value : "");
+            return 1;
+        }
+    }
+    char **files = args[i] != NULL ? &args[i] : from_stdin;
+    bool headers = files[0] != NULL && files[1] != NULL;
+
+    int status = 0;
+    for (int f = 0; files[f] != NULL; f++)
+    {
+        bool is_stdin = strcmp(files[f], "-") == 0;
+        int fd = is_stdin ? STDIN_FILENO : open(files[f], O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            fprintf(stderr, "head: cannot open '%s' for reading: %s\n", files[f], strerror(errno));
+            status = 1;
+            continue;
+        }
+        if (headers)
+        {
+            printf("%s==> %s <==\n", f > 0 ? "\n" : "", is_stdin ? "standard input" : files[f]);
+        }
+        // the data is written straight to the descriptor
+        fflush(stdout);
+
+        int result = head_fd(fd, count, bytes);
+        int err = errno;
+        if (!is_stdin)
+        {
+            close(fd);
+        }
+        if (result == -1 && err == EINTR)
+        {
+            return 130;
+        }
+        if (result == -1 && err == EPIPE)
+        {
+            return 1;
+        }
+        if (result == -1)
+        {
+            fprintf(stderr, "head: %s: %s\n", is_stdin ? "standard input" : files[f], strerror(err));
+            status = 1;
+        }
+    }
+    return status;
+}
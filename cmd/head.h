@@ -0,0 +1,12 @@
+// implementation of head command
+#ifndef CMD_HEAD_H
+#define CMD_HEAD_H
+
+// head [-n lines | -c bytes | -lines] [file...]
+// the first 10 lines of each file, or the first lines or bytes given, stdin
+// for - or when there are none; a header names each file when there are
+// several
+// returns 0, 1 when a file could not be read or written
+int head_builtin(char **args);
+
+#endif
@@ -1,51 +1,843 @@
 // implementation of ls command
+// Every directory is a node of a tree that a pool of threads works through
+// with per-thread task deques; a thread that runs dry steals from the
+// others. A directory is opened with openat() relative to its parent's
+// descriptor and its entries are statx'ed relative to its own, so no path is
+// built for the system calls. Large directories are split into chunks that
+// are stat'ed and formatted in parallel, each into its own buffer. The
+// calling thread prints the nodes in a fixed preorder as they complete and
+// helps with the tasks while it waits, so the output is the same on every
+// run. statx only asks for the fields that get printed and does not force a
+// sync with the server on network filesystems.
+#define _GNU_SOURCE
 #include <stdio.h>
-#include <dirent.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
 #include <sys/stat.h>
-#include <pwd.h>
-#include <grp.h>
+#include <sys/syscall.h>
+#include "ls.h"
+#include "../idcache.h"
 
-void ls()
+#define GETDENTS_BUFFER (1 << 20)
+#define STAT_CHUNK 512
+#define MAX_WORKERS 8
+#define FLUSH_SIZE (1 << 20)
+#define STATX_FIELDS (STATX_TYPE | STATX_MODE | STATX_UID | STATX_GID | STATX_SIZE | STATX_ATIME | STATX_MTIME)
+
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+enum ls_sort
+{
+    SORT_NAME,
+    SORT_TIME, // newest first
+    SORT_SIZE, // largest first
+    SORT_NONE, // directory order
+};
+
+struct ls_options
+{
+    bool all;       // -a
+    bool recursive; // -R
+    bool reverse;   // -r
+    enum ls_sort sort;
+    bool color;     // names are coloured, stdout is a terminal
+};
+
+// what gets printed about one entry
+struct ls_entry
+{
+    size_t name; // offset into the node's name pool
+    bool ok;     // statx succeeded
+    mode_t mode;
+    uid_t uid;
+    gid_t gid;
+    off_t size;
+    time_t mtime;
+    time_t atime;
+};
+
+// growable output buffer
+struct ls_output
+{
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+// one directory of the walk
+struct ls_node
+{
+    struct ls_node *parent;
+    char *name; // relative to the parent, or the path given for a root
+    int fd;     // AT_FDCWD for a root that is not a directory
+    int fd_refs; // the node itself and the children that have not opened yet
+    int error;   // errno when the directory could not be read
+
+    char *names; // every name, NUL terminated, back to back
+    size_t names_len;
+    struct ls_entry *entries;
+    size_t count;
+
+    struct ls_output *chunks;
+    size_t chunk_count;
+    size_t pending; // chunk tasks of the current phase still running
+
+    struct ls_node **children; // subdirectories in output order
+    size_t child_count;
+    bool done; // ready to print, guarded by the walk lock
+};
+
+enum ls_task_kind
+{
+    TASK_READ,   // open the directory and read its names
+    TASK_STAT,   // statx one chunk of entries
+    TASK_FORMAT, // format one chunk of entries
+};
+
+struct ls_task
+{
+    enum ls_task_kind kind;
+    struct ls_node *node;
+    size_t chunk;
+};
+
+// the owner pushes and pops at the tail, thieves take from the head
+struct ls_deque
+{
+    pthread_mutex_t lock;
+    struct ls_task *tasks;
+    size_t head;
+    size_t tail;
+    size_t cap;
+};
+
+// last formatted time, consecutive entries often share one
+struct time_cache
+{
+    time_t t;
+    char text[24];
+};
+
+// per thread formatting state
+struct ls_context
+{
+    struct time_cache mtime;
+    struct time_cache atime;
+
+    // last owner, to skip the shared cache's lock for runs of one owner
+    uid_t uid;
+    gid_t gid;
+    const char *user;
+    const char *group;
+};
+
+struct ls_walk
+{
+    struct ls_options options;
+    int workers; // including the printing thread, which is worker 0
+    struct ls_deque deques[MAX_WORKERS];
+    struct ls_context contexts[MAX_WORKERS];
+
+    // idle workers and the printer sleep on cond
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    long queued; // tasks pushed and not taken yet
+    bool shutdown;
+
+    // printer state
+    struct ls_output out;
+    bool printed; // a listing went out already, the next header needs a blank line
+    bool titled;  // the column titles went out, before the first listing
+};
+
+struct ls_worker_arg
+{
+    struct ls_walk *walk;
+    int id;
+};
+
+static void *grow(void *p, size_t *cap, size_t need, size_t size)
+{
+    if (need <= *cap)
+    {
+        return p;
+    }
+    size_t new_cap = *cap ? *cap : 64;
+    while (new_cap < need)
+    {
+        new_cap *= 2;
+    }
+    p = realloc(p, new_cap * size);
+    if (p == NULL)
+    {
+        perror("realloc() error");
+        exit(EXIT_FAILURE);
+    }
+    *cap = new_cap;
+    return p;
+}
+
+static void push_task(struct ls_walk *walk, int worker, struct ls_task task)
+{
+    struct ls_deque *d = &walk->deques[worker];
+    pthread_mutex_lock(&d->lock);
+    d->tasks = grow(d->tasks, &d->cap, d->tail + 1, sizeof(struct ls_task));
+    d->tasks[d->tail++] = task;
+    pthread_mutex_unlock(&d->lock);
+
+    pthread_mutex_lock(&walk->lock);
+    walk->queued++;
+    pthread_cond_signal(&walk->cond);
+    pthread_mutex_unlock(&walk->lock);
+}
+
+// newest task of our own deque, else the oldest of somebody else's
+static bool take_task(struct ls_walk *walk, int worker, struct ls_task *task)
+{
+    for (int i = 0; i < walk->workers; i++)
+    {
+        int victim = (worker + i) % walk->workers;
+        struct ls_deque *d = &walk->deques[victim];
+        pthread_mutex_lock(&d->lock);
+        if (d->head == d->tail)
+        {
+            pthread_mutex_unlock(&d->lock);
+            continue;
+        }
+        *task = victim == worker ? d->tasks[--d->tail] : d->tasks[d->head++];
+        if (d->head == d->tail)
+        {
+            d->head = d->tail = 0;
+        }
+        pthread_mutex_lock(&walk->lock);
+        walk->queued--;
+        pthread_mutex_unlock(&walk->lock);
+        pthread_mutex_unlock(&d->lock);
+        return true;
+    }
+    return false;
+}
+
+static void release_fd(struct ls_node *node)
 {
-    DIR *dir;
-    struct dirent *entry;
-    struct stat fileStat;
-    struct passwd *pw;
-    struct group *gr;
+    if (__atomic_sub_fetch(&node->fd_refs, 1, __ATOMIC_ACQ_REL) == 0 && node->fd >= 0)
+    {
+        close(node->fd);
+        node->fd = -1;
+    }
+}
 
-    dir = opendir(".");
-    if (dir == NULL)
+static void finish_node(struct ls_walk *walk, struct ls_node *node)
+{
+    free(node->names);
+    free(node->entries);
+    node->names = NULL;
+    node->entries = NULL;
+    release_fd(node);
+
+    pthread_mutex_lock(&walk->lock);
+    node->done = true;
+    pthread_cond_broadcast(&walk->cond);
+    pthread_mutex_unlock(&walk->lock);
+}
+
+// one task of the given kind per chunk, the first chunk on top
+static void push_chunks(struct ls_walk *walk, int worker, struct ls_node *node, enum ls_task_kind kind)
+{
+    node->pending = node->chunk_count;
+    for (size_t c = node->chunk_count; c-- > 0;)
     {
-        perror("opendir() error");
+        push_task(walk, worker, (struct ls_task){kind, node, c});
+    }
+}
+
+static void add_name(struct ls_node *node, size_t *names_cap, size_t *entries_cap, const char *name)
+{
+    size_t len = strlen(name) + 1;
+    node->names = grow(node->names, names_cap, node->names_len + len, 1);
+    node->entries = grow(node->entries, entries_cap, node->count + 1, sizeof(struct ls_entry));
+    memcpy(node->names + node->names_len, name, len);
+    node->entries[node->count++].name = node->names_len;
+    node->names_len += len;
+}
+
+// open the directory and read every name with large getdents64 batches
+static void read_node(struct ls_walk *walk, int worker, struct ls_node *node)
+{
+    size_t names_cap = 0, entries_cap = 0;
+    if (node->parent != NULL)
+    {
+        node->fd = openat(node->parent->fd, node->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        node->error = node->fd == -1 ? errno : 0;
+        release_fd(node->parent);
+    }
+    else
+    {
+        node->fd = open(node->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        node->error = node->fd == -1 ? errno : 0;
+        if (node->error == ENOTDIR)
+        {
+            // a file given on the command line is listed on its own
+            node->fd = AT_FDCWD;
+            node->error = 0;
+            add_name(node, &names_cap, &entries_cap, node->name);
+        }
+    }
+
+    if (node->fd == -1)
+    {
+        finish_node(walk, node);
         return;
     }
 
-    while ((entry = readdir(dir)) != NULL)
+    if (node->fd != AT_FDCWD)
     {
-        if (stat(entry->d_name, &fileStat) < 0)
+        char *buf = malloc(GETDENTS_BUFFER);
+        long n = -1;
+        while (buf != NULL && (n = syscall(SYS_getdents64, node->fd, buf, GETDENTS_BUFFER)) > 0)
+        {
+            for (long pos = 0; pos < n;)
+            {
+                struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + pos);
+                pos += d->d_reclen;
+                if (d->d_name[0] != '.' || walk->options.all)
+                {
+                    add_name(node, &names_cap, &entries_cap, d->d_name);
+                }
+            }
+        }
+        if (n == -1)
         {
-            perror("stat() error");
+            node->error = buf != NULL ? errno : ENOMEM;
+        }
+        free(buf);
+    }
+
+    node->chunk_count = (node->count + STAT_CHUNK - 1) / STAT_CHUNK;
+    node->chunks = calloc(node->chunk_count ? node->chunk_count : 1, sizeof(struct ls_output));
+    if (node->chunk_count == 0)
+    {
+        finish_node(walk, node);
+        return;
+    }
+    push_chunks(walk, worker, node, TASK_STAT);
+}
+
+static void stat_entry(struct ls_node *node, struct ls_entry *e)
+{
+    struct statx stx;
+    const char *name = node->names + e->name;
+    e->ok = statx(node->fd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, STATX_FIELDS, &stx) == 0;
+    if (!e->ok)
+    {
+        fprintf(stderr, "ls: cannot access '%s': %s\n", name, strerror(errno));
+        return;
+    }
+    e->mode = stx.stx_mode;
+    e->uid = stx.stx_uid;
+    e->gid = stx.stx_gid;
+    e->size = stx.stx_size;
+    e->mtime = stx.stx_mtime.tv_sec;
+    e->atime = stx.stx_atime.tv_sec;
+}
+
+// ties on time or size fall back to the name so the order is total
+static int compare_entries(const void *a, const void *b, void *arg)
+{
+    const struct ls_node *node = ((void **)arg)[0];
+    const struct ls_options *options = ((void **)arg)[1];
+    const struct ls_entry *x = a, *y = b;
+
+    int result;
+    if (options->sort == SORT_TIME && x->mtime != y->mtime)
+    {
+        result = x->mtime > y->mtime ? -1 : 1;
+    }
+    else if (options->sort == SORT_SIZE && x->size != y->size)
+    {
+        result = x->size > y->size ? -1 : 1;
+    }
+    else
+    {
+        result = strcmp(node->names + x->name, node->names + y->name);
+    }
+    return options->reverse ? -result : result;
+}
+
+static struct ls_node *new_child(struct ls_node *node, const char *name)
+{
+    struct ls_node *child = calloc(1, sizeof(struct ls_node));
+    node->children = realloc(node->children, (node->child_count + 1) * sizeof(struct ls_node *));
+    if (child == NULL || node->children == NULL || (child->name = strdup(name)) == NULL)
+    {
+        perror("malloc() error");
+        exit(EXIT_FAILURE);
+    }
+    child->parent = node;
+    child->fd = -1;
+    child->fd_refs = 1;
+    node->children[node->child_count++] = child;
+    return child;
+}
+
+// every entry has been stat'ed: sort, queue the subdirectories, then format
+static void stat_done(struct ls_walk *walk, int worker, struct ls_node *node)
+{
+    if (walk->options.sort != SORT_NONE)
+    {
+        void *arg[] = {node, &walk->options};
+        qsort_r(node->entries, node->count, sizeof(struct ls_entry), compare_entries, arg);
+    }
+
+    if (walk->options.recursive && node->fd != AT_FDCWD)
+    {
+        for (size_t i = 0; i < node->count; i++)
+        {
+            struct ls_entry *e = &node->entries[i];
+            const char *name = node->names + e->name;
+            if (e->ok && S_ISDIR(e->mode) && strcmp(name, ".") != 0 && strcmp(name, "..") != 0)
+            {
+                new_child(node, name);
+            }
+        }
+
+        // the children keep our descriptor open until they have opened theirs
+        __atomic_add_fetch(&node->fd_refs, node->child_count, __ATOMIC_ACQ_REL);
+
+        // pushed last to first, so this thread pops them in output order
+        for (size_t i = node->child_count; i-- > 0;)
+        {
+            push_task(walk, worker, (struct ls_task){TASK_READ, node->children[i], 0});
+        }
+    }
+
+    push_chunks(walk, worker, node, TASK_FORMAT);
+}
+
+static const char *format_time(struct time_cache *cache, time_t t)
+{
+    if (cache->t != t || cache->text[0] == '\0')
+    {
+        struct tm tm;
+        localtime_r(&t, &tm);
+        strftime(cache->text, sizeof(cache->text), "%b %d %Y %H:%M:%S", &tm);
+        cache->t = t;
+    }
+    return cache->text;
+}
+
+static void format_permissions(mode_t mode, char *permissions)
+{
+    permissions[0] = (S_ISDIR(mode)) ? 'd' : (S_ISLNK(mode)) ? 'l' : '-';
+    permissions[1] = (mode & S_IRUSR) ? 'r' : '-';
+    permissions[2] = (mode & S_IWUSR) ? 'w' : '-';
+    permissions[3] = (mode & S_IXUSR) ? 'x' : '-';
+    permissions[4] = (mode & S_IRGRP) ? 'r' : '-';
+    permissions[5] = (mode & S_IWGRP) ? 'w' : '-';
+    permissions[6] = (mode & S_IXGRP) ? 'x' : '-';
+    permissions[7] = (mode & S_IROTH) ? 'r' : '-';
+    permissions[8] = (mode & S_IWOTH) ? 'w' : '-';
+    permissions[9] = (mode & S_IXOTH) ? 'x' : '-';
+    permissions[10] = '\0';
+}
+
+// append formatted text, the buffer grows to fit
+static void output_printf(struct ls_output *o, size_t max_len, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static void output_printf(struct ls_output *o, size_t max_len, const char *format, ...)
+{
+    o->data = grow(o->data, &o->cap, o->len + max_len, 1);
+    va_list ap;
+    va_start(ap, format);
+    int n = vsnprintf(o->data + o->len, max_len, format, ap);
+    va_end(ap);
+    o->len += (size_t)n < max_len ? (size_t)n : max_len - 1;
+}
+
+static const char *color_for(const char *name)
+{
+    // get file extension
+    const char *extension = strrchr(name, '.');
+    if (extension != NULL)
+    {
+        if (strcmp(extension, ".c") == 0 || strcmp(extension, ".cpp") == 0 || strcmp(extension, ".java") == 0 || strcmp(extension, ".py") == 0 || strcmp(extension, ".js") == 0 || strcmp(extension, ".php") == 0 || strcmp(extension, ".html") == 0 || strcmp(extension, ".css") == 0 || strcmp(extension, ".sh") == 0)
+        {
+            return "\033[0;32m"; // green
+        }
+        else if (strcmp(extension, ".h") == 0 || strcmp(extension, ".txt") == 0 || strcmp(extension, ".md") == 0 || strcmp(extension, ".json") == 0 || strcmp(extension, ".audio") == 0 || strcmp(extension, ".video") == 0)
+        {
+            return "\033[0;34m"; // blue
+        }
+        // Add more file extensions and color codes as needed
+    }
+    return "";
+}
+
+// one row of the table
+static void format_table(struct ls_node *node, struct ls_entry *e, struct ls_output *o, struct ls_context *ctx, bool color)
+{
+    if (!e->ok)
+    {
+        return;
+    }
+    const char *name = node->names + e->name;
+    char permissions[11];
+    format_permissions(e->mode, permissions);
+
+    if (ctx->user == NULL || ctx->uid != e->uid)
+    {
+        ctx->uid = e->uid;
+        ctx->user = user_name(e->uid);
+    }
+    if (ctx->group == NULL || ctx->gid != e->gid)
+    {
+        ctx->gid = e->gid;
+        ctx->group = group_name(e->gid);
+    }
+
+    // print file details in tabular format
+    output_printf(o, strlen(name) + strlen(ctx->user) + strlen(ctx->group) + 160, "%-10s %-10s %-10s %-10ld %-20s %-20s %s%s%s\n", permissions, ctx->user, ctx->group, (long)e->size,
+                  format_time(&ctx->mtime, e->mtime), format_time(&ctx->atime, e->atime), color ? color_for(name) : "", name, color ? "\033[0m" : "");
+}
+
+static void run_task(struct ls_walk *walk, int worker, struct ls_task *task)
+{
+    struct ls_node *node = task->node;
+    if (task->kind == TASK_READ)
+    {
+        read_node(walk, worker, node);
+        return;
+    }
+
+    size_t first = task->chunk * STAT_CHUNK;
+    size_t last = first + STAT_CHUNK < node->count ? first + STAT_CHUNK : node->count;
+    for (size_t i = first; i < last; i++)
+    {
+        if (task->kind == TASK_STAT)
+        {
+            stat_entry(node, &node->entries[i]);
+        }
+        else
+        {
+            format_table(node, &node->entries[i], &node->chunks[task->chunk], &walk->contexts[worker], walk->options.color);
+        }
+    }
+
+    // the last chunk of a phase moves the node on
+    if (__atomic_sub_fetch(&node->pending, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        if (task->kind == TASK_STAT)
+        {
+            stat_done(walk, worker, node);
+        }
+        else
+        {
+            finish_node(walk, node);
+        }
+    }
+}
+
+static void *ls_worker(void *arg)
+{
+    struct ls_worker_arg *w = arg;
+    struct ls_walk *walk = w->walk;
+    struct ls_task task;
+    while (true)
+    {
+        if (take_task(walk, w->id, &task))
+        {
+            run_task(walk, w->id, &task);
+            continue;
+        }
+
+        pthread_mutex_lock(&walk->lock);
+        while (walk->queued == 0 && !walk->shutdown)
+        {
+            pthread_cond_wait(&walk->cond, &walk->lock);
+        }
+        bool shutdown = walk->shutdown;
+        pthread_mutex_unlock(&walk->lock);
+        if (shutdown)
+        {
+            return NULL;
+        }
+    }
+}
+
+static int write_all(const char *p, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(STDOUT_FILENO, p, len);
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void flush_output(struct ls_walk *walk)
+{
+    write_all(walk->out.data, walk->out.len);
+    walk->out.len = 0;
+}
+
+// output is gathered and written about a megabyte at a time
+static void append(struct ls_walk *walk, const char *data, size_t len)
+{
+    if (walk->out.len > 0 && walk->out.len + len > FLUSH_SIZE)
+    {
+        flush_output(walk);
+    }
+    walk->out.data = grow(walk->out.data, &walk->out.cap, walk->out.len + len, 1);
+    memcpy(walk->out.data + walk->out.len, data, len);
+    walk->out.len += len;
+}
+
+// the printer runs tasks until the node is done
+static void wait_node(struct ls_walk *walk, struct ls_node *node)
+{
+    struct ls_task task;
+    pthread_mutex_lock(&walk->lock);
+    while (!node->done)
+    {
+        if (walk->queued == 0)
+        {
+            pthread_cond_wait(&walk->cond, &walk->lock);
             continue;
         }
+        pthread_mutex_unlock(&walk->lock);
+        if (take_task(walk, 0, &task))
+        {
+            run_task(walk, 0, &task);
+        }
+        pthread_mutex_lock(&walk->lock);
+    }
+    pthread_mutex_unlock(&walk->lock);
+}
+
+// print a node and then its subdirectories, path holds the node's path
+// for the header; returns false if a directory could not be read
+static bool print_node(struct ls_walk *walk, struct ls_node *node, char **path, size_t *path_cap, size_t path_len, bool header)
+{
+    wait_node(walk, node);
 
-        pw = getpwuid(fileStat.st_uid);
-        gr = getgrgid(fileStat.st_gid);
+    // a path that does not exist gets no header
+    bool missing = node->parent == NULL && node->error != 0;
+    if (!walk->titled && node->error == 0)
+    {
+        char titles[128];
+        int n = snprintf(titles, sizeof(titles), "%-10s %-10s %-10s %-10s %-20s %-20s %-20s\n", "Permissions", "User", "Group", "Size", "Modified", "Accessed", "File Name");
+        append(walk, titles, n);
+        walk->titled = true;
+    }
+    if (header && node->fd != AT_FDCWD && !missing)
+    {
+        if (walk->printed)
+        {
+            append(walk, "\n", 1);
+        }
+        append(walk, *path, path_len);
+        append(walk, ":\n", 2);
+    }
+    if (node->error != 0)
+    {
+        // keep the message in its place among the listings
+        flush_output(walk);
+        fprintf(stderr, "ls: cannot %s '%s': %s\n", missing ? "access" : "open directory", *path, strerror(node->error));
+    }
+    walk->printed |= !missing;
+    for (size_t c = 0; c < node->chunk_count; c++)
+    {
+        append(walk, node->chunks[c].data, node->chunks[c].len);
+        free(node->chunks[c].data);
+    }
+    free(node->chunks);
 
-        printf("%s\t", entry->d_name);
-        printf((S_ISDIR(fileStat.st_mode)) ? "d" : "-");
-        printf((fileStat.st_mode & S_IRUSR) ? "r" : "-");
-        printf((fileStat.st_mode & S_IWUSR) ? "w" : "-");
-        printf((fileStat.st_mode & S_IXUSR) ? "x" : "-");
-        printf((fileStat.st_mode & S_IRGRP) ? "r" : "-");
-        printf((fileStat.st_mode & S_IWGRP) ? "w" : "-");
-        printf((fileStat.st_mode & S_IXGRP) ? "x" : "-");
-        printf((fileStat.st_mode & S_IROTH) ? "r" : "-");
-        printf((fileStat.st_mode & S_IWOTH) ? "w" : "-");
-        printf((fileStat.st_mode & S_IXOTH) ? "x" : "-");
-        printf("\t%ld\t", fileStat.st_size);
-        printf("%s\t", pw->pw_name);
-        printf("%s\n", gr->gr_name);
+    bool ok = node->error == 0;
+    for (size_t i = 0; i < node->child_count; i++)
+    {
+        struct ls_node *child = node->children[i];
+        size_t len = path_len + 1 + strlen(child->name);
+        *path = grow(*path, path_cap, len + 1, 1);
+        sprintf(*path + path_len, "/%s", child->name);
+        ok &= print_node(walk, child, path, path_cap, len, true);
+        (*path)[path_len] = '\0';
+        free(child->name);
+        free(child);
     }
+    free(node->children);
+    return ok;
+}
 
-    closedir(dir);
+// returns the index of the first path, or -1 on a bad option
+static int parse_options(char **args, struct ls_options *options)
+{
+    memset(options, 0, sizeof(*options));
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++)
+    {
+        if (strcmp(args[i], "--") == 0)
+        {
+            return i + 1;
+        }
+        for (const char *p = args[i] + 1; *p; p++)
+        {
+            switch (*p)
+            {
+            case 'a':
+                options->all = true;
+                break;
+            case 'R':
+                options->recursive = true;
+                break;
+            case 'r':
+                options->reverse = true;
+                break;
+            case 't':
+                options->sort = SORT_TIME;
+                break;
+            case 'S':
+                options->sort = SORT_SIZE;
+                break;
+            case 'U':
+                options->sort = SORT_NONE;
+                break;
+            case 'l':
+                // the table is the long format already
+                break;
+            default:
+                fprintf(stderr, "ls: invalid option -- '%c'\n", *p);
+                fprintf(stderr, "usage: ls [-aRrtSU] [path...]\n");
+                return -1;
+            }
+        }
+    }
+    return i;
+}
+
+int ls_builtin(char **args)
+{
+    static char *dot[] = {".", NULL};
+    struct ls_walk walk;
+    memset(&walk, 0, sizeof(walk));
+    int first = parse_options(args, &walk.options);
+    if (first == -1)
+    {
+        return 2;
+    }
+    // colours only for a terminal, like ls --color=auto
+    walk.options.color = isatty(STDOUT_FILENO);
+    char **paths = args[first] != NULL ? &args[first] : dot;
+    int path_count = 0;
+    while (paths[path_count] != NULL)
+    {
+        path_count++;
+    }
+
+    pthread_mutex_init(&walk.lock, NULL);
+    pthread_cond_init(&walk.cond, NULL);
+    for (int i = 0; i < MAX_WORKERS; i++)
+    {
+        pthread_mutex_init(&walk.deques[i].lock, NULL);
+    }
+
+    // the roots are read here, which tells how much work a flat listing has
+    walk.workers = 1;
+    struct ls_node **roots = calloc(path_count, sizeof(struct ls_node *));
+    for (int i = 0; i < path_count; i++)
+    {
+        roots[i] = calloc(1, sizeof(struct ls_node));
+        if (roots[i] == NULL)
+        {
+            perror("malloc() error");
+            exit(EXIT_FAILURE);
+        }
+        roots[i]->name = paths[i];
+        roots[i]->fd = -1;
+        roots[i]->fd_refs = 1;
+        read_node(&walk, 0, roots[i]);
+    }
+
+    // one thread per core up to MAX_WORKERS, the calling thread included
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    long workers = cpus > 0 && cpus < MAX_WORKERS ? cpus : MAX_WORKERS;
+    if (!walk.options.recursive && walk.queued < workers)
+    {
+        workers = walk.queued > 0 ? walk.queued : 1;
+    }
+    // set before any thread starts, a worker that fails to start just
+    // leaves an empty deque behind
+    walk.workers = workers;
+    pthread_t threads[MAX_WORKERS];
+    struct ls_worker_arg worker_args[MAX_WORKERS];
+    int started = 1;
+    for (; started < workers; started++)
+    {
+        worker_args[started] = (struct ls_worker_arg){&walk, started};
+        if (pthread_create(&threads[started], NULL, ls_worker, &worker_args[started]) != 0)
+        {
+            break;
+        }
+    }
+
+    // anything the shell buffered goes before the listing
+    fflush(stdout);
+
+    char *path = NULL;
+    size_t path_cap = 0;
+    bool ok = true;
+    for (int i = 0; i < path_count; i++)
+    {
+        size_t len = strlen(roots[i]->name);
+        path = grow(path, &path_cap, len + 1, 1);
+        memcpy(path, roots[i]->name, len + 1);
+        ok &= print_node(&walk, roots[i], &path, &path_cap, len, walk.options.recursive || path_count > 1);
+        free(roots[i]);
+    }
+    flush_output(&walk);
+
+    pthread_mutex_lock(&walk.lock);
+    walk.shutdown = true;
+    pthread_cond_broadcast(&walk.cond);
+    pthread_mutex_unlock(&walk.lock);
+    for (int i = 1; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < MAX_WORKERS; i++)
+    {
+        free(walk.deques[i].tasks);
+        pthread_mutex_destroy(&walk.deques[i].lock);
+    }
+    pthread_mutex_destroy(&walk.lock);
+    pthread_cond_destroy(&walk.cond);
+    free(roots);
+    free(path);
+    free(walk.out.data);
+    return ok ? 0 : 1;
 }
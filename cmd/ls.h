@@ -0,0 +1,12 @@
+// implementation of ls command
+#ifndef CMD_LS_H
+#define CMD_LS_H
+
+// ls [-aRrtSU] [path...]
+// table of each path with permissions, owner, group, size and times, sorted
+// by name unless -t (newest first), -S (largest first) or -U (directory
+// order); -r reverses, -a shows hidden entries, -R descends into directories
+// returns 0, 1 when a directory could not be read, 2 on a bad option
+int ls_builtin(char **args);
+
+#endif
@@ -0,0 +1,591 @@
+// implementation of parallel command
+// Every job writes its stdout and stderr into memfds of its own, so jobs
+// never interleave their output. When a job ends both are copied out whole
+// with sendfile and emptied for the next job in the slot. Jobs are watched
+// through pidfds rather than SIGCHLD, so waiting for them cannot reap the
+// shell's other jobs, and wait4 collects each one's status.
+// Items come from the arguments after :::, from files after ::::, or from
+// stdin, and are read as jobs start, so a long list gets going at once.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "parallel.h"
+#include "../launch.h"
+#include "../pathcache.h"
+#include "../reader.h"
+
+#define MAX_FAILURES 101 // exit status caps here, like GNU parallel
+#define COPY_BUFFER (64 * 1024)
+
+// a job and the memfds its output goes to
+struct slot
+{
+    pid_t pid; // 0 while the slot is free
+    int pidfd; // -1 when pidfd_open is not supported
+    long seq;  // job number, from 1
+    int out;
+    int err;
+    struct timespec start;      // realtime, for the joblog
+    struct timespec start_mono; // for the run time
+    char *command;
+};
+
+// output of a job that ended before the ones in front of it, with -k
+struct parked_output
+{
+    long seq;
+    int out;
+    int err;
+    struct parked_output *next; // by seq
+};
+
+struct item_source
+{
+    char **items; // after :::
+    char **files; // after :::: or stdin, the ones not opened yet
+    struct reader reader;
+    bool reading;
+};
+
+struct run
+{
+    struct slot *slots;
+    int jobs;
+    bool keep_order;
+    long next_output; // job number whose output goes out next with -k
+    struct parked_output *parked;
+    int joblog; // -1 for none
+    int failed;
+    bool interrupted;
+};
+
+static void usage()
+{
+    fprintf(stderr, "usage: parallel [-j jobs] [-k] [--joblog file] command [args] [::: items... | :::: files...]\n");
+}
+
+// next item, valid until the next call, NULL when there are no more
+static char *next_item(struct item_source *src)
+{
+    if (src->items != NULL)
+    {
+        return *src->items != NULL ? *src->items++ : NULL;
+    }
+    while (true)
+    {
+        if (src->reading)
+        {
+            size_t len;
+            char *line = reader_line(&src->reader, &len);
+            if (line != NULL)
+            {
+                return line;
+            }
+            if (src->reader.fd != STDIN_FILENO)
+            {
+                close(src->reader.fd);
+            }
+            reader_close(&src->reader);
+            src->reading = false;
+        }
+        if (*src->files == NULL)
+        {
+            return NULL;
+        }
+
+        const char *name = *src->files++;
+        int fd = strcmp(name, "-") == 0 ? STDIN_FILENO : open(name, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            fprintf(stderr, "parallel: %s: %s\n", name, strerror(errno));
+            continue;
+        }
+        reader_open_fd(&src->reader, fd);
+        src->reading = true;
+    }
+}
+
+static bool has_placeholder(const char *arg)
+{
+    return strstr(arg, "{}") || strstr(arg, "{.}") || strstr(arg, "{/}") || strstr(arg, "{#}");
+}
+
+// arg with {} {.} {/} and {#} filled in, malloc'd
+static char *expand_arg(const char *arg, const char *item, long seq)
+{
+    const char *base = strrchr(item, '/');
+    base = base != NULL ? base + 1 : item;
+    const char *dot = strrchr(base, '.');
+    size_t stem = dot != NULL && dot != base ? (size_t)(dot - item) : strlen(item);
+    char number[24];
+    snprintf(number, sizeof(number), "%ld", seq);
+
+    size_t size = strlen(arg) + 1;
+    for (const char *p = arg; (p = strchr(p, '{')) != NULL; p++)
+    {
+        size += strlen(item) + sizeof(number);
+    }
+    char *out = malloc(size);
+    if (out == NULL)
+    {
+        perror("malloc() error");
+        exit(EXIT_FAILURE);
+    }
+
+    char *o = out;
+    for (const char *p = arg; *p;)
+    {
+        const char *with = NULL;
+        size_t with_len = 0, skip = 0;
+        if (strncmp(p, "{}", 2) == 0)
+        {
+            with = item, with_len = strlen(item), skip = 2;
+        }
+        else if (strncmp(p, "{.}", 3) == 0)
+        {
+            with = item, with_len = stem, skip = 3;
+        }
+        else if (strncmp(p, "{/}", 3) == 0)
+        {
+            with = base, with_len = strlen(base), skip = 3;
+        }
+        else if (strncmp(p, "{#}", 3) == 0)
+        {
+            with = number, with_len = strlen(number), skip = 3;
+        }
+        if (with == NULL)
+        {
+            *o++ = *p++;
+            continue;
+        }
+        memcpy(o, with, with_len);
+        o += with_len;
+        p += skip;
+    }
+    *o = '\0';
+    return out;
+}
+
+// the words joined by spaces, for the joblog and messages
+static char *join_args(char **args)
+{
+    size_t size = 1;
+    for (int i = 0; args[i] != NULL; i++)
+    {
+        size += strlen(args[i]) + 1;
+    }
+    char *joined = malloc(size);
+    if (joined == NULL)
+    {
+        perror("malloc() error");
+        exit(EXIT_FAILURE);
+    }
+    char *o = joined;
+    for (int i = 0; args[i] != NULL; i++)
+    {
+        o = stpcpy(o, args[i]);
+        *o++ = ' ';
+    }
+    o[o > joined ? -1 : 0] = '\0';
+    return joined;
+}
+
+static int new_memfd(const char *name)
+{
+    int fd = memfd_create(name, MFD_CLOEXEC);
+    if (fd == -1)
+    {
+        perror("memfd_create() error");
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+static off_t output_size(int fd)
+{
+    struct stat st;
+    return fstat(fd, &st) == 0 ? st.st_size : 0;
+}
+
+// copy everything a job wrote to a memfd out, then empty it; the children
+// share its offset, so that goes back to the start too
+static void flush_output(int from, int to)
+{
+    off_t size = output_size(from);
+    off_t off = 0;
+    while (off < size)
+    {
+        ssize_t n = sendfile(to, from, &off, size - off);
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n == -1 && errno == EINVAL)
+        {
+            // to is opened for appending, which sendfile refuses
+            char buf[COPY_BUFFER];
+            while (off < size && (n = pread(from, buf, sizeof(buf), off)) > 0)
+            {
+                if (write(to, buf, n) != n)
+                {
+                    break;
+                }
+                off += n;
+            }
+            break;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+    }
+    ftruncate(from, 0);
+    lseek(from, 0, SEEK_SET);
+}
+
+static void write_joblog(struct run *r, struct slot *s, int status)
+{
+    if (r->joblog == -1)
+    {
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double runtime = (now.tv_sec - s->start_mono.tv_sec) + (now.tv_nsec - s->start_mono.tv_nsec) / 1e9;
+    dprintf(r->joblog, "%ld\t:\t%ld.%03ld\t%.3f\t0\t%lld\t%d\t%d\t%s\n", s->seq, (long)s->start.tv_sec, s->start.tv_nsec / 1000000, runtime,
+            (long long)output_size(s->out), WIFEXITED(status) ? WEXITSTATUS(status) : -1, WIFSIGNALED(status) ? WTERMSIG(status) : 0,
+            s->command);
+}
+
+// show the job's output now, or with -k once the jobs before it showed theirs
+static void job_output(struct run *r, struct slot *s)
+{
+    if (!r->keep_order || s->seq == r->next_output)
+    {
+        flush_output(s->out, STDOUT_FILENO);
+        flush_output(s->err, STDERR_FILENO);
+        r->next_output++;
+    }
+    else
+    {
+        // keep the memfds for later and give the slot new ones
+        struct parked_output *p = malloc(sizeof(struct parked_output));
+        if (p == NULL)
+        {
+            perror("malloc() error");
+            exit(EXIT_FAILURE);
+        }
+        p->seq = s->seq;
+        p->out = s->out;
+        p->err = s->err;
+        struct parked_output **at = &r->parked;
+        while (*at != NULL && (*at)->seq < p->seq)
+        {
+            at = &(*at)->next;
+        }
+        p->next = *at;
+        *at = p;
+        s->out = new_memfd("parallel-out");
+        s->err = new_memfd("parallel-err");
+    }
+
+    while (r->parked != NULL && r->parked->seq == r->next_output)
+    {
+        struct parked_output *p = r->parked;
+        flush_output(p->out, STDOUT_FILENO);
+        flush_output(p->err, STDERR_FILENO);
+        close(p->out);
+        close(p->err);
+        r->parked = p->next;
+        free(p);
+        r->next_output++;
+    }
+}
+
+// record how the job ended and free its slot
+static void finish_job(struct run *r, struct slot *s, int status)
+{
+    if (status != 0)
+    {
+        r->failed++;
+    }
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGINT)
+    {
+        r->interrupted = true;
+    }
+    write_joblog(r, s, status);
+    job_output(r, s);
+    if (s->pidfd != -1)
+    {
+        close(s->pidfd);
+    }
+    free(s->command);
+    s->command = NULL;
+    s->pid = 0;
+}
+
+static void start_job(struct run *r, struct slot *s, char **template, bool append_item, const char *item, long seq, int null_fd,
+                      const sigset_t *mask)
+{
+    int count = 0;
+    while (template[count] != NULL)
+    {
+        count++;
+    }
+    char **args = calloc(count + 2, sizeof(char *));
+    if (args == NULL)
+    {
+        perror("calloc() error");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        args[i] = expand_arg(template[i], item, seq);
+    }
+    if (append_item)
+    {
+        args[count] = strdup(item);
+    }
+
+    s->seq = seq;
+    s->pidfd = -1;
+    s->command = join_args(args);
+    clock_gettime(CLOCK_REALTIME, &s->start);
+    clock_gettime(CLOCK_MONOTONIC, &s->start_mono);
+
+    const char *path = path_lookup(args[0]);
+    struct launch l = {path, args, null_fd, s->out, s->err, NULL, getpgrp(), mask};
+    s->pid = path != NULL ? launch_command(&l) : -1;
+    if (s->pid == -1)
+    {
+        dprintf(s->err, "parallel: %s: %s\n", args[0], path == NULL ? "command not found" : strerror(errno));
+        s->pid = 0;
+        finish_job(r, s, 127 << 8);
+    }
+    else
+    {
+#ifdef SYS_pidfd_open
+        s->pidfd = syscall(SYS_pidfd_open, s->pid, 0);
+#endif
+    }
+
+    for (int i = 0; args[i] != NULL; i++)
+    {
+        free(args[i]);
+    }
+    free(args);
+}
+
+static void reap(struct run *r, struct slot *s)
+{
+    int status;
+    while (waitpid(s->pid, &status, 0) == -1 && errno == EINTR)
+        ;
+    finish_job(r, s, status);
+}
+
+// wait until at least one running job ended
+static void wait_any(struct run *r)
+{
+    struct pollfd fds[r->jobs];
+    struct slot *polled[r->jobs];
+    int n = 0;
+    for (int i = 0; i < r->jobs; i++)
+    {
+        struct slot *s = &r->slots[i];
+        if (s->pid == 0)
+        {
+            continue;
+        }
+        if (s->pidfd == -1)
+        {
+            // no pidfds on this kernel, wait for this one alone
+            reap(r, s);
+            return;
+        }
+        fds[n] = (struct pollfd){s->pidfd, POLLIN, 0};
+        polled[n++] = s;
+    }
+
+    // Ctrl+C interrupts the poll, the jobs it killed show up in the next
+    while (poll(fds, n, -1) == -1 && errno == EINTR)
+        ;
+    for (int i = 0; i < n; i++)
+    {
+        if (fds[i].revents != 0)
+        {
+            reap(r, polled[i]);
+        }
+    }
+}
+
+int parallel_builtin(char **args)
+{
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    bool keep_order = false;
+    const char *joblog = NULL;
+
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-'; i++)
+    {
+        if (strncmp(args[i], "-j", 2) == 0)
+        {
+            const char *value = args[i][2] ? args[i] + 2 : args[++i];
+            jobs = value != NULL ? atol(value) : 0;
+            if (jobs < 1)
+            {
+                fprintf(stderr, "parallel: -j: invalid number of jobs\n");
+                return 255;
+            }
+        }
+        else if (strcmp(args[i], "-k") == 0)
+        {
+            keep_order = true;
+        }
+        else if (strcmp(args[i], "--joblog") == 0 && args[i + 1] != NULL)
+        {
+            joblog = args[++i];
+        }
+        else
+        {
+            usage();
+            return 255;
+        }
+    }
+
+    // the command runs up to ::: or ::::
+    char **template = &args[i];
+    static char *from_stdin[] = {"-", NULL};
+    struct item_source src = {NULL, from_stdin, {0}, false};
+    for (; args[i] != NULL; i++)
+    {
+        if (strcmp(args[i], ":::") == 0 || strcmp(args[i], "::::") == 0)
+        {
+            if (args[i][3] == ':')
+            {
+                src.files = &args[i + 1];
+            }
+            else
+            {
+                src.items = &args[i + 1];
+            }
+            args[i] = NULL;
+            break;
+        }
+    }
+    if (template[0] == NULL)
+    {
+        usage();
+        return 255;
+    }
+    bool append_item = true;
+    for (int t = 0; template[t] != NULL; t++)
+    {
+        append_item = append_item && !has_placeholder(template[t]);
+    }
+
+    struct run r = {NULL, (int)jobs, keep_order, 1, NULL, -1, 0, false};
+    if (joblog != NULL)
+    {
+        r.joblog = open(joblog, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (r.joblog == -1)
+        {
+            fprintf(stderr, "parallel: %s: %s\n", joblog, strerror(errno));
+            return 255;
+        }
+        dprintf(r.joblog, "Seq\tHost\tStarttime\tJobRuntime\tSend\tReceive\tExitval\tSignal\tCommand\n");
+    }
+    r.slots = calloc(r.jobs, sizeof(struct slot));
+    if (r.slots == NULL)
+    {
+        perror("calloc() error");
+        exit(EXIT_FAILURE);
+    }
+    for (int s = 0; s < r.jobs; s++)
+    {
+        r.slots[s].out = new_memfd("parallel-out");
+        r.slots[s].err = new_memfd("parallel-err");
+    }
+
+    // jobs read nothing, their stdin may be where the items come from
+    int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    sigset_t mask;
+    sigprocmask(SIG_SETMASK, NULL, &mask);
+    fflush(stdout);
+    fflush(stderr);
+
+    long seq = 0;
+    int running = 0;
+    bool more = true;
+    while (true)
+    {
+        for (int s = 0; s < r.jobs && more && !r.interrupted; s++)
+        {
+            if (r.slots[s].pid != 0)
+            {
+                continue;
+            }
+            char *item = next_item(&src);
+            if (item == NULL)
+            {
+                more = false;
+                break;
+            }
+            start_job(&r, &r.slots[s], template, append_item, item, ++seq, null_fd, &mask);
+        }
+
+        running = 0;
+        for (int s = 0; s < r.jobs; s++)
+        {
+            running += r.slots[s].pid != 0;
+        }
+        if (running == 0 && (!more || r.interrupted))
+        {
+            break;
+        }
+        if (running > 0)
+        {
+            wait_any(&r);
+        }
+    }
+
+    if (src.reading)
+    {
+        if (src.reader.fd != STDIN_FILENO)
+        {
+            close(src.reader.fd);
+        }
+        reader_close(&src.reader);
+    }
+    for (int s = 0; s < r.jobs; s++)
+    {
+        close(r.slots[s].out);
+        close(r.slots[s].err);
+    }
+    free(r.slots);
+    close(null_fd);
+    if (r.joblog != -1)
+    {
+        close(r.joblog);
+    }
+
+    if (r.interrupted)
+    {
+        fprintf(stderr, "parallel: interrupted\n");
+        return 128 + SIGINT;
+    }
+    return r.failed < MAX_FAILURES ? r.failed : MAX_FAILURES;
+}
@@ -0,0 +1,18 @@
+// implementation of parallel command
+#ifndef CMD_PARALLEL_H
+#define CMD_PARALLEL_H
+
+// parallel [-j jobs] [-k] [--joblog file] command [args] ::: items...
+// parallel [-j jobs] [-k] [--joblog file] command [args] :::: file...
+// parallel [-j jobs] [-k] [--joblog file] command [args] < items
+// runs the command once per item with at most jobs (the number of CPUs by
+// default) running at a time; {} in the arguments becomes the item, {.} the
+// item without its extension, {/} its last path component and {#} the job
+// number, and without any of them the item is added as the last argument
+// each job's output is shown in one piece when it ends, in the order of
+// the items with -k; --joblog records every job's exit status
+// returns the number of failed jobs up to 101, 130 when interrupted, 255
+// on bad usage
+int parallel_builtin(char **args);
+
+#endif
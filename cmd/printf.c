@@ -0,0 +1,382 @@
+// implementation of printf command
+// Each conversion of the format is copied into a small format of its own,
+// with * widths filled in and the length modifier for the argument's type
+// added, and handed to printf(3).
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include "printf.h"
+
+#define SPEC_SIZE 64
+#define SPEC_TAIL 4 // room kept for ll, the conversion and the terminator
+
+// state shared by the conversions of one printf
+struct format_args
+{
+    char **next; // arguments not used yet
+    bool used;   // the format used an argument in this pass
+    int status;
+};
+
+// put the character of the escape at p, just after the backslash, on out;
+// echo_octal takes \0nnn as echo -e and %b do, else \0 is one more digit
+// returns the first character after it, or NULL for \c
+static const char *put_escape(const char *p, FILE *out, bool echo_octal)
+{
+    int c;
+    switch (*p)
+    {
+    case 'a':
+        c = '\a';
+        break;
+    case 'b':
+        c = '\b';
+        break;
+    case 'e':
+        c = '\033';
+        break;
+    case 'f':
+        c = '\f';
+        break;
+    case 'n':
+        c = '\n';
+        break;
+    case 'r':
+        c = '\r';
+        break;
+    case 't':
+        c = '\t';
+        break;
+    case 'v':
+        c = '\v';
+        break;
+    case '\\':
+        c = '\\';
+        break;
+    case 'c':
+        return NULL;
+    case 'x':
+        if (strchr("0123456789abcdefABCDEF", p[1]) == NULL || p[1] == '\0')
+        {
+            putc('\\', out);
+            return p;
+        }
+        c = 0;
+        for (int i = 1; i <= 2 && p[1] != '\0' && strchr("0123456789abcdefABCDEF", p[1]) != NULL; i++)
+        {
+            p++;
+            c = c * 16 + (*p <= '9' ? *p - '0' : (*p | 0x20) - 'a' + 10);
+        }
+        break;
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    {
+        // \0nnn as echo writes it, \nnn as a printf format does
+        int digits = echo_octal && *p == '0' ? 4 : 3;
+        c = 0;
+        for (int i = 0; i < digits && *p >= '0' && *p <= '7'; i++)
+        {
+            c = c * 8 + (*p++ - '0');
+        }
+        putc(c, out);
+        return p;
+    }
+    default:
+        // not an escape, kept as it is
+        putc('\\', out);
+        if (*p == '\0')
+        {
+            return p;
+        }
+        c = *p;
+        break;
+    }
+    putc(c, out);
+    return p + 1;
+}
+
+bool print_escaped(const char *s, FILE *out)
+{
+    while (*s)
+    {
+        if (*s != '\\')
+        {
+            const char *end = strchrnul(s, '\\');
+            fwrite(s, 1, end - s, out);
+            s = end;
+            continue;
+        }
+        s = put_escape(s + 1, out, true);
+        if (s == NULL)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static const char *next_arg(struct format_args *fa)
+{
+    if (*fa->next == NULL)
+    {
+        return NULL;
+    }
+    fa->used = true;
+    return *fa->next++;
+}
+
+// the next argument as a number, a leading quote gives the character code
+static long long number_arg(struct format_args *fa)
+{
+    const char *arg = next_arg(fa);
+    if (arg == NULL || arg[0] == '\0')
+    {
+        return 0;
+    }
+    if (arg[0] == '\'' || arg[0] == '"')
+    {
+        return (unsigned char)arg[1];
+    }
+    char *end;
+    errno = 0;
+    long long n = strtoll(arg, &end, 0);
+    if (errno == ERANGE && arg[0] != '-')
+    {
+        // large unsigned values for %u and %x
+        errno = 0;
+        n = (long long)strtoull(arg, &end, 0);
+    }
+    if (*end != '\0' || errno != 0)
+    {
+        fprintf(stderr, "printf: %s: invalid number\n", arg);
+        fa->status = 1;
+    }
+    return n;
+}
+
+static double float_arg(struct format_args *fa)
+{
+    const char *arg = next_arg(fa);
+    if (arg == NULL || arg[0] == '\0')
+    {
+        return 0;
+    }
+    if (arg[0] == '\'' || arg[0] == '"')
+    {
+        return (unsigned char)arg[1];
+    }
+    char *end;
+    double d = strtod(arg, &end);
+    if (*end != '\0')
+    {
+        fprintf(stderr, "printf: %s: invalid number\n", arg);
+        fa->status = 1;
+    }
+    return d;
+}
+
+// print the conversion at p, just after the %
+// returns the first character after it, NULL on a bad format or \c in %b
+static const char *convert(const char *p, struct format_args *fa, bool *stop)
+{
+    char spec[SPEC_SIZE] = "%";
+    size_t len = 1;
+    const char *start = p;
+    // every flag and digit has to leave room for the tail
+    bool fits = true;
+    while (*p && strchr("-+ #0", *p) && (fits = len < SPEC_SIZE - SPEC_TAIL))
+    {
+        spec[len++] = *p++;
+    }
+    // width then precision, either may be * and taken from the arguments
+    for (int part = 0; part < 2 && fits; part++)
+    {
+        if (part == 1)
+        {
+            if (*p != '.')
+            {
+                break;
+            }
+            if (!(fits = len < SPEC_SIZE - SPEC_TAIL))
+            {
+                break;
+            }
+            spec[len++] = *p++;
+        }
+        if (*p == '*')
+        {
+            size_t room = SPEC_SIZE - SPEC_TAIL - len;
+            size_t n = snprintf(spec + len, room, "%d", (int)number_arg(fa));
+            fits = n < room;
+            len += fits ? n : 0;
+            p++;
+            continue;
+        }
+        while (*p >= '0' && *p <= '9' && (fits = len < SPEC_SIZE - SPEC_TAIL))
+        {
+            spec[len++] = *p++;
+        }
+    }
+    if (!fits)
+    {
+        fprintf(stderr, "printf: %%%.20s...: conversion too long\n", start);
+        return NULL;
+    }
+
+    // the argument's type is picked below, a length modifier changes nothing
+    while (*p != '\0' && strchr("hlLjzt", *p) != NULL)
+    {
+        p++;
+    }
+
+    char conversion = *p;
+    switch (conversion)
+    {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+        spec[len++] = 'l';
+        spec[len++] = 'l';
+        spec[len++] = conversion;
+        spec[len] = '\0';
+        printf(spec, number_arg(fa));
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec[len++] = conversion;
+        spec[len] = '\0';
+        printf(spec, float_arg(fa));
+        break;
+    case 'c':
+    {
+        const char *arg = next_arg(fa);
+        spec[len++] = 'c';
+        spec[len] = '\0';
+        if (arg != NULL && arg[0] != '\0')
+        {
+            printf(spec, arg[0]);
+        }
+        break;
+    }
+    case 's':
+    {
+        const char *arg = next_arg(fa);
+        spec[len++] = 's';
+        spec[len] = '\0';
+        printf(spec, arg != NULL ? arg : "");
+        break;
+    }
+    case 'b':
+    {
+        const char *arg = next_arg(fa);
+        if (arg == NULL)
+        {
+            break;
+        }
+        if (len == 1)
+        {
+            *stop = !print_escaped(arg, stdout);
+            break;
+        }
+        // padded, so expanded on the side first
+        char *expanded = NULL;
+        size_t size = 0;
+        FILE *f = open_memstream(&expanded, &size);
+        if (f == NULL)
+        {
+            perror("open_memstream() error");
+            return NULL;
+        }
+        *stop = !print_escaped(arg, f);
+        fclose(f);
+        spec[len++] = 's';
+        spec[len] = '\0';
+        printf(spec, expanded);
+        free(expanded);
+        break;
+    }
+    case '%':
+        putchar('%');
+        break;
+    default:
+        if (conversion == '\0')
+        {
+            fprintf(stderr, "printf: %%%s: missing conversion\n", spec + 1);
+        }
+        else
+        {
+            fprintf(stderr, "printf: %%%c: invalid conversion\n", conversion);
+        }
+        return NULL;
+    }
+    return p + 1;
+}
+
+int printf_builtin(char **args)
+{
+    int first = args[1] != NULL && strcmp(args[1], "--") == 0 ? 2 : 1;
+    const char *format = args[first];
+    if (format == NULL)
+    {
+        fprintf(stderr, "printf: usage: printf format [arg...]\n");
+        return 2;
+    }
+
+    // the format is used again for the arguments it left
+    struct format_args fa = {&args[first + 1], false, 0};
+    do
+    {
+        fa.used = false;
+        for (const char *p = format; *p;)
+        {
+            if (*p == '\\')
+            {
+                p = put_escape(p + 1, stdout, false);
+                if (p == NULL)
+                {
+                    return fa.status;
+                }
+            }
+            else if (*p == '%')
+            {
+                bool stop = false;
+                p = convert(p + 1, &fa, &stop);
+                if (p == NULL)
+                {
+                    return 2;
+                }
+                if (stop)
+                {
+                    return fa.status;
+                }
+            }
+            else
+            {
+                const char *end = strpbrk(p, "\\%");
+                end = end != NULL ? end : p + strlen(p);
+                fwrite(p, 1, end - p, stdout);
+                p = end;
+            }
+        }
+    } while (fa.used && *fa.next != NULL);
+
+    return fa.status;
+}
@@ -0,0 +1,19 @@
+// implementation of printf command
+#ifndef CMD_PRINTF_H
+#define CMD_PRINTF_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+// printf format [arg...]
+// the arguments formatted by format as printf(3) does, with %b for an
+// argument with escapes; the format is used again while arguments are left
+// returns 0, 1 when an argument is not a number, 2 on a bad format; a
+// failed write is reported by builtin_call()
+int printf_builtin(char **args);
+
+// write s with its backslash escapes replaced, used by echo -e as well
+// returns false when \c ended the output
+bool print_escaped(const char *s, FILE *out);
+
+#endif
@@ -0,0 +1,346 @@
+// implementation of test command
+// Up to four arguments are read as POSIX says, by their count, so that
+// test "$x" = "!" means what it looks like. Longer expressions go through a
+// small recursive descent parser where -o binds looser than -a, which binds
+// looser than !.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "test.h"
+
+struct test
+{
+    const char *name; // test or [, for messages
+    char **args;
+    int pos;
+    int end;
+    bool error;
+};
+
+static void error(struct test *t, const char *what, const char *arg)
+{
+    if (!t->error)
+    {
+        fprintf(stderr, "%s: %s%s%s\n", t->name, arg != NULL ? arg : "", arg != NULL ? ": " : "", what);
+    }
+    t->error = true;
+}
+
+static bool is_unary(const char *op)
+{
+    return op[0] == '-' && op[1] != '\0' && op[2] == '\0' && strchr("efdrwxsLhbcpStzn", op[1]) != NULL;
+}
+
+static bool is_binary(const char *op)
+{
+    static const char *const ops[] = {"=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge", "-nt", "-ot", "-ef", "-a", "-o", NULL};
+    for (int i = 0; ops[i] != NULL; i++)
+    {
+        if (strcmp(op, ops[i]) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static long long integer(struct test *t, const char *arg)
+{
+    char *end;
+    errno = 0;
+    long long n = strtoll(arg, &end, 10);
+    while (*end == ' ' || *end == '\t')
+    {
+        end++;
+    }
+    if (end == arg || *end != '\0' || errno != 0)
+    {
+        error(t, "integer expression expected", arg);
+    }
+    return n;
+}
+
+static bool unary(struct test *t, const char *op, const char *arg)
+{
+    struct stat st;
+    switch (op[1])
+    {
+    case 'z':
+        return arg[0] == '\0';
+    case 'n':
+        return arg[0] != '\0';
+    case 't':
+        return isatty(integer(t, arg));
+    case 'r':
+        return faccessat(AT_FDCWD, arg, R_OK, AT_EACCESS) == 0;
+    case 'w':
+        return faccessat(AT_FDCWD, arg, W_OK, AT_EACCESS) == 0;
+    case 'x':
+        return faccessat(AT_FDCWD, arg, X_OK, AT_EACCESS) == 0;
+    case 'L':
+    case 'h':
+        return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+    }
+
+    if (stat(arg, &st) == -1)
+    {
+        return false;
+    }
+    switch (op[1])
+    {
+    case 'f':
+        return S_ISREG(st.st_mode);
+    case 'd':
+        return S_ISDIR(st.st_mode);
+    case 's':
+        return st.st_size > 0;
+    case 'b':
+        return S_ISBLK(st.st_mode);
+    case 'c':
+        return S_ISCHR(st.st_mode);
+    case 'p':
+        return S_ISFIFO(st.st_mode);
+    case 'S':
+        return S_ISSOCK(st.st_mode);
+    }
+    return true; // -e
+}
+
+// a later modification time, a missing file being older than any other
+static int compare_mtime(const char *a, const char *b)
+{
+    struct stat sa, sb;
+    bool has_a = stat(a, &sa) == 0, has_b = stat(b, &sb) == 0;
+    if (!has_a || !has_b)
+    {
+        return has_a - has_b;
+    }
+    if (sa.st_mtim.tv_sec != sb.st_mtim.tv_sec)
+    {
+        return sa.st_mtim.tv_sec < sb.st_mtim.tv_sec ? -1 : 1;
+    }
+    return (sa.st_mtim.tv_nsec > sb.st_mtim.tv_nsec) - (sa.st_mtim.tv_nsec < sb.st_mtim.tv_nsec);
+}
+
+static bool binary(struct test *t, const char *a, const char *op, const char *b)
+{
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+    {
+        return strcmp(a, b) == 0;
+    }
+    if (strcmp(op, "!=") == 0)
+    {
+        return strcmp(a, b) != 0;
+    }
+    if (strcmp(op, "<") == 0)
+    {
+        return strcmp(a, b) < 0;
+    }
+    if (strcmp(op, ">") == 0)
+    {
+        return strcmp(a, b) > 0;
+    }
+    if (strcmp(op, "-a") == 0)
+    {
+        return a[0] != '\0' && b[0] != '\0';
+    }
+    if (strcmp(op, "-o") == 0)
+    {
+        return a[0] != '\0' || b[0] != '\0';
+    }
+    if (strcmp(op, "-nt") == 0)
+    {
+        return compare_mtime(a, b) > 0;
+    }
+    if (strcmp(op, "-ot") == 0)
+    {
+        return compare_mtime(a, b) < 0;
+    }
+    if (strcmp(op, "-ef") == 0)
+    {
+        struct stat sa, sb;
+        return stat(a, &sa) == 0 && stat(b, &sb) == 0 && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+    }
+
+    long long x = integer(t, a), y = integer(t, b);
+    if (strcmp(op, "-eq") == 0)
+    {
+        return x == y;
+    }
+    if (strcmp(op, "-ne") == 0)
+    {
+        return x != y;
+    }
+    if (strcmp(op, "-lt") == 0)
+    {
+        return x < y;
+    }
+    if (strcmp(op, "-le") == 0)
+    {
+        return x <= y;
+    }
+    if (strcmp(op, "-gt") == 0)
+    {
+        return x > y;
+    }
+    return x >= y;
+}
+
+static bool expression(struct test *t);
+
+static bool primary(struct test *t)
+{
+    if (t->pos >= t->end)
+    {
+        error(t, "argument expected", NULL);
+        return false;
+    }
+    char *a = t->args[t->pos];
+    if (strcmp(a, "!") == 0)
+    {
+        t->pos++;
+        return !primary(t);
+    }
+    if (strcmp(a, "(") == 0)
+    {
+        t->pos++;
+        bool value = expression(t);
+        if (t->pos >= t->end || strcmp(t->args[t->pos], ")") != 0)
+        {
+            error(t, "')' expected", NULL);
+            return false;
+        }
+        t->pos++;
+        return value;
+    }
+    const char *op = t->pos + 1 < t->end ? t->args[t->pos + 1] : "";
+    if (is_binary(op) && strcmp(op, "-a") != 0 && strcmp(op, "-o") != 0)
+    {
+        if (t->pos + 2 >= t->end)
+        {
+            error(t, "argument expected", t->args[t->pos + 1]);
+            return false;
+        }
+        t->pos += 3;
+        return binary(t, a, op, t->args[t->pos - 1]);
+    }
+    if (is_unary(a) && t->pos + 1 < t->end)
+    {
+        t->pos += 2;
+        return unary(t, a, t->args[t->pos - 1]);
+    }
+    t->pos++;
+    return a[0] != '\0';
+}
+
+static bool conjunction(struct test *t)
+{
+    bool value = primary(t);
+    while (t->pos < t->end && strcmp(t->args[t->pos], "-a") == 0)
+    {
+        t->pos++;
+        value = primary(t) && value;
+    }
+    return value;
+}
+
+static bool expression(struct test *t)
+{
+    bool value = conjunction(t);
+    while (t->pos < t->end && strcmp(t->args[t->pos], "-o") == 0)
+    {
+        t->pos++;
+        value = conjunction(t) || value;
+    }
+    return value;
+}
+
+// POSIX's rules for n arguments from pos, the parser past four
+static bool evaluate(struct test *t, int n)
+{
+    char **a = &t->args[t->pos];
+    switch (n)
+    {
+    case 0:
+        return false;
+    case 1:
+        t->pos++;
+        return a[0][0] != '\0';
+    case 2:
+        if (strcmp(a[0], "!") == 0)
+        {
+            t->pos += 2;
+            return a[1][0] == '\0';
+        }
+        if (is_unary(a[0]))
+        {
+            t->pos += 2;
+            return unary(t, a[0], a[1]);
+        }
+        error(t, "unary operator expected", a[0]);
+        return false;
+    case 3:
+        if (is_binary(a[1]))
+        {
+            t->pos += 3;
+            return binary(t, a[0], a[1], a[2]);
+        }
+        if (strcmp(a[0], "!") == 0)
+        {
+            t->pos++;
+            return !evaluate(t, 2);
+        }
+        if (strcmp(a[0], "(") == 0 && strcmp(a[2], ")") == 0)
+        {
+            t->pos += 3;
+            return a[1][0] != '\0';
+        }
+        break;
+    case 4:
+        if (strcmp(a[0], "!") == 0)
+        {
+            t->pos++;
+            return !evaluate(t, 3);
+        }
+        if (strcmp(a[0], "(") == 0 && strcmp(a[3], ")") == 0)
+        {
+            t->pos++;
+            bool value = evaluate(t, 2);
+            t->pos++;
+            return value;
+        }
+        break;
+    }
+    return expression(t);
+}
+
+int test_builtin(char **args)
+{
+    struct test t = {args[0], args, 1, 0, false};
+    while (args[t.end] != NULL)
+    {
+        t.end++;
+    }
+    if (strcmp(args[0], "[") == 0)
+    {
+        if (t.end == 1 || strcmp(args[t.end - 1], "]") != 0)
+        {
+            fprintf(stderr, "[: missing ']'\n");
+            return 2;
+        }
+        t.end--;
+    }
+
+    bool value = evaluate(&t, t.end - t.pos);
+    if (!t.error && t.pos < t.end)
+    {
+        error(&t, "too many arguments", NULL);
+    }
+    return t.error ? 2 : !value;
+}
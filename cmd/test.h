@@ -0,0 +1,12 @@
+// implementation of test command
+#ifndef CMD_TEST_H
+#define CMD_TEST_H
+
+// test expression, [ expression ]
+// file tests -e -f -d -r -w -x -s -L -h -b -c -p -S -t, string tests -z -n
+// = != < >, integer tests -eq -ne -lt -le -gt -ge, file comparisons -nt
+// -ot -ef, joined by ! -a -o and ( )
+// returns 0 when the expression is true, 1 when false, 2 on an error
+int test_builtin(char **args);
+
+#endif
@@ -0,0 +1,12 @@
+// implementation of true and false commands
+#include "true.h"
+
+int true_builtin(char **args)
+{
+    return 0;
+}
+
+int false_builtin(char **args)
+{
+    return 1;
+}
@@ -0,0 +1,11 @@
+// implementation of true and false commands
+#ifndef CMD_TRUE_H
+#define CMD_TRUE_H
+
+// true [arg...], returns 0
+int true_builtin(char **args);
+
+// false [arg...], returns 1
+int false_builtin(char **args);
+
+#endif
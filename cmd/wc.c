@@ -0,0 +1,221 @@
+// implementation of wc command
+// Input is counted 64 bytes at a time with SSE2: four 16 byte compares per
+// class give a 64 bit mask each of newlines, of bytes that are not white
+// space and of bytes that start a UTF-8 character. Lines and characters are
+// popcounts of their masks, and a word starts wherever a non space byte
+// follows a space, the last bit of each block carried into the next. Bytes
+// left at the end, and machines without SSE2, go through the same rules
+// one byte at a time.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "wc.h"
+
+#define WC_BUFFER (1 << 17)
+#define PIPE_WIDTH 7 // column width when the sizes are not known up front
+
+struct counts
+{
+    unsigned long long lines;
+    unsigned long long words;
+    unsigned long long chars;
+    unsigned long long bytes;
+};
+
+static bool is_space(unsigned char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// count len bytes of buf; in_word says whether the byte before was part of
+// a word, and is updated for the next block
+static void count_block(const unsigned char *buf, size_t len, struct counts *c, bool *in_word)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i controls = _mm_set1_epi8('\r' - '\t');
+    const __m128i continuation = _mm_set1_epi8((char)0xBF); // -65
+    uint64_t carry = *in_word;
+    for (; i + 64 <= len; i += 64)
+    {
+        uint64_t lines = 0, spaces = 0, starts = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(buf + i + 16 * k));
+            // \t to \r are the bytes whose distance from \t is at most 4
+            __m128i offset = _mm_sub_epi8(v, tab);
+            __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(offset, controls), offset);
+            __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, space), control);
+            // continuation bytes are 0x80 to 0xBF, as signed bytes -128 to -65
+            __m128i start = _mm_cmpgt_epi8(v, continuation);
+            lines |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)) << (16 * k);
+            spaces |= (uint64_t)(uint16_t)_mm_movemask_epi8(blank) << (16 * k);
+            starts |= (uint64_t)(uint16_t)_mm_movemask_epi8(start) << (16 * k);
+        }
+        uint64_t word = ~spaces;
+        c->lines += __builtin_popcountll(lines);
+        c->chars += __builtin_popcountll(starts);
+        c->words += __builtin_popcountll(word & ~((word << 1) | carry));
+        carry = word >> 63;
+    }
+    *in_word = carry;
+#endif
+    for (; i < len; i++)
+    {
+        unsigned char b = buf[i];
+        c->lines += b == '\n';
+        c->chars += (b & 0xC0) != 0x80;
+        bool word = !is_space(b);
+        c->words += word && !*in_word;
+        *in_word = word;
+    }
+    c->bytes += len;
+}
+
+// returns 0, or -1 with errno set
+static int count_fd(int fd, struct counts *c)
+{
+    static unsigned char buf[WC_BUFFER];
+    bool in_word = false;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+    {
+        count_block(buf, n, c, &in_word);
+    }
+    return n == 0 ? 0 : -1;
+}
+
+static void print_counts(const struct counts *c, const char *columns, int width, const char *name)
+{
+    const unsigned long long values[] = {c->lines, c->words, c->chars, c->bytes};
+    const char *order = "lwmc";
+    bool first = true;
+    for (int k = 0; k < 4; k++)
+    {
+        if (strchr(columns, order[k]) != NULL)
+        {
+            printf(first ? "%*llu" : " %*llu", width, values[k]);
+            first = false;
+        }
+    }
+    printf(name != NULL ? " %s\n" : "\n", name);
+}
+
+int wc_builtin(char **args)
+{
+    static char *from_stdin[] = {"-", NULL};
+    char columns[5] = "";
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++)
+    {
+        if (strcmp(args[i], "--") == 0)
+        {
+            i++;
+            break;
+        }
+        for (const char *p = args[i] + 1; *p; p++)
+        {
+            if (strchr("lwmc", *p) == NULL)
+            {
+                fprintf(stderr, "wc: invalid option -- '%c'\n", *p);
+                return 1;
+            }
+            if (strchr(columns, *p) == NULL)
+            {
+                strncat(columns, p, 1);
+            }
+        }
+    }
+    if (columns[0] == '\0')
+    {
+        strcpy(columns, "lwc");
+    }
+    bool named = args[i] != NULL;
+    char **files = named ? &args[i] : from_stdin;
+    int count = 0;
+    while (files[count] != NULL)
+    {
+        count++;
+    }
+
+    // the columns are as wide as the total size of the files needs, like
+    // coreutils, and a lone count is not padded at all
+    int width = 1;
+    if (count > 1 || strlen(columns) > 1)
+    {
+        unsigned long long total_size = 0;
+        bool unknown = false;
+        for (int f = 0; f < count; f++)
+        {
+            struct stat st;
+            int ok = strcmp(files[f], "-") == 0 ? fstat(STDIN_FILENO, &st) : stat(files[f], &st);
+            if (ok == 0 && S_ISREG(st.st_mode))
+            {
+                total_size += st.st_size;
+            }
+            else
+            {
+                unknown = true;
+            }
+        }
+        for (; total_size >= 10; total_size /= 10)
+        {
+            width++;
+        }
+        width = unknown && width < PIPE_WIDTH ? PIPE_WIDTH : width;
+    }
+
+    int status = 0;
+    struct counts total = {0, 0, 0, 0};
+    for (int f = 0; f < count; f++)
+    {
+        bool is_stdin = strcmp(files[f], "-") == 0;
+        int fd = is_stdin ? STDIN_FILENO : open(files[f], O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            fprintf(stderr, "wc: %s: %s\n", files[f], strerror(errno));
+            status = 1;
+            continue;
+        }
+        struct counts c = {0, 0, 0, 0};
+        int result = count_fd(fd, &c);
+        int err = errno;
+        if (!is_stdin)
+        {
+            close(fd);
+        }
+        if (result == -1 && err == EINTR)
+        {
+            return 130;
+        }
+        if (result == -1)
+        {
+            fprintf(stderr, "wc: %s: %s\n", files[f], strerror(err));
+            status = 1;
+            continue;
+        }
+        print_counts(&c, columns, width, named ? files[f] : NULL);
+        total.lines += c.lines;
+        total.words += c.words;
+        total.chars += c.chars;
+        total.bytes += c.bytes;
+    }
+    if (count > 1)
+    {
+        print_counts(&total, columns, width, "total");
+    }
+    return status;
+}
@@ -0,0 +1,11 @@
+// implementation of wc command
+#ifndef CMD_WC_H
+#define CMD_WC_H
+
+// wc [-clmw] [file...]
+// newlines, words and bytes of each file, or only the counts asked for; -m
+// counts UTF-8 characters; a total follows when there are several files
+// returns 0, 1 when a file could not be read
+int wc_builtin(char **args);
+
+#endif
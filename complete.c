@@ -0,0 +1,808 @@
+// Tab completion
+// Command names come from a trie of the executables in $PATH. It is built
+// on the first completion; after that a completion only stats the $PATH
+// directories and reloads the ones whose mtime moved. A name is counted
+// once for each directory holding it, so reloading one directory leaves
+// the names the others bring.
+// File names come from a sorted listing of one directory, kept until cd or
+// until the directory's mtime moves. Once it is read, completing in a
+// directory of any size is two binary searches.
+// Reading a huge directory takes far longer than a keystroke may, so the
+// trie and the listing of the current directory are loaded by a thread
+// when the shell starts and after each cd, while the user types.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "complete.h"
+#include "vars.h"
+
+#define DEFAULT_PATH "/bin:/usr/bin"
+#define LIST_LIMIT 100 // candidates shown at most
+
+// characters the lexer would take for something other than part of a word
+#define SPECIAL_CHARS " \t\\'\"|&;<>()$`*?["
+
+struct trie_node
+{
+    uint32_t child;   // first child, children are sorted by byte
+    uint32_t sibling; // next child of the same parent, 0 for none
+    uint32_t below;   // distinct names ending in this subtree
+    uint16_t here;    // $PATH directories holding the name ending here
+    unsigned char byte;
+};
+
+// a $PATH directory and the executables it put in the trie
+struct exec_dir
+{
+    char *path;
+    struct timespec mtime;
+    char *names; // NUL separated
+    size_t names_len;
+    size_t names_cap;
+};
+
+static struct trie_node *nodes; // nodes[0] is the root
+static uint32_t node_count;
+static size_t node_cap;
+static char *trie_path_var; // $PATH the trie was built from
+static struct exec_dir *exec_dirs;
+static int exec_dir_count;
+
+struct name_list
+{
+    uint32_t *offsets;
+    size_t count;
+    size_t cap;
+};
+
+// entries of one directory, each a d_type byte and a NUL terminated name
+static struct
+{
+    bool valid;
+    char *dir; // as typed, "" for the current directory
+    struct timespec mtime;
+    char *names;
+    size_t names_len;
+    size_t names_cap;
+    struct name_list visible;
+    struct name_list hidden; // names starting with '.'
+} listing;
+
+// background load of the trie and the current directory
+static pthread_t loader;
+static bool loading;
+static bool prefetching; // only line editing shells load ahead
+static char *loader_path_var;
+
+// the word being completed, unquoted
+static char *word;
+static size_t word_cap;
+
+// text inserted or listed, valid until the next completion
+static char *text;
+static size_t text_len;
+static size_t text_cap;
+static size_t list_offsets[LIST_LIMIT];
+static const char *list[LIST_LIMIT];
+
+static void reserve(void *buf, size_t *cap, size_t need, size_t item_size)
+{
+    if (need <= *cap)
+    {
+        return;
+    }
+    size_t size = *cap ? *cap : 256;
+    while (size < need)
+    {
+        size *= 2;
+    }
+    void *p = realloc(*(void **)buf, size * item_size);
+    if (p == NULL)
+    {
+        perror("realloc() error");
+        exit(EXIT_FAILURE);
+    }
+    *(void **)buf = p;
+    *cap = size;
+}
+
+static void append_text(const char *s, size_t n)
+{
+    reserve(&text, &text_cap, text_len + n + 1, 1);
+    memcpy(text + text_len, s, n);
+    text_len += n;
+    text[text_len] = '\0';
+}
+
+// name as the lexer needs it written, inside the open quote if there is one
+static void append_escaped(const char *s, size_t n, char quote)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        bool special = quote == 0 ? strchr(SPECIAL_CHARS, s[i]) != NULL : quote == '"' && strchr("\\\"$`", s[i]) != NULL;
+        if (special)
+        {
+            append_text("\\", 1);
+        }
+        append_text(&s[i], 1);
+    }
+}
+
+// end of a single candidate: close the quote and start the next word
+static void append_word_end(char quote)
+{
+    if (quote != 0)
+    {
+        append_text(&quote, 1);
+    }
+    append_text(" ", 1);
+}
+
+static void add_listed(const char *name, size_t len, bool dir, struct completion *c)
+{
+    list_offsets[c->list_count++] = text_len;
+    append_text(name, len);
+    if (dir)
+    {
+        append_text("/", 1);
+    }
+    append_text("", 1);
+}
+
+// the listed names were built in text, which may have moved since
+static void finish_list(struct completion *c)
+{
+    for (size_t i = 0; i < c->list_count; i++)
+    {
+        list[i] = text + list_offsets[i];
+    }
+    c->list = list;
+}
+
+static uint32_t new_node(unsigned char byte)
+{
+    reserve(&nodes, &node_cap, node_count + 1, sizeof(struct trie_node));
+    nodes[node_count] = (struct trie_node){0, 0, 0, 0, byte};
+    return node_count++;
+}
+
+// child of node for byte, added in order when create is set, 0 when none
+static uint32_t child_of(uint32_t node, unsigned char byte, bool create)
+{
+    uint32_t prev = 0;
+    uint32_t c = nodes[node].child;
+    while (c != 0 && nodes[c].byte < byte)
+    {
+        prev = c;
+        c = nodes[c].sibling;
+    }
+    if (c != 0 && nodes[c].byte == byte)
+    {
+        return c;
+    }
+    if (!create)
+    {
+        return 0;
+    }
+
+    uint32_t n = new_node(byte);
+    nodes[n].sibling = c;
+    if (prev == 0)
+    {
+        nodes[node].child = n;
+    }
+    else
+    {
+        nodes[prev].sibling = n;
+    }
+    return n;
+}
+
+// count one directory's copy of name in (delta 1) or out (delta -1)
+static void trie_update(const char *name, int delta)
+{
+    uint32_t path[NAME_MAX + 2];
+    size_t depth = 0;
+    uint32_t n = 0;
+    path[depth++] = n;
+    for (const char *p = name; *p && depth < NAME_MAX + 2; p++)
+    {
+        n = child_of(n, *p, delta > 0);
+        if (n == 0)
+        {
+            return;
+        }
+        path[depth++] = n;
+    }
+
+    bool was = nodes[n].here > 0;
+    nodes[n].here += delta;
+    bool is = nodes[n].here > 0;
+    if (was != is)
+    {
+        for (size_t i = 0; i < depth; i++)
+        {
+            nodes[path[i]].below += is ? 1 : -1;
+        }
+    }
+}
+
+// replace what the directory put in the trie with what it holds now
+static void load_exec_dir(struct exec_dir *d)
+{
+    for (size_t off = 0; off < d->names_len; off += strlen(d->names + off) + 1)
+    {
+        trie_update(d->names + off, -1);
+    }
+    d->names_len = 0;
+
+    int fd = open(d->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return;
+    }
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL)
+    {
+        close(fd);
+        return;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if (ent->d_name[0] == '.' || ent->d_type == DT_DIR)
+        {
+            continue;
+        }
+        struct stat st;
+        if (ent->d_type != DT_REG && (fstatat(fd, ent->d_name, &st, 0) == -1 || !S_ISREG(st.st_mode)))
+        {
+            continue;
+        }
+        if (faccessat(fd, ent->d_name, X_OK, 0) == -1)
+        {
+            continue;
+        }
+        size_t len = strlen(ent->d_name) + 1;
+        reserve(&d->names, &d->names_cap, d->names_len + len, 1);
+        memcpy(d->names + d->names_len, ent->d_name, len);
+        d->names_len += len;
+        trie_update(ent->d_name, 1);
+    }
+    closedir(dir);
+}
+
+// bring the trie up to date with $PATH and its directories
+static void refresh_commands(const char *path_var)
+{
+    if (trie_path_var == NULL || strcmp(trie_path_var, path_var) != 0)
+    {
+        // start over
+        for (int i = 0; i < exec_dir_count; i++)
+        {
+            free(exec_dirs[i].path);
+            free(exec_dirs[i].names);
+        }
+        free(exec_dirs);
+        free(trie_path_var);
+        trie_path_var = strdup(path_var);
+        node_count = 0;
+        new_node(0);
+
+        exec_dir_count = 1;
+        for (const char *p = path_var; *p; p++)
+        {
+            exec_dir_count += *p == ':';
+        }
+        exec_dirs = calloc(exec_dir_count, sizeof(struct exec_dir));
+        const char *start = path_var;
+        for (int i = 0; i < exec_dir_count; i++)
+        {
+            const char *end = strchr(start, ':');
+            size_t len = end ? (size_t)(end - start) : strlen(start);
+            exec_dirs[i].path = len ? strndup(start, len) : strdup(".");
+            exec_dirs[i].mtime.tv_nsec = -1; // never matches, so it gets read
+            start = end ? end + 1 : start + len;
+        }
+    }
+
+    for (int i = 0; i < exec_dir_count; i++)
+    {
+        struct exec_dir *d = &exec_dirs[i];
+        struct stat st;
+        if (stat(d->path, &st) == -1)
+        {
+            st.st_mtim.tv_sec = 0;
+            st.st_mtim.tv_nsec = 0;
+        }
+        if (st.st_mtim.tv_sec != d->mtime.tv_sec || st.st_mtim.tv_nsec != d->mtime.tv_nsec)
+        {
+            d->mtime = st.st_mtim;
+            load_exec_dir(d);
+        }
+    }
+}
+
+// names below node in order, name holds the first depth bytes
+static void collect_commands(uint32_t node, char *name, size_t depth, struct completion *c)
+{
+    if (c->list_count == LIST_LIMIT)
+    {
+        return;
+    }
+    if (nodes[node].here > 0)
+    {
+        add_listed(name, depth, false, c);
+    }
+    for (uint32_t child = nodes[node].child; child != 0 && depth < NAME_MAX; child = nodes[child].sibling)
+    {
+        if (nodes[child].below > 0)
+        {
+            name[depth] = nodes[child].byte;
+            collect_commands(child, name, depth + 1, c);
+        }
+    }
+}
+
+static void complete_command(size_t len, char quote, struct completion *c)
+{
+    const char *path_var = vars_get("PATH");
+    refresh_commands(path_var != NULL ? path_var : DEFAULT_PATH);
+    uint32_t node = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        node = child_of(node, word[i], false);
+        if (node == 0)
+        {
+            return;
+        }
+    }
+    if (nodes[node].below == 0)
+    {
+        return;
+    }
+    c->total = nodes[node].below;
+
+    // follow the trie while every name goes on the same way
+    char name[NAME_MAX + 1];
+    size_t depth = len < NAME_MAX ? len : NAME_MAX;
+    memcpy(name, word, depth);
+    uint32_t at = node;
+    while (nodes[at].here == 0 && depth < NAME_MAX)
+    {
+        uint32_t only = 0;
+        int live = 0;
+        for (uint32_t child = nodes[at].child; child != 0; child = nodes[child].sibling)
+        {
+            if (nodes[child].below > 0)
+            {
+                live++;
+                only = child;
+            }
+        }
+        if (live != 1)
+        {
+            break;
+        }
+        name[depth++] = nodes[only].byte;
+        at = only;
+    }
+    append_escaped(name + len, depth - len, quote);
+    if (c->total == 1)
+    {
+        append_word_end(quote);
+    }
+
+    if (text_len == 0)
+    {
+        collect_commands(node, name, len, c);
+        finish_list(c);
+    }
+}
+
+static const char *listed_name(const struct name_list *l, size_t i)
+{
+    return listing.names + l->offsets[i] + 1;
+}
+
+// a name to sort and 8 of its bytes as a big endian number, so comparing
+// keys compares those bytes
+struct sort_item
+{
+    uint64_t key;
+    uint32_t offset;
+};
+
+static uint64_t name_key(const char *name, size_t depth)
+{
+    uint64_t key = 0;
+    size_t i = 0;
+    for (; i < 8 && name[depth + i] != '\0'; i++)
+    {
+        key = key << 8 | (unsigned char)name[depth + i];
+    }
+    return i ? key << (8 * (8 - i)) : 0;
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+    uint64_t x = ((const struct sort_item *)a)->key, y = ((const struct sort_item *)b)->key;
+    return (x > y) - (x < y);
+}
+
+// LSD radix sort on the keys, a byte per pass, skipping the passes where
+// every key has the same byte
+static void radix_sort(struct sort_item *items, struct sort_item *tmp, size_t n)
+{
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t counts[256] = {0};
+        for (size_t i = 0; i < n; i++)
+        {
+            counts[(items[i].key >> shift) & 0xff]++;
+        }
+        if (counts[(items[0].key >> shift) & 0xff] == n)
+        {
+            continue;
+        }
+        size_t sum = 0;
+        for (int b = 0; b < 256; b++)
+        {
+            size_t c = counts[b];
+            counts[b] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            tmp[counts[(items[i].key >> shift) & 0xff]++] = items[i];
+        }
+        memcpy(items, tmp, n * sizeof(struct sort_item));
+    }
+}
+
+// sort by the 8 bytes at depth, then each run of equal keys by the next 8
+static void sort_names(struct sort_item *items, struct sort_item *tmp, size_t n, size_t depth)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        items[i].key = name_key(listing.names + items[i].offset + 1, depth);
+    }
+    if (n < 256)
+    {
+        // fewer items than a pass has buckets
+        qsort(items, n, sizeof(struct sort_item), compare_keys);
+    }
+    else
+    {
+        radix_sort(items, tmp, n);
+    }
+
+    for (size_t i = 0; i < n;)
+    {
+        size_t j = i + 1;
+        while (j < n && items[j].key == items[i].key)
+        {
+            j++;
+        }
+        // a key ending in a NUL ends its name, two names cannot share it
+        if (j - i > 1 && (items[i].key & 0xff) != 0)
+        {
+            sort_names(items + i, tmp, j - i, depth + 8);
+        }
+        i = j;
+    }
+}
+
+static void sort_listing(struct name_list *l)
+{
+    if (l->count < 2)
+    {
+        return;
+    }
+    struct sort_item *items = malloc(2 * l->count * sizeof(struct sort_item));
+    if (items == NULL)
+    {
+        perror("malloc() error");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < l->count; i++)
+    {
+        items[i].offset = l->offsets[i];
+    }
+    sort_names(items, items + l->count, l->count, 0);
+    for (size_t i = 0; i < l->count; i++)
+    {
+        l->offsets[i] = items[i].offset;
+    }
+    free(items);
+}
+
+// first entry not before prefix, or with after set, the first past it
+static size_t search_listing(const struct name_list *l, const char *prefix, size_t len, bool after)
+{
+    size_t low = 0;
+    size_t high = l->count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        int cmp = strncmp(listed_name(l, mid), prefix, len);
+        if (cmp < 0 || (after && cmp == 0))
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// read and sort the directory unless the listing already holds it
+static bool load_listing(const char *dir)
+{
+    const char *path = *dir ? dir : ".";
+    struct stat st;
+    if (stat(path, &st) == -1)
+    {
+        return false;
+    }
+    if (listing.valid && strcmp(listing.dir, dir) == 0 && st.st_mtim.tv_sec == listing.mtime.tv_sec &&
+        st.st_mtim.tv_nsec == listing.mtime.tv_nsec)
+    {
+        return true;
+    }
+
+    DIR *d = opendir(path);
+    if (d == NULL)
+    {
+        return false;
+    }
+    listing.names_len = 0;
+    listing.visible.count = 0;
+    listing.hidden.count = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL)
+    {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+        {
+            continue;
+        }
+        size_t len = strlen(ent->d_name) + 1;
+        reserve(&listing.names, &listing.names_cap, listing.names_len + len + 1, 1);
+        struct name_list *l = ent->d_name[0] == '.' ? &listing.hidden : &listing.visible;
+        reserve(&l->offsets, &l->cap, l->count + 1, sizeof(uint32_t));
+        l->offsets[l->count++] = listing.names_len;
+        listing.names[listing.names_len] = ent->d_type;
+        memcpy(listing.names + listing.names_len + 1, ent->d_name, len);
+        listing.names_len += len + 1;
+    }
+    closedir(d);
+
+    sort_listing(&listing.visible);
+    sort_listing(&listing.hidden);
+    free(listing.dir);
+    listing.dir = strdup(dir);
+    listing.mtime = st.st_mtim;
+    listing.valid = true;
+    return true;
+}
+
+// whether a listed entry is a directory, a symlink is followed to see
+static bool listed_dir(const struct name_list *l, size_t i, const char *dir)
+{
+    unsigned char type = listing.names[l->offsets[i]];
+    if (type == DT_DIR)
+    {
+        return true;
+    }
+    if (type != DT_LNK && type != DT_UNKNOWN)
+    {
+        return false;
+    }
+    char path[PATH_MAX];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s%s", *dir ? dir : "./", listed_name(l, i));
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void complete_file(size_t len, char quote, struct completion *c)
+{
+    // the directory part is left as typed
+    const char *slash = memrchr(word, '/', len);
+    size_t dir_len = slash ? (size_t)(slash - word) + 1 : 0;
+    char dir[PATH_MAX];
+    if (dir_len >= sizeof(dir))
+    {
+        return;
+    }
+    memcpy(dir, word, dir_len);
+    dir[dir_len] = '\0';
+    if (!load_listing(dir))
+    {
+        return;
+    }
+
+    const char *prefix = word + dir_len;
+    size_t prefix_len = len - dir_len;
+    const struct name_list *l = prefix_len > 0 && prefix[0] == '.' ? &listing.hidden : &listing.visible;
+    size_t first = search_listing(l, prefix, prefix_len, false);
+    size_t last = search_listing(l, prefix, prefix_len, true);
+    if (first == last)
+    {
+        return;
+    }
+    c->total = last - first;
+
+    // sorted, so what the first and last share all of them share
+    const char *a = listed_name(l, first);
+    const char *b = listed_name(l, last - 1);
+    size_t common = prefix_len;
+    while (a[common] != '\0' && a[common] == b[common])
+    {
+        common++;
+    }
+    append_escaped(a + prefix_len, common - prefix_len, quote);
+    if (c->total == 1)
+    {
+        if (listed_dir(l, first, dir))
+        {
+            append_text("/", 1);
+        }
+        else
+        {
+            append_word_end(quote);
+        }
+    }
+
+    if (text_len == 0)
+    {
+        for (size_t i = first; i < last && c->list_count < LIST_LIMIT; i++)
+        {
+            const char *name = listed_name(l, i);
+            add_listed(name, strlen(name), listing.names[l->offsets[i]] == DT_DIR, c);
+        }
+        finish_list(c);
+    }
+}
+
+static void *load_in_background(void *arg)
+{
+    refresh_commands(loader_path_var);
+    load_listing("");
+    return arg;
+}
+
+// the caches are the main thread's again once the loader is done
+static void wait_loader(void)
+{
+    if (loading)
+    {
+        pthread_join(loader, NULL);
+        loading = false;
+    }
+}
+
+void complete_prefetch(void)
+{
+    wait_loader();
+    prefetching = true;
+    const char *path_var = vars_get("PATH");
+    free(loader_path_var);
+    loader_path_var = strdup(path_var != NULL ? path_var : DEFAULT_PATH);
+    loading = pthread_create(&loader, NULL, load_in_background, NULL) == 0;
+}
+
+void complete_line(const char *line, size_t len, size_t pos, struct completion *c)
+{
+    wait_loader();
+
+    // find the word before the cursor the way the lexer would split it,
+    // and whether it is in the place of a command name
+    reserve(&word, &word_cap, pos + 1, 1);
+    size_t word_len = 0;
+    bool in_word = false;
+    bool command = true;
+    bool redirect = false;
+    char quote = 0;
+    for (size_t i = 0; i < pos; i++)
+    {
+        char ch = line[i];
+        if (quote != 0)
+        {
+            if (ch == quote)
+            {
+                quote = 0;
+            }
+            else if (quote == '"' && ch == '\\' && i + 1 < pos && strchr("\\\"$`", line[i + 1]) != NULL)
+            {
+                word[word_len++] = line[++i];
+            }
+            else
+            {
+                word[word_len++] = ch;
+            }
+            continue;
+        }
+
+        bool blank = ch == ' ' || ch == '\t';
+        bool op = strchr("|;&()<>", ch) != NULL;
+        if (blank || op)
+        {
+            if (in_word)
+            {
+                // the file of a redirection is not the command
+                command = command && redirect;
+                redirect = false;
+                in_word = false;
+            }
+            if (op)
+            {
+                redirect = ch == '<' || ch == '>';
+                command = command || !redirect;
+            }
+            continue;
+        }
+
+        if (!in_word)
+        {
+            in_word = true;
+            word_len = 0;
+        }
+        if (ch == '\\')
+        {
+            if (i + 1 < pos)
+            {
+                word[word_len++] = line[++i];
+            }
+        }
+        else if (ch == '\'' || ch == '"')
+        {
+            quote = ch;
+        }
+        else
+        {
+            word[word_len++] = ch;
+        }
+    }
+    if (!in_word)
+    {
+        word_len = 0;
+    }
+
+    text_len = 0;
+    if (command && !redirect && memchr(word, '/', word_len) == NULL)
+    {
+        complete_command(word_len, quote, c);
+    }
+    else
+    {
+        complete_file(word_len, quote, c);
+    }
+    if (text_len > 0 && c->list_count == 0)
+    {
+        c->insert = text;
+        c->insert_len = text_len;
+    }
+    (void)len;
+}
+
+void complete_forget_cwd(void)
+{
+    wait_loader();
+    listing.valid = false;
+    if (prefetching)
+    {
+        complete_prefetch();
+    }
+}
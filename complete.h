@@ -0,0 +1,22 @@
+// Tab completion
+// Command words complete from the executables in $PATH, other words from
+// the files in their directory.
+
+#ifndef COMPLETE_H
+#define COMPLETE_H
+
+#include <stddef.h>
+#include "editor.h"
+
+// the completion of the word before pos in line, for the line editor
+void complete_line(const char *line, size_t len, size_t pos, struct completion *c);
+
+// load the $PATH executables and the current directory in the background,
+// so the first Tab finds them ready
+void complete_prefetch(void);
+
+// the current directory changed: relative listings are stale, and the new
+// directory is loaded in the background
+void complete_forget_cwd(void);
+
+#endif
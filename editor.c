@@ -0,0 +1,876 @@
+// Line editor
+// The terminal is in raw mode only while a line is edited, and back in the
+// modes the shell found it in before the line is returned, so commands run
+// with the usual line discipline. A refresh compares prompt and line with
+// what was drawn last and rewrites from the first byte that differs; the
+// cursor is moved with the UP, DOWN, LEFT and RIGHT sequences of shell.c,
+// given a count when it moves further than one step.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include "editor.h"
+#include "history.h"
+
+#define UP "\033[1A"
+#define DOWN "\033[1B"
+#define RIGHT "\033[1C"
+#define LEFT "\033[1D"
+#define CLEAR_BELOW "\033[J"
+#define CLEAR "\033[H\033[2J"
+
+#define CTRL_KEY(c) ((c) & 0x1f)
+#define ESCAPE_TIMEOUT 50 // ms to wait for the rest of an escape sequence
+
+// keys read from escape sequences, above any byte
+enum key
+{
+    KEY_NONE = 256,
+    KEY_UP,
+    KEY_DOWN,
+    KEY_RIGHT,
+    KEY_LEFT,
+    KEY_HOME,
+    KEY_END,
+    KEY_DELETE,
+};
+
+// what a key did to the line
+enum action
+{
+    EDIT,
+    ACCEPT,
+    CANCEL,
+    END_OF_INPUT,
+};
+
+static void grow(char **buf, size_t *cap, size_t need)
+{
+    if (need <= *cap)
+    {
+        return;
+    }
+    size_t size = *cap ? *cap : 256;
+    while (size < need)
+    {
+        size *= 2;
+    }
+    char *p = realloc(*buf, size);
+    if (p == NULL)
+    {
+        perror("realloc() error");
+        exit(EXIT_FAILURE);
+    }
+    *buf = p;
+    *cap = size;
+}
+
+static void emit(struct editor *e, const char *s, size_t n)
+{
+    grow(&e->output, &e->output_cap, e->output_len + n);
+    memcpy(e->output + e->output_len, s, n);
+    e->output_len += n;
+}
+
+static void emit_str(struct editor *e, const char *s)
+{
+    emit(e, s, strlen(s));
+}
+
+// n steps of one cursor motion, one is the single step sequence
+static void emit_motion(struct editor *e, size_t n, const char *one, char final)
+{
+    if (n == 0)
+    {
+        return;
+    }
+    if (n == 1)
+    {
+        emit_str(e, one);
+        return;
+    }
+    char seq[32];
+    int k = snprintf(seq, sizeof(seq), "\033[%zu%c", n, final);
+    emit(e, seq, k);
+}
+
+// everything a key produced goes out in one write
+static void flush_output(struct editor *e)
+{
+    size_t done = 0;
+    while (done < e->output_len)
+    {
+        ssize_t n = write(e->out, e->output + done, e->output_len - done);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        done += n;
+    }
+    e->output_len = 0;
+}
+
+// East Asian wide characters and emoji take two columns
+static bool is_wide(unsigned cp)
+{
+    return (cp >= 0x1100 && cp <= 0x115f) || (cp >= 0x2e80 && cp <= 0xa4cf) || (cp >= 0xac00 && cp <= 0xd7a3) ||
+           (cp >= 0xf900 && cp <= 0xfaff) || (cp >= 0xfe30 && cp <= 0xfe4f) || (cp >= 0xff00 && cp <= 0xff60) ||
+           (cp >= 0xffe0 && cp <= 0xffe6) || (cp >= 0x1f300 && cp <= 0x1f64f) || (cp >= 0x1f900 && cp <= 0x1f9ff) ||
+           (cp >= 0x20000 && cp <= 0x3fffd);
+}
+
+// columns s takes on the terminal, escape sequences take none
+static size_t display_width(const char *s, size_t len)
+{
+    const unsigned char *u = (const unsigned char *)s;
+    size_t width = 0;
+    size_t i = 0;
+    while (i < len)
+    {
+        if (u[i] == '\033')
+        {
+            // CSI parameters up to the final byte
+            i++;
+            if (i < len && u[i] == '[')
+            {
+                i++;
+                while (i < len && (u[i] < 0x40 || u[i] > 0x7e))
+                {
+                    i++;
+                }
+            }
+            i++;
+            continue;
+        }
+
+        unsigned cp = u[i];
+        size_t n = 1;
+        if (u[i] >= 0xf0)
+        {
+            cp &= 0x07;
+            n = 4;
+        }
+        else if (u[i] >= 0xe0)
+        {
+            cp &= 0x0f;
+            n = 3;
+        }
+        else if (u[i] >= 0xc0)
+        {
+            cp &= 0x1f;
+            n = 2;
+        }
+        else if (u[i] >= 0x80)
+        {
+            // stray continuation byte
+            i++;
+            continue;
+        }
+        for (size_t k = 1; k < n && i + k < len; k++)
+        {
+            cp = (cp << 6) | (u[i + k] & 0x3f);
+        }
+        i += n;
+        if (cp >= 0x20 && (cp < 0x7f || cp >= 0xa0))
+        {
+            width += is_wide(cp) ? 2 : 1;
+        }
+    }
+    return width;
+}
+
+static bool is_continuation(char c)
+{
+    return (c & 0xc0) == 0x80;
+}
+
+static size_t prev_char(const char *s, size_t i)
+{
+    do
+    {
+        i--;
+    } while (i > 0 && is_continuation(s[i]));
+    return i;
+}
+
+static size_t next_char(const char *s, size_t len, size_t i)
+{
+    do
+    {
+        i++;
+    } while (i < len && is_continuation(s[i]));
+    return i;
+}
+
+// move the terminal cursor to a column counted from the prompt's start,
+// rows follow from the terminal width
+static void move_cursor(struct editor *e, size_t to)
+{
+    size_t from = e->cursor_col;
+    size_t cols = e->cols;
+    if (from / cols > to / cols)
+    {
+        emit_motion(e, from / cols - to / cols, UP, 'A');
+    }
+    else
+    {
+        emit_motion(e, to / cols - from / cols, DOWN, 'B');
+    }
+    if (from % cols > to % cols)
+    {
+        emit_motion(e, from % cols - to % cols, LEFT, 'D');
+    }
+    else
+    {
+        emit_motion(e, to % cols - from % cols, RIGHT, 'C');
+    }
+    e->cursor_col = to;
+}
+
+// prompt shown while searching
+static size_t search_prompt(struct editor *e, char *buf, size_t size)
+{
+    int n = snprintf(buf, size, "(%sreverse-i-search)`%.*s': ", e->failed ? "failed " : "", (int)e->query_len, e->query);
+    return n < (int)size ? (size_t)n : size - 1;
+}
+
+// bring the terminal up to date with prompt and line; only the part from
+// the first difference with what it shows is written
+static void refresh(struct editor *e)
+{
+    struct winsize ws;
+    e->cols = ioctl(e->out, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 ? ws.ws_col : 80;
+
+    char search[sizeof(e->query) + 64];
+    const char *prompt = e->prompt;
+    size_t prompt_len = e->prompt_len;
+    if (e->searching)
+    {
+        prompt = search;
+        prompt_len = search_prompt(e, search, sizeof(search));
+    }
+    size_t prompt_width = display_width(prompt, prompt_len);
+
+    // same prompt: skip the common start of the line, on a character boundary
+    size_t start = 0;
+    size_t start_col = 0;
+    bool same_prompt = prompt_len == e->shown_prompt_len && memcmp(prompt, e->shown, prompt_len) == 0;
+    if (same_prompt)
+    {
+        const char *old = e->shown + prompt_len;
+        size_t old_len = e->shown_len - prompt_len;
+        while (start < e->len && start < old_len && e->buf[start] == old[start])
+        {
+            start++;
+        }
+        while (start > 0 && start < e->len && is_continuation(e->buf[start]))
+        {
+            start--;
+        }
+        start_col = prompt_width + display_width(e->buf, start);
+    }
+
+    size_t end_col = prompt_width + display_width(e->buf, e->len);
+    size_t old_end_col = display_width(e->shown, e->shown_len);
+    if (!same_prompt || start < e->len || old_end_col > end_col)
+    {
+        move_cursor(e, start_col);
+        if (!same_prompt)
+        {
+            emit(e, prompt, prompt_len);
+        }
+        emit(e, e->buf + start, e->len - start);
+        if (end_col > start_col && end_col % e->cols == 0)
+        {
+            // the terminal holds the cursor in the last column until the
+            // next character, take it to the next row like the columns say
+            emit_str(e, "\r\n");
+        }
+        if (old_end_col > end_col)
+        {
+            emit_str(e, CLEAR_BELOW);
+        }
+        e->cursor_col = end_col;
+    }
+    move_cursor(e, prompt_width + display_width(e->buf, e->pos));
+
+    // remember what is shown now
+    grow(&e->shown, &e->shown_cap, prompt_len + e->len);
+    memcpy(e->shown, prompt, prompt_len);
+    memcpy(e->shown + prompt_len, e->buf, e->len);
+    e->shown_len = prompt_len + e->len;
+    e->shown_prompt_len = prompt_len;
+}
+
+// the terminal shows nothing of the line any more
+static void forget_shown(struct editor *e)
+{
+    e->shown_len = 0;
+    e->shown_prompt_len = 0;
+    e->cursor_col = 0;
+}
+
+// clear the line, let the watcher print in the normal modes, and draw the
+// line again below what it printed
+static void run_notify(struct editor *e)
+{
+    move_cursor(e, 0);
+    emit_str(e, CLEAR_BELOW);
+    flush_output(e);
+    tcsetattr(e->in, TCSADRAIN, &e->cooked);
+    e->notify();
+    tcsetattr(e->in, TCSADRAIN, &e->raw);
+    forget_shown(e);
+    refresh(e);
+    flush_output(e);
+}
+
+// next byte from the terminal, -1 at the end of the input and -2 when
+// nothing came within timeout ms; only while waiting for a key for as long
+// as it takes (timeout -1) is the watched fd served
+static int next_byte(struct editor *e, int timeout)
+{
+    while (e->input_start == e->input_end)
+    {
+        bool watch = timeout < 0 && e->notify != NULL;
+        struct pollfd fds[2] = {{e->in, POLLIN, 0}, {e->notify_fd, POLLIN, 0}};
+        int ready = poll(fds, watch ? 2 : 1, timeout);
+        if (ready == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (ready == 0)
+        {
+            return -2;
+        }
+        if (watch && fds[1].revents & POLLIN)
+        {
+            run_notify(e);
+        }
+        if (fds[0].revents == 0)
+        {
+            continue;
+        }
+
+        ssize_t n = read(e->in, e->input, sizeof(e->input));
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return -1;
+        }
+        e->input_start = 0;
+        e->input_end = n;
+    }
+    return e->input[e->input_start++];
+}
+
+// a byte, or a key from an escape sequence, -1 at the end of the input
+static int read_key(struct editor *e)
+{
+    int c = next_byte(e, -1);
+    if (c != '\033')
+    {
+        return c;
+    }
+
+    // a lone Escape is not followed by anything straight away
+    int kind = next_byte(e, ESCAPE_TIMEOUT);
+    if (kind == -2)
+    {
+        return '\033';
+    }
+    if (kind != '[' && kind != 'O')
+    {
+        return kind == -1 ? -1 : KEY_NONE;
+    }
+
+    // numeric parameters, then the final byte
+    int number = 0;
+    bool first = true;
+    int final = next_byte(e, ESCAPE_TIMEOUT);
+    while ((final >= '0' && final <= '9') || final == ';')
+    {
+        if (final == ';')
+        {
+            first = false;
+        }
+        else if (first)
+        {
+            number = number * 10 + final - '0';
+        }
+        final = next_byte(e, ESCAPE_TIMEOUT);
+    }
+
+    switch (final)
+    {
+    case 'A':
+        return KEY_UP;
+    case 'B':
+        return KEY_DOWN;
+    case 'C':
+        return KEY_RIGHT;
+    case 'D':
+        return KEY_LEFT;
+    case 'H':
+        return KEY_HOME;
+    case 'F':
+        return KEY_END;
+    case '~':
+        switch (number)
+        {
+        case 1:
+        case 7:
+            return KEY_HOME;
+        case 3:
+            return KEY_DELETE;
+        case 4:
+        case 8:
+            return KEY_END;
+        }
+        return KEY_NONE;
+    case -1:
+        return -1;
+    default:
+        return KEY_NONE;
+    }
+}
+
+// printable ASCII and the bytes of UTF-8 sequences
+static bool is_text(int key)
+{
+    return (key >= 0x20 && key < 0x7f) || (key >= 0x80 && key < 256);
+}
+
+static void insert(struct editor *e, const char *s, size_t n)
+{
+    grow(&e->buf, &e->cap, e->len + n + 1);
+    memmove(e->buf + e->pos + n, e->buf + e->pos, e->len - e->pos);
+    memcpy(e->buf + e->pos, s, n);
+    e->len += n;
+    e->pos += n;
+}
+
+static void delete_range(struct editor *e, size_t from, size_t to)
+{
+    memmove(e->buf + from, e->buf + to, e->len - to);
+    e->len -= to - from;
+    if (e->pos >= to)
+    {
+        e->pos -= to - from;
+    }
+    else if (e->pos > from)
+    {
+        e->pos = from;
+    }
+}
+
+// replace the line, with the cursor at its end
+static void set_line(struct editor *e, const char *s, size_t n)
+{
+    e->len = 0;
+    e->pos = 0;
+    insert(e, s, n);
+}
+
+static void save_line(struct editor *e)
+{
+    grow(&e->saved, &e->saved_cap, e->len + 1);
+    memcpy(e->saved, e->buf, e->len);
+    e->saved_len = e->len;
+}
+
+// the line as it was before browsing or searching started
+static void restore_line(struct editor *e)
+{
+    size_t n;
+    const char *text = e->history_pos ? history_get(e->history_pos, &n) : NULL;
+    if (text != NULL)
+    {
+        set_line(e, text, n);
+    }
+    else
+    {
+        e->history_pos = 0;
+        set_line(e, e->saved, e->saved_len);
+    }
+}
+
+static void history_step(struct editor *e, int direction)
+{
+    long number;
+    if (direction < 0)
+    {
+        if (e->history_pos == 0)
+        {
+            number = history_last();
+            if (number == 0)
+            {
+                return;
+            }
+            save_line(e);
+        }
+        else if (e->history_pos > history_first())
+        {
+            number = e->history_pos - 1;
+        }
+        else
+        {
+            return;
+        }
+    }
+    else
+    {
+        if (e->history_pos == 0)
+        {
+            return;
+        }
+        // past the newest entry is the line that was being typed
+        number = e->history_pos < history_last() ? e->history_pos + 1 : 0;
+    }
+    e->history_pos = number;
+    restore_line(e);
+}
+
+// newest entry before the given one holding the query, kept on the line
+static void search_from(struct editor *e, long before)
+{
+    e->failed = false;
+    if (e->query_len == 0)
+    {
+        return;
+    }
+    long found = history_search(e->query, e->query_len, before);
+    if (found == 0)
+    {
+        e->failed = true;
+        return;
+    }
+    size_t n;
+    const char *text = history_get(found, &n);
+    e->match = found;
+    set_line(e, text, n);
+    const char *at = memmem(e->buf, e->len, e->query, e->query_len);
+    e->pos = at != NULL ? (size_t)(at - e->buf) : e->len;
+}
+
+// keys while searching, false when the key ends the search and is to be
+// handled as usual
+static bool search_key(struct editor *e, int key)
+{
+    if (key == CTRL_KEY('R'))
+    {
+        if (e->match != 0)
+        {
+            search_from(e, e->match);
+        }
+        return true;
+    }
+    if (key == 127 || key == CTRL_KEY('H'))
+    {
+        if (e->query_len > 0)
+        {
+            e->query_len = prev_char(e->query, e->query_len);
+            e->match = 0;
+            search_from(e, 0);
+        }
+        return true;
+    }
+    if (key == CTRL_KEY('G') || key == CTRL_KEY('C'))
+    {
+        e->searching = false;
+        restore_line(e);
+        return true;
+    }
+    if (is_text(key))
+    {
+        if (e->query_len < sizeof(e->query))
+        {
+            e->query[e->query_len++] = key;
+            // the entry shown may still match the longer query
+            search_from(e, e->match ? e->match + 1 : 0);
+        }
+        return true;
+    }
+
+    // keep the entry found, and browse on from it
+    e->searching = false;
+    if (e->match != 0)
+    {
+        e->history_pos = e->match;
+    }
+    return key == '\033';
+}
+
+// candidates below the line in columns, like ls does; the line is drawn
+// again under them
+static void show_list(struct editor *e, const struct completion *c)
+{
+    size_t width = 0;
+    for (size_t i = 0; i < c->list_count; i++)
+    {
+        size_t w = display_width(c->list[i], strlen(c->list[i]));
+        width = w > width ? w : width;
+    }
+    width += 2;
+    size_t columns = e->cols / width ? e->cols / width : 1;
+    size_t rows = (c->list_count + columns - 1) / columns;
+
+    size_t pos = e->pos;
+    e->pos = e->len;
+    refresh(e);
+    e->pos = pos;
+    emit_str(e, "\r\n");
+    for (size_t row = 0; row < rows; row++)
+    {
+        for (size_t col = 0; col < columns; col++)
+        {
+            size_t i = col * rows + row;
+            if (i >= c->list_count)
+            {
+                break;
+            }
+            const char *name = c->list[i];
+            emit_str(e, name);
+            if (col + 1 < columns && i + rows < c->list_count)
+            {
+                for (size_t w = display_width(name, strlen(name)); w < width; w++)
+                {
+                    emit(e, " ", 1);
+                }
+            }
+        }
+        emit_str(e, "\r\n");
+    }
+    if (c->total > c->list_count)
+    {
+        char more[64];
+        int n = snprintf(more, sizeof(more), "... and %zu more\r\n", c->total - c->list_count);
+        emit(e, more, n);
+    }
+    forget_shown(e);
+}
+
+static void complete_word(struct editor *e)
+{
+    struct completion c;
+    memset(&c, 0, sizeof(c));
+    e->complete(e->buf, e->len, e->pos, &c);
+    if (c.insert_len > 0)
+    {
+        insert(e, c.insert, c.insert_len);
+    }
+    else if (c.list_count > 1)
+    {
+        show_list(e, &c);
+    }
+    else
+    {
+        emit_str(e, "\a");
+    }
+}
+
+static enum action handle_key(struct editor *e, int key)
+{
+    if (e->searching && search_key(e, key))
+    {
+        return EDIT;
+    }
+
+    switch (key)
+    {
+    case '\r':
+    case '\n':
+        return ACCEPT;
+    case CTRL_KEY('C'):
+        return CANCEL;
+    case CTRL_KEY('D'):
+        if (e->len == 0)
+        {
+            return END_OF_INPUT;
+        }
+        // fall through
+    case KEY_DELETE:
+        if (e->pos < e->len)
+        {
+            delete_range(e, e->pos, next_char(e->buf, e->len, e->pos));
+        }
+        break;
+    case 127:
+    case CTRL_KEY('H'):
+        if (e->pos > 0)
+        {
+            delete_range(e, prev_char(e->buf, e->pos), e->pos);
+        }
+        break;
+    case KEY_LEFT:
+    case CTRL_KEY('B'):
+        if (e->pos > 0)
+        {
+            e->pos = prev_char(e->buf, e->pos);
+        }
+        break;
+    case KEY_RIGHT:
+    case CTRL_KEY('F'):
+        if (e->pos < e->len)
+        {
+            e->pos = next_char(e->buf, e->len, e->pos);
+        }
+        break;
+    case KEY_HOME:
+    case CTRL_KEY('A'):
+        e->pos = 0;
+        break;
+    case KEY_END:
+    case CTRL_KEY('E'):
+        e->pos = e->len;
+        break;
+    case CTRL_KEY('K'):
+        delete_range(e, e->pos, e->len);
+        break;
+    case CTRL_KEY('U'):
+        delete_range(e, 0, e->pos);
+        break;
+    case CTRL_KEY('W'):
+    {
+        // the word before the cursor and the blanks after it
+        size_t from = e->pos;
+        while (from > 0 && e->buf[from - 1] == ' ')
+        {
+            from--;
+        }
+        while (from > 0 && e->buf[from - 1] != ' ')
+        {
+            from--;
+        }
+        delete_range(e, from, e->pos);
+        break;
+    }
+    case KEY_UP:
+    case CTRL_KEY('P'):
+        history_step(e, -1);
+        break;
+    case KEY_DOWN:
+    case CTRL_KEY('N'):
+        history_step(e, 1);
+        break;
+    case CTRL_KEY('R'):
+        if (e->history_pos == 0)
+        {
+            save_line(e);
+        }
+        e->searching = true;
+        e->query_len = 0;
+        e->match = 0;
+        e->failed = false;
+        break;
+    case '\t':
+        if (e->complete != NULL)
+        {
+            complete_word(e);
+        }
+        break;
+    case CTRL_KEY('L'):
+        emit_str(e, CLEAR);
+        forget_shown(e);
+        break;
+    default:
+        if (is_text(key))
+        {
+            char c = key;
+            insert(e, &c, 1);
+        }
+        break;
+    }
+    return EDIT;
+}
+
+void editor_init(struct editor *e, int in, int out)
+{
+    memset(e, 0, sizeof(*e));
+    e->in = in;
+    e->out = out;
+    e->notify_fd = -1;
+    e->cols = 80;
+}
+
+void editor_complete(struct editor *e, void (*complete)(const char *line, size_t len, size_t pos, struct completion *c))
+{
+    e->complete = complete;
+}
+
+void editor_watch(struct editor *e, int fd, void (*notify)(void))
+{
+    e->notify_fd = fd;
+    e->notify = notify;
+}
+
+char *editor_line(struct editor *e, const char *prompt, size_t prompt_len, size_t *len)
+{
+    // the modes commands left behind are the ones they get back
+    tcgetattr(e->in, &e->cooked);
+    e->raw = e->cooked;
+    e->raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    e->raw.c_oflag &= ~OPOST;
+    e->raw.c_cflag |= CS8;
+    e->raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    e->raw.c_cc[VMIN] = 1;
+    e->raw.c_cc[VTIME] = 0;
+    tcsetattr(e->in, TCSADRAIN, &e->raw);
+
+    e->prompt = prompt;
+    e->prompt_len = prompt_len;
+    grow(&e->buf, &e->cap, 1);
+    e->len = 0;
+    e->pos = 0;
+    e->history_pos = 0;
+    e->searching = false;
+    forget_shown(e);
+    refresh(e);
+    flush_output(e);
+
+    enum action action = EDIT;
+    while (action == EDIT)
+    {
+        int key = read_key(e);
+        action = key == -1 ? END_OF_INPUT : handle_key(e, key);
+        // a paste is drawn once, after its last byte
+        if (action == EDIT && e->input_start == e->input_end)
+        {
+            refresh(e);
+            flush_output(e);
+        }
+    }
+
+    // leave the cursor below the line
+    e->searching = false;
+    e->pos = e->len;
+    refresh(e);
+    if (action == CANCEL)
+    {
+        emit_str(e, "^C");
+        e->len = 0;
+    }
+    emit_str(e, "\r\n");
+    flush_output(e);
+    tcsetattr(e->in, TCSADRAIN, &e->cooked);
+
+    e->buf[e->len] = '\0';
+    *len = e->len;
+    return action == END_OF_INPUT ? NULL : e->buf;
+}
@@ -0,0 +1,91 @@
+// Line editor
+// Reads a line from the terminal in raw mode with cursor movement, history
+// browsing and incremental reverse search. Only the part of the line that
+// changed is redrawn, and all the output for one read from the terminal
+// goes out in a single write.
+
+#ifndef EDITOR_H
+#define EDITOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <termios.h>
+
+// what Tab produced: text to insert at the cursor or, when there is
+// nothing to insert, some of the candidates to show
+struct completion
+{
+    const char *insert;
+    size_t insert_len;
+    const char **list;
+    size_t list_count;
+    size_t total; // candidates, including the ones not listed
+};
+
+struct editor
+{
+    int in;
+    int out;
+    struct termios cooked; // modes to restore after each line
+    struct termios raw;
+    const char *prompt;
+    size_t prompt_len;
+
+    // the line being edited
+    char *buf;
+    size_t len;
+    size_t cap;
+    size_t pos; // cursor, a byte offset
+
+    // what the terminal shows: prompt and line as last drawn
+    char *shown;
+    size_t shown_len;
+    size_t shown_cap;
+    size_t shown_prompt_len;
+    size_t cursor_col; // terminal cursor, in columns from the prompt's start
+    size_t cols;
+
+    // bytes read but not handled yet, and output not written yet
+    unsigned char input[256];
+    size_t input_start;
+    size_t input_end;
+    char *output;
+    size_t output_len;
+    size_t output_cap;
+
+    // history browsing: entry shown, or 0 for the line being typed
+    long history_pos;
+    char *saved;
+    size_t saved_len;
+    size_t saved_cap;
+
+    // fills in a completion for the line and cursor, NULL for none
+    void (*complete)(const char *line, size_t len, size_t pos, struct completion *c);
+
+    // output that may arrive while a line is edited
+    int notify_fd;
+    void (*notify)(void);
+
+    // reverse search
+    bool searching;
+    char query[256];
+    size_t query_len;
+    long match;
+    bool failed;
+};
+
+// use the terminal on in and out
+void editor_init(struct editor *e, int in, int out);
+
+// call notify when fd becomes readable during editing; the line is cleared
+// first and drawn again afterwards so notify can print what it likes
+void editor_watch(struct editor *e, int fd, void (*notify)(void));
+
+// complete the word at the cursor with complete when Tab is pressed
+void editor_complete(struct editor *e, void (*complete)(const char *line, size_t len, size_t pos, struct completion *c));
+
+// show the prompt and read one line, NULL at end of input (Ctrl+D on an
+// empty line); the line stays valid until the next call
+char *editor_line(struct editor *e, const char *prompt, size_t prompt_len, size_t *len);
+
+#endif
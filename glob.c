@@ -0,0 +1,697 @@
+// Pathname expansion
+// A pattern is split at its slashes and each part compiled once: a part
+// without wildcards is used as it is, the others become a short program of
+// character, ?, * and [...] steps run against each name, after a check of
+// the length and of the text that has to follow the last *. A directory is
+// opened relative to its parent with openat() and read with large
+// getdents64 batches into a listing. Listings are kept until the next
+// command, so *.c *.h, or globs on both sides of a pipe, read a directory
+// once. Matches are built in the arena and pushed straight onto the
+// command's arguments, then sorted in place: there are never more of them
+// than entries read, so that is cheaper than keeping listings sorted.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "glob.h"
+
+#define GETDENTS_BUFFER (1 << 17)
+#define CACHE_INITIAL 64
+
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+enum step_type
+{
+    STEP_CHAR,  // one given byte
+    STEP_ANY,   // ?
+    STEP_STAR,  // *
+    STEP_CLASS, // [...]
+};
+
+struct step
+{
+    unsigned char type;
+    unsigned char c;      // STEP_CHAR
+    const uint8_t *class; // STEP_CLASS, a bit for every byte it matches
+};
+
+// the pattern between two slashes
+struct part
+{
+    const char *literal; // without its escapes, when it has no wildcard
+    bool globstar;       // **, any number of directories
+    struct step *steps;
+    int step_count;
+    bool has_star;
+    size_t min_len;    // bytes a name needs, one per step other than *
+    char *suffix;      // the characters after the last *
+    size_t suffix_len;
+};
+
+// the entries of a directory but . and .., in the order it gave them
+struct listing
+{
+    char *path; // as it starts the matches, "" for the current directory
+    size_t path_len;
+    uint32_t hash;
+    char *names;     // per entry a d_type byte and a NUL terminated name
+    size_t *entries; // offsets into names
+    size_t count;
+};
+
+static struct listing **cache;
+static size_t cache_capacity;
+static size_t cache_count;
+
+// one pattern being expanded
+struct walk
+{
+    struct arena *arena;
+    struct arglist *list;
+    const struct part *parts;
+    int part_count;
+    bool dirs_only; // the pattern ends in a slash
+    char *path;     // of the directory being read, ending in a slash
+    size_t path_len;
+    size_t path_cap;
+};
+
+static const struct
+{
+    const char *name;
+    int (*is)(int);
+} char_classes[] = {
+    {"alnum", isalnum}, {"alpha", isalpha}, {"blank", isblank}, {"cntrl", iscntrl}, {"digit", isdigit}, {"graph", isgraph},
+    {"lower", islower}, {"print", isprint}, {"punct", ispunct}, {"space", isspace}, {"upper", isupper}, {"xdigit", isxdigit},
+};
+
+static void reserve(void *buf, size_t *cap, size_t need, size_t item_size)
+{
+    if (need <= *cap)
+    {
+        return;
+    }
+    size_t size = *cap ? *cap : 256;
+    while (size < need)
+    {
+        size *= 2;
+    }
+    void *p = realloc(*(void **)buf, size * item_size);
+    if (p == NULL)
+    {
+        perror("realloc() error");
+        exit(EXIT_FAILURE);
+    }
+    *(void **)buf = p;
+    *cap = size;
+}
+
+void arglist_push(struct arglist *list, char *arg)
+{
+    // keep room for the terminating NULL
+    if (list->count + 1 >= list->capacity)
+    {
+        int grown = list->capacity == 0 ? 8 : 2 * list->capacity;
+        list->args = arena_grow(list->arena, list->args, list->capacity * sizeof(char *), grown * sizeof(char *));
+        list->capacity = grown;
+    }
+    list->args[list->count++] = arg;
+}
+
+// the first n bytes of s with the escaping backslashes taken out
+static char *unescape(struct arena *arena, const char *s, size_t n)
+{
+    char *out = arena_alloc(arena, n + 1);
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (s[i] == '\\' && i + 1 < n)
+        {
+            i++;
+        }
+        out[len++] = s[i];
+    }
+    out[len] = '\0';
+    return out;
+}
+
+// index of the ":]" ending the [:name:] at s[j], 0 when it is not one
+static size_t class_name_end(const char *s, size_t j, size_t n)
+{
+    if (j + 1 >= n || s[j] != '[' || s[j + 1] != ':')
+    {
+        return 0;
+    }
+    for (size_t k = j + 2; k + 1 < n; k++)
+    {
+        if (s[k] == ':' && s[k + 1] == ']')
+        {
+            return k;
+        }
+    }
+    return 0;
+}
+
+// index just past the ] closing the [ at s[i], 0 when it is not closed and
+// the [ is an ordinary character
+static size_t bracket_end(const char *s, size_t i, size_t n)
+{
+    size_t j = i + 1;
+    if (j < n && (s[j] == '!' || s[j] == '^'))
+    {
+        j++;
+    }
+    // a ] right at the start is one of the characters
+    if (j < n && s[j] == ']')
+    {
+        j++;
+    }
+    while (j < n && s[j] != ']')
+    {
+        size_t name_end = class_name_end(s, j, n);
+        if (name_end != 0)
+        {
+            j = name_end + 2;
+            continue;
+        }
+        j += s[j] == '\\' && j + 1 < n ? 2 : 1;
+    }
+    return j < n ? j + 1 : 0;
+}
+
+// the bytes matched by the bracket expression s[0..n), n just past its ]
+static const uint8_t *compile_class(struct arena *arena, const char *s, size_t n)
+{
+    uint8_t *bits = arena_alloc(arena, 32);
+    memset(bits, 0, 32);
+    size_t j = 1, end = n - 1;
+    bool negate = s[j] == '!' || s[j] == '^';
+    j += negate;
+    while (j < end)
+    {
+        size_t name_end = class_name_end(s, j, end + 1);
+        if (name_end != 0)
+        {
+            // an unknown class matches nothing
+            for (size_t k = 0; k < sizeof(char_classes) / sizeof(char_classes[0]); k++)
+            {
+                if (strlen(char_classes[k].name) == name_end - j - 2 && memcmp(char_classes[k].name, s + j + 2, name_end - j - 2) == 0)
+                {
+                    for (int c = 0; c < 256; c++)
+                    {
+                        bits[c >> 3] |= char_classes[k].is(c) ? 1 << (c & 7) : 0;
+                    }
+                }
+            }
+            j = name_end + 2;
+            continue;
+        }
+
+        unsigned char lo = s[j] == '\\' && j + 1 < end ? s[++j] : s[j];
+        j++;
+        unsigned char hi = lo;
+        // a - at the end is one of the characters
+        if (j + 1 < end && s[j] == '-')
+        {
+            j++;
+            hi = s[j] == '\\' && j + 1 < end ? s[++j] : s[j];
+            j++;
+        }
+        for (int c = lo; c <= hi; c++)
+        {
+            bits[c >> 3] |= 1 << (c & 7);
+        }
+    }
+    for (int k = 0; negate && k < 32; k++)
+    {
+        bits[k] = ~bits[k];
+    }
+    return bits;
+}
+
+static void compile_part(struct arena *arena, struct part *part, const char *s, size_t n)
+{
+    memset(part, 0, sizeof(struct part));
+    if (n == 2 && s[0] == '*' && s[1] == '*')
+    {
+        part->globstar = true;
+        return;
+    }
+
+    part->steps = arena_alloc(arena, n * sizeof(struct step));
+    bool wild = false;
+    for (size_t i = 0; i < n; i++)
+    {
+        struct step step = {STEP_CHAR, (unsigned char)s[i], NULL};
+        size_t close;
+        if (s[i] == '\\' && i + 1 < n)
+        {
+            step.c = s[++i];
+        }
+        else if (s[i] == '*')
+        {
+            wild = true;
+            if (part->step_count > 0 && part->steps[part->step_count - 1].type == STEP_STAR)
+            {
+                continue;
+            }
+            step.type = STEP_STAR;
+        }
+        else if (s[i] == '?')
+        {
+            wild = true;
+            step.type = STEP_ANY;
+        }
+        else if (s[i] == '[' && (close = bracket_end(s, i, n)) != 0)
+        {
+            wild = true;
+            step.type = STEP_CLASS;
+            step.class = compile_class(arena, s + i, close - i);
+            i = close - 1;
+        }
+        part->steps[part->step_count++] = step;
+    }
+    if (!wild)
+    {
+        part->literal = unescape(arena, s, n);
+        return;
+    }
+
+    int last_star = -1;
+    for (int i = 0; i < part->step_count; i++)
+    {
+        if (part->steps[i].type == STEP_STAR)
+        {
+            last_star = i;
+            continue;
+        }
+        part->min_len++;
+    }
+    part->has_star = last_star != -1;
+    if (!part->has_star)
+    {
+        return;
+    }
+    // the plain characters after the last * must end the name
+    int from = part->step_count;
+    while (from > last_star + 1 && part->steps[from - 1].type == STEP_CHAR)
+    {
+        from--;
+    }
+    part->suffix_len = part->step_count - from;
+    part->suffix = arena_alloc(arena, part->suffix_len + 1);
+    for (size_t k = 0; k < part->suffix_len; k++)
+    {
+        part->suffix[k] = part->steps[from + k].c;
+    }
+}
+
+static bool step_matches(const struct step *step, unsigned char c)
+{
+    switch (step->type)
+    {
+    case STEP_CHAR:
+        return step->c == c;
+    case STEP_ANY:
+        return true;
+    default:
+        return step->class[c >> 3] >> (c & 7) & 1;
+    }
+}
+
+static bool part_matches(const struct part *part, const char *name, size_t len)
+{
+    if (len < part->min_len || (!part->has_star && len != part->min_len))
+    {
+        return false;
+    }
+    // a leading dot has to be written out
+    if (name[0] == '.' && (part->steps[0].type != STEP_CHAR || part->steps[0].c != '.'))
+    {
+        return false;
+    }
+    if (part->suffix_len > 0 && memcmp(name + len - part->suffix_len, part->suffix, part->suffix_len) != 0)
+    {
+        return false;
+    }
+
+    // on a mismatch the last * takes one more byte and the rest is tried again
+    int step = 0, star = -1;
+    size_t i = 0, star_i = 0;
+    while (i < len)
+    {
+        if (step < part->step_count)
+        {
+            const struct step *s = &part->steps[step];
+            if (s->type == STEP_STAR)
+            {
+                star = ++step;
+                star_i = i;
+                continue;
+            }
+            if (step_matches(s, name[i]))
+            {
+                step++;
+                i++;
+                continue;
+            }
+        }
+        if (star == -1)
+        {
+            return false;
+        }
+        step = star;
+        i = ++star_i;
+    }
+    while (step < part->step_count && part->steps[step].type == STEP_STAR)
+    {
+        step++;
+    }
+    return step == part->step_count;
+}
+
+// FNV-1a
+static uint32_t hash_path(const char *s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+// slot holding the listing of path, or the empty slot where it belongs
+static struct listing **cache_slot(struct listing **slots, size_t size, const char *path, size_t len, uint32_t hash)
+{
+    size_t i = hash & (size - 1);
+    while (slots[i] != NULL && (slots[i]->hash != hash || slots[i]->path_len != len || memcmp(slots[i]->path, path, len) != 0))
+    {
+        i = (i + 1) & (size - 1);
+    }
+    return &slots[i];
+}
+
+static void cache_add(struct listing *l)
+{
+    if ((cache_count + 1) * 2 > cache_capacity)
+    {
+        size_t new_capacity = cache_capacity ? cache_capacity * 2 : CACHE_INITIAL;
+        struct listing **new_cache = calloc(new_capacity, sizeof(struct listing *));
+        if (new_cache == NULL)
+        {
+            perror("malloc() error");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < cache_capacity; i++)
+        {
+            if (cache[i] != NULL)
+            {
+                *cache_slot(new_cache, new_capacity, cache[i]->path, cache[i]->path_len, cache[i]->hash) = cache[i];
+            }
+        }
+        free(cache);
+        cache = new_cache;
+        cache_capacity = new_capacity;
+    }
+    *cache_slot(cache, cache_capacity, l->path, l->path_len, l->hash) = l;
+    cache_count++;
+}
+
+void glob_reset(void)
+{
+    if (cache_count > 0)
+    {
+        memset(cache, 0, cache_capacity * sizeof(struct listing *));
+        cache_count = 0;
+    }
+}
+
+// the listing of the directory open as fd, read unless a pattern before
+// this one already has
+static const struct listing *list_dir(struct walk *w, int fd)
+{
+    uint32_t hash = hash_path(w->path, w->path_len);
+    if (cache_count > 0)
+    {
+        struct listing *l = *cache_slot(cache, cache_capacity, w->path, w->path_len, hash);
+        if (l != NULL)
+        {
+            return l;
+        }
+    }
+
+    // read into buffers kept between directories, then copied to the arena
+    static char *dents;
+    static char *names;
+    static size_t names_cap;
+    static size_t *entries;
+    static size_t entries_cap;
+    if (dents == NULL && (dents = malloc(GETDENTS_BUFFER)) == NULL)
+    {
+        perror("malloc() error");
+        exit(EXIT_FAILURE);
+    }
+    size_t names_len = 0, count = 0;
+    long n;
+    // a directory that cannot be read lists nothing
+    while ((n = syscall(SYS_getdents64, fd, dents, GETDENTS_BUFFER)) > 0)
+    {
+        for (long pos = 0; pos < n;)
+        {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(dents + pos);
+            pos += d->d_reclen;
+            if (d->d_name[0] == '.' && (d->d_name[1] == '\0' || (d->d_name[1] == '.' && d->d_name[2] == '\0')))
+            {
+                continue;
+            }
+            size_t len = strlen(d->d_name) + 1;
+            reserve(&names, &names_cap, names_len + len + 1, 1);
+            reserve(&entries, &entries_cap, count + 1, sizeof(size_t));
+            entries[count++] = names_len;
+            names[names_len] = d->d_type;
+            memcpy(names + names_len + 1, d->d_name, len);
+            names_len += len + 1;
+        }
+    }
+
+    struct listing *l = arena_alloc(w->arena, sizeof(struct listing));
+    l->path = arena_strndup(w->arena, w->path, w->path_len);
+    l->path_len = w->path_len;
+    l->hash = hash;
+    l->names = arena_alloc(w->arena, names_len);
+    memcpy(l->names, names, names_len);
+    l->entries = arena_alloc(w->arena, count * sizeof(size_t));
+    memcpy(l->entries, entries, count * sizeof(size_t));
+    l->count = count;
+    cache_add(l);
+    return l;
+}
+
+// whether an entry of the directory open as fd is a directory; a symlink
+// to one only counts when follow is set
+static bool entry_is_dir(int fd, const char *entry, bool follow)
+{
+    unsigned char type = entry[0];
+    if (type == DT_DIR)
+    {
+        return true;
+    }
+    if (type != DT_UNKNOWN && (type != DT_LNK || !follow))
+    {
+        return false;
+    }
+    struct stat st;
+    return fstatat(fd, entry + 1, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void path_append(struct walk *w, const char *s, size_t len)
+{
+    // and room for the slash a directory gets
+    reserve(&w->path, &w->path_cap, w->path_len + len + 2, 1);
+    memcpy(w->path + w->path_len, s, len);
+    w->path_len += len;
+}
+
+static void push_match(struct walk *w)
+{
+    char *match = arena_alloc(w->arena, w->path_len + 2);
+    memcpy(match, w->path, w->path_len);
+    size_t len = w->path_len;
+    if (w->dirs_only)
+    {
+        match[len++] = '/';
+    }
+    match[len] = '\0';
+    arglist_push(w->list, match);
+}
+
+static void walk_dir(struct walk *w, int fd, int i);
+
+// go on with part i in the directory name, the last thing on the path
+static void descend(struct walk *w, int fd, const char *name, int i)
+{
+    int sub = openat(fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (sub == -1)
+    {
+        return;
+    }
+    w->path[w->path_len++] = '/';
+    walk_dir(w, sub, i);
+    close(sub);
+}
+
+// match part i and the ones after it in the directory open as fd
+static void walk_dir(struct walk *w, int fd, int i)
+{
+    const struct part *part = &w->parts[i];
+    bool last = i == w->part_count - 1;
+    size_t base = w->path_len;
+
+    if (part->literal != NULL)
+    {
+        // no need to read the directory, the name is there or not
+        path_append(w, part->literal, strlen(part->literal));
+        struct stat st;
+        if (!last)
+        {
+            descend(w, fd, part->literal, i + 1);
+        }
+        else if (fstatat(fd, part->literal, &st, w->dirs_only ? 0 : AT_SYMLINK_NOFOLLOW) == 0 && (!w->dirs_only || S_ISDIR(st.st_mode)))
+        {
+            push_match(w);
+        }
+        w->path_len = base;
+        return;
+    }
+
+    const struct listing *l = list_dir(w, fd);
+    if (part->globstar && !last)
+    {
+        // ** standing for no directory at all
+        walk_dir(w, fd, i + 1);
+    }
+    for (size_t k = 0; k < l->count; k++)
+    {
+        const char *entry = l->names + l->entries[k];
+        const char *name = entry + 1;
+        size_t len = strlen(name);
+        if (part->globstar ? name[0] == '.' : !part_matches(part, name, len))
+        {
+            continue;
+        }
+        path_append(w, name, len);
+        if (part->globstar)
+        {
+            if (last && (!w->dirs_only || entry_is_dir(fd, entry, true)))
+            {
+                push_match(w);
+            }
+            // symlinks are not followed, so a loop cannot make it endless
+            if (entry_is_dir(fd, entry, false))
+            {
+                descend(w, fd, name, i);
+            }
+        }
+        else if (!last)
+        {
+            // only what may be a directory is opened
+            if (entry[0] == DT_DIR || entry[0] == DT_LNK || entry[0] == DT_UNKNOWN)
+            {
+                descend(w, fd, name, i + 1);
+            }
+        }
+        else if (!w->dirs_only || entry_is_dir(fd, entry, true))
+        {
+            push_match(w);
+        }
+        w->path_len = base;
+    }
+}
+
+static int compare_strings(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+void glob_expand(struct arglist *list, const char *pattern)
+{
+    struct arena *arena = list->arena;
+    size_t n = strlen(pattern);
+    int slashes = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        slashes += pattern[i] == '/';
+    }
+
+    // split at the slashes, a run of them counts as one
+    struct part *parts = arena_alloc(arena, (slashes + 1) * sizeof(struct part));
+    int part_count = 0, wild_parts = 0;
+    for (size_t i = 0; i < n;)
+    {
+        while (i < n && pattern[i] == '/')
+        {
+            i++;
+        }
+        size_t start = i;
+        while (i < n && pattern[i] != '/')
+        {
+            i += pattern[i] == '\\' && i + 1 < n && pattern[i + 1] != '/' ? 2 : 1;
+        }
+        if (i == start)
+        {
+            continue;
+        }
+        compile_part(arena, &parts[part_count], pattern + start, i - start);
+        if (parts[part_count].globstar && part_count > 0 && parts[part_count - 1].globstar)
+        {
+            continue;
+        }
+        wild_parts += parts[part_count].literal == NULL;
+        part_count++;
+    }
+    if (wild_parts == 0)
+    {
+        arglist_push(list, unescape(arena, pattern, n));
+        return;
+    }
+
+    // the matches start with the slashes the pattern starts with, //x too
+    size_t leading = strspn(pattern, "/");
+    bool absolute = leading > 0;
+    struct walk w = {arena, list, parts, part_count, pattern[n - 1] == '/', NULL, 0, 0};
+    path_append(&w, pattern, leading);
+    int first = list->count;
+    int fd = open(absolute ? "/" : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd != -1)
+    {
+        walk_dir(&w, fd, 0);
+        close(fd);
+    }
+    free(w.path);
+
+    if (list->count == first)
+    {
+        arglist_push(list, unescape(arena, pattern, n));
+    }
+    else
+    {
+        qsort(list->args + first, list->count - first, sizeof(char *), compare_strings);
+    }
+}
@@ -0,0 +1,30 @@
+// Pathname expansion
+// *, ?, [...] and ** in a word are matched against file names. The pattern
+// comes from the lexer with every quoted character escaped by a backslash,
+// so only the wildcards that were written bare take effect.
+
+#ifndef GLOB_H
+#define GLOB_H
+
+#include "arena.h"
+
+// a NULL terminated argument list growing in an arena
+struct arglist
+{
+    struct arena *arena;
+    char **args;
+    int count;
+    int capacity;
+};
+
+void arglist_push(struct arglist *list, char *arg);
+
+// push the paths matching pattern onto list, sorted, or the pattern itself
+// without its escapes when nothing matches
+void glob_expand(struct arglist *list, const char *pattern);
+
+// forget the directories read so far, they may change before the next
+// command is expanded
+void glob_reset(void);
+
+#endif
@@ -0,0 +1,654 @@
+// Command history
+// Entries loaded from the file point into the mapping, the ones entered
+// later are malloc'ed copies. The ring grows up to its limit and then the
+// newest entry replaces the oldest. Lines entered before the history was
+// first used wait in a pending list and go into the ring after the file's.
+// Search goes through a trigram index: every three byte sequence maps to
+// the entries that contain it, and a query only checks the entries on the
+// shortest list among its trigrams. Lines are indexed as they arrive. The
+// entries loaded from the file are indexed backwards from the newest, in
+// chunks that double each time a search runs out of indexed entries, so
+// finding a recent command does not pay for indexing a million old ones.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "history.h"
+#include "vars.h"
+#include "redirect.h"
+
+#define DEFAULT_HISTSIZE 100000
+#define HISTORY_FILE ".shell_history"
+#define INDEX_INITIAL_CAPACITY 4096
+#define INDEX_FIRST_CHUNK 16384
+
+struct history_entry
+{
+    const char *text; // not NUL terminated
+    size_t len;
+    bool owned; // malloc'ed, otherwise in the mapping
+};
+
+// entries containing one trigram
+struct posting_list
+{
+    uint32_t key; // trigram + 1, 0 for an empty slot
+
+    // entries that arrived since the index was started, ascending
+    uint32_t *newer;
+    size_t newer_start; // the ones before it fell out of the ring
+    size_t newer_len, newer_cap;
+
+    // entries indexed going back from there, descending
+    uint32_t *older;
+    size_t older_len, older_cap;
+};
+
+static struct history_entry *ring;
+static size_t ring_cap;
+static size_t max_entries = DEFAULT_HISTSIZE;
+static size_t head;   // slot of the oldest entry
+static long base = 1; // number of the oldest entry
+static long count;
+
+static int history_fd = -1;
+static const char *map;
+static size_t map_len;
+static bool loaded;
+static struct history_entry *pending;
+static size_t pending_count, pending_cap;
+static char *previous; // last line added, to skip repeats
+static size_t previous_len;
+
+static struct posting_list *lists;
+static size_t lists_cap, lists_used;
+static bool indexed;
+static long indexed_from; // oldest entry in the index
+static long index_chunk = INDEX_FIRST_CHUNK;
+
+static void *grow(void *p, size_t *cap, size_t need, size_t size)
+{
+    if (need <= *cap)
+    {
+        return p;
+    }
+    size_t new_cap = *cap ? *cap : 16;
+    while (new_cap < need)
+    {
+        new_cap *= 2;
+    }
+    p = realloc(p, new_cap * size);
+    if (p == NULL)
+    {
+        perror("realloc() error");
+        exit(EXIT_FAILURE);
+    }
+    *cap = new_cap;
+    return p;
+}
+
+static char *copy_text(const char *text, size_t len)
+{
+    char *copy = malloc(len + 1);
+    if (copy == NULL)
+    {
+        perror("malloc() error");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+void history_init(void)
+{
+    const char *size = vars_get("SHELL_HISTSIZE");
+    if (size != NULL && atol(size) > 0)
+    {
+        max_entries = atol(size);
+    }
+
+    char path[4096];
+    const char *file = vars_get("SHELL_HISTFILE");
+    if (file == NULL)
+    {
+        const char *home = vars_get("HOME");
+        snprintf(path, sizeof(path), "%s/%s", home ? home : ".", HISTORY_FILE);
+        file = path;
+    }
+
+    history_fd = open(file, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (history_fd == -1)
+    {
+        perror("open() history error");
+        return;
+    }
+    history_fd = redirect_private(history_fd);
+    struct stat st;
+    if (fstat(history_fd, &st) == 0 && st.st_size > 0)
+    {
+        void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, history_fd, 0);
+        if (m != MAP_FAILED)
+        {
+            map = m;
+            map_len = st.st_size;
+        }
+    }
+
+    // the last line of the file is the one a repeat would match
+    size_t end = map_len;
+    while (end > 0 && map[end - 1] == '\n')
+    {
+        end--;
+    }
+    if (end > 0)
+    {
+        const char *nl = memrchr(map, '\n', end);
+        size_t start = nl ? (size_t)(nl - map) + 1 : 0;
+        previous = copy_text(map + start, end - start);
+        previous_len = end - start;
+    }
+}
+
+static struct history_entry *entry(long number)
+{
+    return &ring[(head + (number - base)) % ring_cap];
+}
+
+static uint32_t trigram_at(const char *s)
+{
+    return (uint32_t)(unsigned char)s[0] << 16 | (uint32_t)(unsigned char)s[1] << 8 | (unsigned char)s[2];
+}
+
+static struct posting_list *find_list(struct posting_list *slots, size_t cap, uint32_t key)
+{
+    size_t i = (key * 2654435761u) & (cap - 1);
+    while (slots[i].key != 0 && slots[i].key != key)
+    {
+        i = (i + 1) & (cap - 1);
+    }
+    return &slots[i];
+}
+
+static struct posting_list *list_for(uint32_t trigram, bool create)
+{
+    uint32_t key = trigram + 1;
+    if (create && (lists_used + 1) * 2 > lists_cap)
+    {
+        size_t cap = lists_cap ? lists_cap * 2 : INDEX_INITIAL_CAPACITY;
+        struct posting_list *slots = calloc(cap, sizeof(struct posting_list));
+        if (slots == NULL)
+        {
+            perror("calloc() error");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < lists_cap; i++)
+        {
+            if (lists[i].key != 0)
+            {
+                *find_list(slots, cap, lists[i].key) = lists[i];
+            }
+        }
+        free(lists);
+        lists = slots;
+        lists_cap = cap;
+    }
+    if (lists_cap == 0)
+    {
+        return NULL;
+    }
+
+    struct posting_list *l = find_list(lists, lists_cap, key);
+    if (l->key == 0)
+    {
+        if (!create)
+        {
+            return NULL;
+        }
+        l->key = key;
+        lists_used++;
+    }
+    return l;
+}
+
+// entries that fell out of the ring are at the end of older and at the
+// start of newer
+static void drop_stale(struct posting_list *l)
+{
+    while (l->older_len > 0 && l->older[l->older_len - 1] < base)
+    {
+        l->older_len--;
+    }
+    while (l->newer_start < l->newer_len && l->newer[l->newer_start] < base)
+    {
+        l->newer_start++;
+    }
+    if (l->newer_start > 16 && l->newer_start * 2 > l->newer_len)
+    {
+        memmove(l->newer, l->newer + l->newer_start, (l->newer_len - l->newer_start) * sizeof(uint32_t));
+        l->newer_len -= l->newer_start;
+        l->newer_start = 0;
+    }
+}
+
+// add a new entry, or an older one when going back
+static void index_entry(long number, bool older)
+{
+    struct history_entry *e = entry(number);
+    for (size_t i = 0; i + 3 <= e->len; i++)
+    {
+        struct posting_list *l = list_for(trigram_at(e->text + i), true);
+        if (older)
+        {
+            if (l->older_len == 0 || l->older[l->older_len - 1] != number)
+            {
+                l->older = grow(l->older, &l->older_cap, l->older_len + 1, sizeof(uint32_t));
+                l->older[l->older_len++] = number;
+            }
+            continue;
+        }
+        if (l->newer_len == 0 || l->newer[l->newer_len - 1] != number)
+        {
+            drop_stale(l);
+            l->newer = grow(l->newer, &l->newer_cap, l->newer_len + 1, sizeof(uint32_t));
+            l->newer[l->newer_len++] = number;
+        }
+    }
+}
+
+// index entries back to number down_to
+static void extend_index(long down_to)
+{
+    if (indexed_from < base)
+    {
+        indexed_from = base;
+    }
+    while (indexed_from > down_to)
+    {
+        index_entry(--indexed_from, true);
+    }
+}
+
+static void push_entry(const char *text, size_t len, bool owned)
+{
+    if ((size_t)count == max_entries)
+    {
+        struct history_entry *oldest = &ring[head];
+        if (oldest->owned)
+        {
+            free((char *)oldest->text);
+        }
+        head = (head + 1) % ring_cap;
+        base++;
+        count--;
+    }
+    else if ((size_t)count == ring_cap)
+    {
+        // only grows before it first wraps, so head is still 0
+        size_t cap = ring_cap ? ring_cap * 2 : 1024;
+        ring_cap = 0;
+        ring = grow(ring, &ring_cap, cap < max_entries ? cap : max_entries, sizeof(struct history_entry));
+    }
+
+    long number = base + count;
+    count++;
+    *entry(number) = (struct history_entry){text, len, owned};
+    if (indexed)
+    {
+        index_entry(number, false);
+    }
+}
+
+// split the mapping into entries on first use
+static void load(void)
+{
+    if (loaded)
+    {
+        return;
+    }
+    loaded = true;
+
+    // walk back over as many lines as the ring keeps
+    size_t start = map_len > 0 && map[map_len - 1] == '\n' ? map_len - 1 : map_len;
+    size_t lines = 0;
+    while (start > 0)
+    {
+        const char *nl = memrchr(map, '\n', start);
+        if (nl == NULL)
+        {
+            start = 0;
+            break;
+        }
+        if (++lines == max_entries)
+        {
+            start = (nl - map) + 1;
+            break;
+        }
+        start = nl - map;
+    }
+
+    while (start < map_len)
+    {
+        const char *nl = memchr(map + start, '\n', map_len - start);
+        size_t end = nl ? (size_t)(nl - map) : map_len;
+        if (end > start)
+        {
+            push_entry(map + start, end - start, false);
+        }
+        start = end + 1;
+    }
+
+    for (size_t i = 0; i < pending_count; i++)
+    {
+        push_entry(pending[i].text, pending[i].len, true);
+    }
+    free(pending);
+    pending = NULL;
+    pending_count = pending_cap = 0;
+}
+
+void history_add(const char *line, size_t len)
+{
+    if (len == 0 || line[0] == ' ' || (previous != NULL && previous_len == len && memcmp(previous, line, len) == 0))
+    {
+        return;
+    }
+
+    // one write per line, O_APPEND keeps shells sharing the file apart
+    if (history_fd != -1)
+    {
+        struct iovec iov[2] = {{(void *)line, len}, {"\n", 1}};
+        if (writev(history_fd, iov, 2) == -1)
+        {
+            perror("write() history error");
+        }
+    }
+
+    free(previous);
+    previous = copy_text(line, len);
+    previous_len = len;
+
+    char *copy = copy_text(line, len);
+    if (loaded)
+    {
+        push_entry(copy, len, true);
+        return;
+    }
+    pending = grow(pending, &pending_cap, pending_count + 1, sizeof(struct history_entry));
+    pending[pending_count++] = (struct history_entry){copy, len, true};
+}
+
+long history_first(void)
+{
+    load();
+    return base;
+}
+
+long history_last(void)
+{
+    load();
+    return count ? base + count - 1 : 0;
+}
+
+const char *history_get(long number, size_t *len)
+{
+    load();
+    if (number < base || number >= base + count)
+    {
+        return NULL;
+    }
+    struct history_entry *e = entry(number);
+    *len = e->len;
+    return e->text;
+}
+
+long history_search(const char *needle, size_t len, long before)
+{
+    load();
+    if (before <= 0 || before > base + count)
+    {
+        before = base + count;
+    }
+
+    // too short for a trigram, read back from the newest
+    if (len < 3)
+    {
+        for (long n = before - 1; n >= base; n--)
+        {
+            struct history_entry *e = entry(n);
+            if (memmem(e->text, e->len, needle, len) != NULL)
+            {
+                return n;
+            }
+        }
+        return 0;
+    }
+
+    if (!indexed)
+    {
+        indexed = true;
+        indexed_from = base + count;
+    }
+
+    // check the indexed entries below before, and while there are none
+    // index another chunk and check that
+    long upper = before;
+    while (true)
+    {
+        if (indexed_from < base)
+        {
+            indexed_from = base;
+        }
+        long lower = indexed_from;
+
+        // every match is on the list of each trigram of the needle
+        struct posting_list *shortest = NULL;
+        size_t shortest_len = 0;
+        for (size_t i = 0; i + 3 <= len; i++)
+        {
+            struct posting_list *l = list_for(trigram_at(needle + i), false);
+            size_t l_len = l ? l->newer_len - l->newer_start + l->older_len : 0;
+            if (shortest == NULL || l_len < shortest_len)
+            {
+                shortest = l;
+                shortest_len = l_len;
+            }
+            if (l == NULL)
+            {
+                break;
+            }
+        }
+
+        if (shortest != NULL)
+        {
+            // newest first: newer from its end, then older from its start
+            size_t newer_left = shortest->newer_len - shortest->newer_start;
+            for (size_t k = 0; k < newer_left + shortest->older_len; k++)
+            {
+                long n = k < newer_left ? shortest->newer[shortest->newer_len - 1 - k] : shortest->older[k - newer_left];
+                if (n < lower)
+                {
+                    break;
+                }
+                struct history_entry *e = entry(n);
+                if (n < upper && memmem(e->text, e->len, needle, len) != NULL)
+                {
+                    return n;
+                }
+            }
+        }
+
+        if (indexed_from <= base)
+        {
+            return 0;
+        }
+        upper = indexed_from;
+        extend_index(indexed_from - index_chunk > base ? indexed_from - index_chunk : base);
+        index_chunk *= 2;
+    }
+}
+
+// newest entry that starts with prefix
+static long search_prefix(const char *prefix, size_t len)
+{
+    for (long n = base + count - 1; n >= base; n--)
+    {
+        struct history_entry *e = entry(n);
+        if (e->len >= len && memcmp(e->text, prefix, len) == 0)
+        {
+            return n;
+        }
+    }
+    return 0;
+}
+
+// characters that end a !prefix event
+static bool ends_event(char c)
+{
+    return isspace((unsigned char)c) || strchr(";&|<>()\"'", c) != NULL;
+}
+
+int history_expand(struct arena *arena, char **line, size_t *len)
+{
+    const char *in = *line;
+    size_t n = *len;
+    if (memchr(in, '!', n) == NULL)
+    {
+        return 0;
+    }
+    load();
+
+    size_t cap = n + 64, out_len = 0;
+    char *out = arena_alloc(arena, cap);
+    bool single_quoted = false, expanded = false;
+    for (size_t i = 0; i < n;)
+    {
+        const char *text = in + i;
+        size_t text_len = 1;
+        size_t consumed = 1;
+        char next = i + 1 < n ? in[i + 1] : '\0';
+
+        if (in[i] == '\'')
+        {
+            single_quoted = !single_quoted;
+        }
+        else if (in[i] == '\\' && next != '\0')
+        {
+            // the lexer removes the backslash later
+            text_len = consumed = 2;
+        }
+        else if (in[i] == '!' && !single_quoted && next != '\0' && !ends_event(next) && next != '=')
+        {
+            // a ! before a blank, quote or operator names no event and
+            // stays, as in echo "hi!"
+            // find the event and how much of the line names it
+            size_t j = i + 1;
+            long number = 0;
+            if (next == '!')
+            {
+                number = history_last();
+                j++;
+            }
+            else if (isdigit((unsigned char)next) || (next == '-' && i + 2 < n && isdigit((unsigned char)in[i + 2])))
+            {
+                long k = strtol(in + i + 1, NULL, 10);
+                j += next == '-';
+                while (j < n && isdigit((unsigned char)in[j]))
+                {
+                    j++;
+                }
+                number = k < 0 ? history_last() + 1 + k : k;
+            }
+            else if (next == '?')
+            {
+                const char *end = memchr(in + i + 2, '?', n - i - 2);
+                size_t query_end = end ? (size_t)(end - in) : n;
+                number = history_search(in + i + 2, query_end - i - 2, 0);
+                j = end ? query_end + 1 : n;
+            }
+            else
+            {
+                while (j < n && !ends_event(in[j]))
+                {
+                    j++;
+                }
+                number = search_prefix(in + i + 1, j - i - 1);
+            }
+
+            text = history_get(number, &text_len);
+            if (text == NULL)
+            {
+                fprintf(stderr, "%.*s: event not found\n", (int)(j - i), in + i);
+                return -1;
+            }
+            consumed = j - i;
+            expanded = true;
+        }
+
+        i += consumed;
+        if (out_len + text_len + 1 > cap)
+        {
+            size_t new_cap = (out_len + text_len + 1) * 2;
+            out = arena_grow(arena, out, cap, new_cap);
+            cap = new_cap;
+        }
+        memcpy(out + out_len, text, text_len);
+        out_len += text_len;
+    }
+    out[out_len] = '\0';
+
+    *line = out;
+    *len = out_len;
+    return expanded ? 1 : 0;
+}
+
+int history_builtin(char **args)
+{
+    load();
+    if (args[1] != NULL && strcmp(args[1], "-c") == 0)
+    {
+        // numbering goes on, the file is left alone
+        for (long n = base; n < base + count; n++)
+        {
+            if (entry(n)->owned)
+            {
+                free((char *)entry(n)->text);
+            }
+        }
+        base += count;
+        count = 0;
+        head = 0;
+        return 0;
+    }
+
+    long first = base;
+    if (args[1] != NULL)
+    {
+        char *end;
+        long last_n = strtol(args[1], &end, 10);
+        if (*end != '\0' || last_n < 0)
+        {
+            fprintf(stderr, "history: %s: numeric argument required\n", args[1]);
+            return 2;
+        }
+        if (last_n < count)
+        {
+            first = base + count - last_n;
+        }
+    }
+    for (long n = first; n < base + count; n++)
+    {
+        struct history_entry *e = entry(n);
+        printf("%5ld  %.*s\n", n, (int)e->len, e->text);
+    }
+    return 0;
+}
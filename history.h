@@ -0,0 +1,39 @@
+// Command history
+// Lines are kept in a ring of $SHELL_HISTSIZE entries (100000 by default)
+// and appended to $SHELL_HISTFILE (~/.shell_history by default) as they are
+// entered. The file is mmapped at startup and only split into entries when
+// the history is first used, so startup does not grow with the file.
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include "arena.h"
+
+// open and map the history file
+void history_init(void);
+
+// record a line: not empty lines, lines starting with a space, or a repeat
+// of the previous line
+void history_add(const char *line, size_t len);
+
+// number of the oldest and newest entries, newest is 0 when empty
+long history_first(void);
+long history_last(void);
+
+// text of an entry, not NUL terminated, NULL when out of the ring
+const char *history_get(long number, size_t *len);
+
+// newest entry before number that contains needle, 0 when none
+// a trigram index keeps this from reading every entry
+long history_search(const char *needle, size_t len, long before);
+
+// expand !!, !n, !-n, !prefix and !?text? into an arena copy of the line
+// returns 1 when something was expanded, 0 when not, -1 when an event was
+// not found (reported)
+int history_expand(struct arena *arena, char **line, size_t *len);
+
+// history [-c] [n]
+int history_builtin(char **args);
+
+#endif
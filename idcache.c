@@ -0,0 +1,129 @@
+// User and group name cache
+// getpwuid and getgrgid may reread /etc/passwd or ask LDAP on every call.
+// Names are kept in one open addressing table per kind, guarded by a mutex
+// so ls workers can share it; a miss does its lookup under the lock so no
+// id is ever resolved twice.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <grp.h>
+#include "idcache.h"
+
+#define INITIAL_CAPACITY 32
+
+struct id_entry
+{
+    unsigned id;
+    char *name; // NULL for an empty slot
+};
+
+struct id_table
+{
+    struct id_entry *slots;
+    size_t capacity;
+    size_t used;
+    pthread_mutex_t lock;
+};
+
+static struct id_table users = {NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+static struct id_table groups = {NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+
+static struct id_entry *find_slot(struct id_entry *slots, size_t capacity, unsigned id)
+{
+    size_t i = (id * 2654435761u) & (capacity - 1);
+    while (slots[i].name != NULL && slots[i].id != id)
+    {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &slots[i];
+}
+
+static bool reserve(struct id_table *t)
+{
+    if ((t->used + 1) * 2 <= t->capacity)
+    {
+        return true;
+    }
+    size_t capacity = t->capacity ? t->capacity * 2 : INITIAL_CAPACITY;
+    struct id_entry *slots = calloc(capacity, sizeof(struct id_entry));
+    if (slots == NULL)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < t->capacity; i++)
+    {
+        if (t->slots[i].name != NULL)
+        {
+            *find_slot(slots, capacity, t->slots[i].id) = t->slots[i];
+        }
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->capacity = capacity;
+    return true;
+}
+
+// resolve writes the name into buf, or returns false when the id has none
+static const char *lookup(struct id_table *t, unsigned id, bool (*resolve)(unsigned, char *, size_t))
+{
+    pthread_mutex_lock(&t->lock);
+    const char *name = NULL;
+    if (t->capacity > 0)
+    {
+        name = find_slot(t->slots, t->capacity, id)->name;
+    }
+    if (name == NULL && reserve(t))
+    {
+        char buf[4096];
+        if (!resolve(id, buf, sizeof(buf)))
+        {
+            snprintf(buf, sizeof(buf), "%u", id);
+        }
+
+        struct id_entry *e = find_slot(t->slots, t->capacity, id);
+        e->id = id;
+        e->name = strdup(buf);
+        t->used += e->name != NULL;
+        name = e->name;
+    }
+    pthread_mutex_unlock(&t->lock);
+    return name ? name : "?";
+}
+
+static bool resolve_user(unsigned id, char *out, size_t size)
+{
+    struct passwd pw, *result = NULL;
+    char buf[4096];
+    if (getpwuid_r(id, &pw, buf, sizeof(buf), &result) != 0 || result == NULL)
+    {
+        return false;
+    }
+    snprintf(out, size, "%s", pw.pw_name);
+    return true;
+}
+
+static bool resolve_group(unsigned id, char *out, size_t size)
+{
+    struct group gr, *result = NULL;
+    char buf[16384];
+    if (getgrgid_r(id, &gr, buf, sizeof(buf), &result) != 0 || result == NULL)
+    {
+        return false;
+    }
+    snprintf(out, size, "%s", gr.gr_name);
+    return true;
+}
+
+const char *user_name(uid_t uid)
+{
+    return lookup(&users, uid, resolve_user);
+}
+
+const char *group_name(gid_t gid)
+{
+    return lookup(&groups, gid, resolve_group);
+}
@@ -0,0 +1,14 @@
+// User and group name cache
+// Each uid and gid goes through NSS at most once per session.
+
+#ifndef IDCACHE_H
+#define IDCACHE_H
+
+#include <sys/types.h>
+
+// name of the user or group, or the id as text when it has none
+// the strings stay valid for the life of the shell, safe to call from threads
+const char *user_name(uid_t uid);
+const char *group_name(gid_t gid);
+
+#endif
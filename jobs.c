@@ -0,0 +1,903 @@
+// Job control
+// Jobs are kept in a list ordered by id. A status change read with waitpid()
+// is applied to the process it belongs to; a job is stopped when all of its
+// live processes are, and done when all of them have exited. The current
+// job ('+' in listings, the default for fg and bg) is the one most recently
+// started, stopped or continued, the previous one is marked '-'.
+// Children are collected with wait4() and their rusage is added to the job;
+// the SIGCHLD handler passes the time each child exited so a background job
+// is not charged for the time until the shell got round to reaping it.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "jobs.h"
+#include "usage.h"
+#include "trace.h"
+#include "redirect.h"
+
+enum job_state
+{
+    JOB_RUNNING,
+    JOB_STOPPED,
+    JOB_DONE
+};
+
+struct process
+{
+    pid_t pid;  // -1 when the stage could not be started
+    int status; // last status from waitpid
+    bool completed;
+    bool stopped;
+};
+
+struct job
+{
+    struct job *next;
+    int id;
+    unsigned long seq; // larger for the more recently used jobs
+    pid_t pgid;
+    char *command;
+    enum job_state reported; // state the user last heard about
+    struct termios tmodes;   // terminal modes saved when it stopped
+    bool has_tmodes;
+    bool foreground; // the shell is waiting for it and reports it itself
+    bool accounted;  // finished and its usage reported
+    struct job_usage usage;
+    int count;
+    struct process procs[];
+};
+
+static struct job *jobs;
+static unsigned long job_seq;
+static int chld_pipe[2] = {-1, -1};
+
+static bool interactive_shell;
+static bool terminal; // stdin is our controlling terminal and we own it
+static bool job_control; // interactive on a terminal: jobs get groups of their own
+static pid_t shell_pgid;
+static struct termios shell_tmodes;
+
+// what the SIGCHLD handler writes to the pipe
+struct chld_event
+{
+    pid_t pid;
+    struct timespec when; // CLOCK_MONOTONIC
+};
+
+// recent events read back from the pipe, by pid
+#define MAX_EVENTS 256
+static struct chld_event events[MAX_EVENTS];
+static int event_count;
+
+static const struct
+{
+    const char *name;
+    int number;
+} signal_names[] = {
+    {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"ILL", SIGILL}, {"TRAP", SIGTRAP}, {"ABRT", SIGABRT}, {"BUS", SIGBUS}, {"FPE", SIGFPE}, {"KILL", SIGKILL}, {"USR1", SIGUSR1}, {"SEGV", SIGSEGV}, {"USR2", SIGUSR2}, {"PIPE", SIGPIPE}, {"ALRM", SIGALRM}, {"TERM", SIGTERM}, {"CHLD", SIGCHLD}, {"CONT", SIGCONT}, {"STOP", SIGSTOP}, {"TSTP", SIGTSTP}, {"TTIN", SIGTTIN}, {"TTOU", SIGTTOU}, {"URG", SIGURG}, {"XCPU", SIGXCPU}, {"XFSZ", SIGXFSZ}, {"VTALRM", SIGVTALRM}, {"PROF", SIGPROF}, {"WINCH", SIGWINCH}, {"IO", SIGIO}, {"SYS", SIGSYS},
+};
+
+// only tells the main loop which child to reap and when it changed state,
+// signals that arrive together are merged so some children have no event
+static void sigchld_handler(int signum, siginfo_t *info, void *context)
+{
+    int saved_errno = errno;
+    struct chld_event e = {info->si_pid, {0, 0}};
+    clock_gettime(CLOCK_MONOTONIC, &e.when);
+    ssize_t n = write(chld_pipe[1], &e, sizeof(e)); // a full pipe already says it
+    (void)n;
+    errno = saved_errno;
+}
+
+void jobs_init(bool interactive)
+{
+    interactive_shell = interactive;
+    if (pipe2(chld_pipe, O_NONBLOCK | O_CLOEXEC) == -1)
+    {
+        perror("pipe() error");
+        exit(EXIT_FAILURE);
+    }
+    chld_pipe[0] = redirect_private(chld_pipe[0]);
+    chld_pipe[1] = redirect_private(chld_pipe[1]);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = sigchld_handler;
+    sa.sa_flags = SA_RESTART | SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, NULL);
+
+    // without job control the commands stay in the shell's process group,
+    // so whatever signals the group, like Ctrl+C, reaches them too
+    shell_pgid = getpgrp();
+    job_control = interactive && isatty(STDIN_FILENO);
+    if (!job_control)
+    {
+        return;
+    }
+
+    // started in the background of another shell: wait to be brought
+    // to the foreground
+    while (tcgetpgrp(STDIN_FILENO) != getpgrp())
+    {
+        kill(-getpgrp(), SIGTTIN);
+    }
+
+    // Ctrl+Z and reads from the terminal are for the jobs, not for us
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+
+    // lead our own group so the jobs can be given the terminal and back
+    if (getpgrp() != getpid() && setpgid(0, 0) == -1)
+    {
+        perror("setpgid() error");
+    }
+    tcsetpgrp(STDIN_FILENO, getpgrp());
+
+    shell_pgid = getpgrp();
+    terminal = tcgetpgrp(STDIN_FILENO) == shell_pgid;
+    if (terminal)
+    {
+        tcgetattr(STDIN_FILENO, &shell_tmodes);
+    }
+}
+
+void jobs_subshell(void)
+{
+    // the parent's jobs are not ours to wait for or report
+    while (jobs != NULL)
+    {
+        struct job *next = jobs->next;
+        free(jobs->command);
+        free(jobs);
+        jobs = next;
+    }
+    event_count = 0;
+
+    // events for our own children go to a pipe of our own
+    redirect_close_private(chld_pipe[0]);
+    redirect_close_private(chld_pipe[1]);
+    if (pipe2(chld_pipe, O_NONBLOCK | O_CLOEXEC) == -1)
+    {
+        perror("pipe() error");
+        exit(EXIT_FAILURE);
+    }
+    chld_pipe[0] = redirect_private(chld_pipe[0]);
+    chld_pipe[1] = redirect_private(chld_pipe[1]);
+
+    interactive_shell = false;
+    terminal = false;
+    job_control = false;
+    shell_pgid = getpgrp();
+}
+
+int jobs_fd(void)
+{
+    return chld_pipe[0];
+}
+
+struct job *job_create(const char *command, int count)
+{
+    struct job *j = calloc(1, sizeof(struct job) + count * sizeof(struct process));
+    if (j == NULL || (j->command = strdup(command)) == NULL)
+    {
+        perror("malloc() error");
+        exit(EXIT_FAILURE);
+    }
+    j->count = count;
+    j->pgid = job_control ? 0 : shell_pgid;
+    j->seq = ++job_seq;
+    j->reported = JOB_RUNNING;
+    clock_gettime(CLOCK_REALTIME, &j->usage.start);
+    clock_gettime(CLOCK_MONOTONIC, &j->usage.start_mono);
+
+    // ids count up from the last job, and start over once all are gone
+    struct job **tail = &jobs;
+    int id = 0;
+    while (*tail != NULL)
+    {
+        id = (*tail)->id;
+        tail = &(*tail)->next;
+    }
+    j->id = id + 1;
+    *tail = j;
+    return j;
+}
+
+void job_add_failed(struct job *j, int stage, int status)
+{
+    struct process *p = &j->procs[stage];
+    p->pid = -1;
+    p->completed = true;
+    p->status = W_EXITCODE(status, 0);
+}
+
+void job_add_process(struct job *j, int stage, pid_t pid)
+{
+    if (pid == -1)
+    {
+        job_add_failed(j, stage, 127);
+        return;
+    }
+
+    struct process *p = &j->procs[stage];
+    p->pid = pid;
+    if (!job_control)
+    {
+        return;
+    }
+    if (j->pgid == 0)
+    {
+        j->pgid = pid;
+    }
+    // the child joins on its own too, whichever side runs first wins
+    setpgid(pid, j->pgid);
+}
+
+pid_t job_pgid(const struct job *j)
+{
+    return job_control ? j->pgid : -1;
+}
+
+// the pid that stands for the job: its group, or its first process when
+// it shares the shell's
+static pid_t job_leader(const struct job *j)
+{
+    for (int i = 0; !job_control && i < j->count; i++)
+    {
+        if (j->procs[i].pid > 0)
+        {
+            return j->procs[i].pid;
+        }
+    }
+    return j->pgid;
+}
+
+// send sig to the job's group, or without job control to each of its
+// processes, which share the shell's group
+static int signal_job(struct job *j, int sig)
+{
+    if (job_control)
+    {
+        return kill(-j->pgid, sig);
+    }
+    int result = 0;
+    for (int i = 0; i < j->count; i++)
+    {
+        if (j->procs[i].pid > 0 && !j->procs[i].completed && kill(j->procs[i].pid, sig) == -1)
+        {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+static void remove_job(struct job *j)
+{
+    for (struct job **link = &jobs; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == j)
+        {
+            *link = j->next;
+            break;
+        }
+    }
+    free(j->command);
+    free(j);
+}
+
+static enum job_state job_state(const struct job *j)
+{
+    bool stopped = false;
+    for (int i = 0; i < j->count; i++)
+    {
+        if (!j->procs[i].completed)
+        {
+            if (!j->procs[i].stopped)
+            {
+                return JOB_RUNNING;
+            }
+            stopped = true;
+        }
+    }
+    return stopped ? JOB_STOPPED : JOB_DONE;
+}
+
+static int exit_code(int status)
+{
+    if (WIFEXITED(status))
+    {
+        return WEXITSTATUS(status);
+    }
+    if (WIFSIGNALED(status))
+    {
+        return 128 + WTERMSIG(status);
+    }
+    if (WIFSTOPPED(status))
+    {
+        return 128 + WSTOPSIG(status);
+    }
+    return 0;
+}
+
+// exit status of the job: its last process, or the signal that stopped it
+static int job_status(const struct job *j)
+{
+    if (job_state(j) == JOB_STOPPED)
+    {
+        for (int i = 0; i < j->count; i++)
+        {
+            if (j->procs[i].stopped)
+            {
+                return exit_code(j->procs[i].status);
+            }
+        }
+    }
+    return exit_code(j->procs[j->count - 1].status);
+}
+
+// a finished job gets its usage reported once
+static void account_job(struct job *j, const struct timespec *end)
+{
+    struct job_usage *u = &j->usage;
+    u->wall_ms = (end->tv_sec - u->start_mono.tv_sec) * 1000.0 + (end->tv_nsec - u->start_mono.tv_nsec) / 1000000.0;
+    j->accounted = true;
+    if (!j->foreground)
+    {
+        usage_report(u, j->command, j->id, true, job_status(j));
+    }
+}
+
+// apply a status from wait4 to the process it belongs to, end is when it
+// happened
+static void update_process(pid_t pid, int status, const struct rusage *r, const struct timespec *end)
+{
+    for (struct job *j = jobs; j != NULL; j = j->next)
+    {
+        for (int i = 0; i < j->count; i++)
+        {
+            struct process *p = &j->procs[i];
+            if (p->pid != pid)
+            {
+                continue;
+            }
+            if (WIFCONTINUED(status))
+            {
+                p->stopped = false;
+                return;
+            }
+            p->status = status;
+            p->stopped = WIFSTOPPED(status);
+            p->completed = !p->stopped;
+            if (p->completed)
+            {
+                usage_add(&j->usage, r);
+            }
+            if (!j->accounted && job_state(j) == JOB_DONE)
+            {
+                account_job(j, end);
+            }
+            return;
+        }
+    }
+}
+
+// when the handler saw pid change state, or now
+static struct timespec event_time(pid_t pid)
+{
+    struct timespec when;
+    for (int i = event_count; i-- > 0;)
+    {
+        if (events[i].pid == pid)
+        {
+            when = events[i].when;
+            events[i] = events[--event_count];
+            return when;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &when);
+    return when;
+}
+
+void jobs_reap(void)
+{
+    struct chld_event buf[64];
+    bool pending = false;
+    ssize_t n;
+    while ((n = read(chld_pipe[0], buf, sizeof(buf))) > 0)
+    {
+        pending = true;
+        for (size_t i = 0; i < n / sizeof(struct chld_event); i++)
+        {
+            // the oldest ones go first when there is no room
+            if (event_count == MAX_EVENTS)
+            {
+                memmove(events, events + 1, (MAX_EVENTS - 1) * sizeof(struct chld_event));
+                event_count--;
+            }
+            events[event_count++] = buf[i];
+        }
+    }
+    if (!pending)
+    {
+        return;
+    }
+
+    uint64_t start = trace_now();
+    int status;
+    struct rusage r;
+    pid_t pid;
+    while ((pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &r)) > 0)
+    {
+        struct timespec when = event_time(pid);
+        update_process(pid, status, &r, &when);
+    }
+    event_count = 0;
+    trace_end(TRACE_REAP, start, NULL);
+}
+
+// block until the job finishes or stops
+// returns false when a signal to the shell interrupted the wait
+static bool wait_job(struct job *j, bool interruptible)
+{
+    while (job_state(j) == JOB_RUNNING)
+    {
+        int status;
+        struct rusage r;
+        pid_t pid = wait4(-j->pgid, &status, WUNTRACED, &r);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (pid > 0)
+        {
+            update_process(pid, status, &r, &now);
+        }
+        else if (errno != EINTR)
+        {
+            // nothing left in the group, whatever it was is gone
+            for (int i = 0; i < j->count; i++)
+            {
+                j->procs[i].completed = true;
+            }
+            if (!j->accounted)
+            {
+                account_job(j, &now);
+            }
+        }
+        else if (interruptible)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void current_jobs(struct job **current, struct job **previous)
+{
+    *current = *previous = NULL;
+    for (struct job *j = jobs; j != NULL; j = j->next)
+    {
+        if (*current == NULL || j->seq > (*current)->seq)
+        {
+            *previous = *current;
+            *current = j;
+        }
+        else if (*previous == NULL || j->seq > (*previous)->seq)
+        {
+            *previous = j;
+        }
+    }
+}
+
+static void print_job(struct job *j, enum job_state state, bool long_format)
+{
+    struct job *current, *previous;
+    current_jobs(&current, &previous);
+    char mark = j == current ? '+' : j == previous ? '-' : ' ';
+
+    char text[64];
+    int status = j->procs[j->count - 1].status;
+    if (state == JOB_RUNNING)
+    {
+        snprintf(text, sizeof(text), "Running");
+    }
+    else if (state == JOB_STOPPED)
+    {
+        snprintf(text, sizeof(text), "Stopped");
+    }
+    else if (WIFSIGNALED(status))
+    {
+        snprintf(text, sizeof(text), "%s%s", strsignal(WTERMSIG(status)), WCOREDUMP(status) ? " (core dumped)" : "");
+    }
+    else if (exit_code(status) != 0)
+    {
+        snprintf(text, sizeof(text), "Exit %d", exit_code(status));
+    }
+    else
+    {
+        snprintf(text, sizeof(text), "Done");
+    }
+
+    if (long_format)
+    {
+        printf("[%d]%c %-7d %-24s %s\n", j->id, mark, (int)job_leader(j), text, j->command);
+    }
+    else
+    {
+        printf("[%d]%c  %-24s %s\n", j->id, mark, text, j->command);
+    }
+}
+
+void jobs_notify(void)
+{
+    jobs_reap();
+    struct job *next;
+    for (struct job *j = jobs; j != NULL; j = next)
+    {
+        next = j->next;
+        enum job_state state = job_state(j);
+        if (!interactive_shell)
+        {
+            // a script collects them with wait
+            continue;
+        }
+        if (state != j->reported)
+        {
+            print_job(j, state, false);
+            j->reported = state;
+        }
+        if (state == JOB_DONE)
+        {
+            remove_job(j);
+        }
+    }
+    fflush(stdout);
+}
+
+void job_give_terminal(struct job *j)
+{
+    if (terminal && j->pgid != 0)
+    {
+        tcsetpgrp(STDIN_FILENO, j->pgid);
+    }
+}
+
+static void continue_job(struct job *j)
+{
+    for (int i = 0; i < j->count; i++)
+    {
+        j->procs[i].stopped = false;
+    }
+    if (j->pgid != 0 && signal_job(j, SIGCONT) == -1)
+    {
+        perror("kill() error");
+    }
+}
+
+int job_foreground(struct job *j, bool cont)
+{
+    j->seq = ++job_seq;
+    j->foreground = true;
+    job_give_terminal(j);
+    if (cont)
+    {
+        if (terminal && j->has_tmodes)
+        {
+            tcsetattr(STDIN_FILENO, TCSADRAIN, &j->tmodes);
+        }
+        continue_job(j);
+    }
+
+    wait_job(j, false);
+
+    // take the terminal back with the modes we had
+    if (terminal && j->pgid != 0)
+    {
+        tcsetpgrp(STDIN_FILENO, shell_pgid);
+        j->has_tmodes = tcgetattr(STDIN_FILENO, &j->tmodes) == 0;
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &shell_tmodes);
+    }
+
+    int status = job_status(j);
+    if (job_state(j) == JOB_STOPPED)
+    {
+        printf("\n");
+        print_job(j, JOB_STOPPED, false);
+        j->reported = JOB_STOPPED;
+        j->foreground = false;
+        return status;
+    }
+    if (!j->accounted)
+    {
+        // every stage failed to start, nothing was waited for
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        account_job(j, &now);
+    }
+    usage_report(&j->usage, j->command, j->id, false, status);
+    remove_job(j);
+    return status;
+}
+
+void job_background(struct job *j, bool cont)
+{
+    j->seq = ++job_seq;
+    j->reported = JOB_RUNNING;
+    if (cont)
+    {
+        continue_job(j);
+    }
+    else if (interactive_shell)
+    {
+        printf("[%d] %d\n", j->id, (int)job_leader(j));
+    }
+}
+
+// %n, %+, %% or a lone % for the current job, %- for the previous one,
+// %prefix for the job whose command starts with it
+static struct job *find_job(const char *builtin, const char *spec)
+{
+    struct job *current, *previous;
+    current_jobs(&current, &previous);
+
+    struct job *j = NULL;
+    if (spec == NULL || strcmp(spec, "%") == 0 || strcmp(spec, "%%") == 0 || strcmp(spec, "%+") == 0)
+    {
+        j = current;
+    }
+    else if (strcmp(spec, "%-") == 0)
+    {
+        j = previous;
+    }
+    else if (spec[0] == '%' && spec[1] >= '0' && spec[1] <= '9')
+    {
+        int id = atoi(spec + 1);
+        for (j = jobs; j != NULL && j->id != id; j = j->next)
+            ;
+    }
+    else if (spec[0] == '%')
+    {
+        for (j = jobs; j != NULL && strncmp(j->command, spec + 1, strlen(spec + 1)) != 0; j = j->next)
+            ;
+    }
+
+    if (j == NULL)
+    {
+        fprintf(stderr, "%s: %s: no such job\n", builtin, spec ? spec : "current");
+    }
+    return j;
+}
+
+int jobs_builtin(char **args)
+{
+    bool long_format = args[1] != NULL && strcmp(args[1], "-l") == 0;
+    jobs_reap();
+
+    struct job *next;
+    for (struct job *j = jobs; j != NULL; j = next)
+    {
+        next = j->next;
+        enum job_state state = job_state(j);
+        print_job(j, state, long_format);
+        j->reported = state;
+        if (state == JOB_DONE && interactive_shell)
+        {
+            remove_job(j);
+        }
+    }
+    return 0;
+}
+
+int fg_builtin(char **args)
+{
+    jobs_reap();
+    struct job *j = find_job("fg", args[1]);
+    if (j == NULL)
+    {
+        return 1;
+    }
+    printf("%s\n", j->command);
+    fflush(stdout);
+    return job_foreground(j, true);
+}
+
+int bg_builtin(char **args)
+{
+    jobs_reap();
+    struct job *j = find_job("bg", args[1]);
+    if (j == NULL)
+    {
+        return 1;
+    }
+    if (job_state(j) == JOB_DONE)
+    {
+        fprintf(stderr, "bg: job %d has terminated\n", j->id);
+        return 1;
+    }
+    size_t len = strlen(j->command);
+    printf("[%d]+ %s%s\n", j->id, j->command, len > 0 && j->command[len - 1] == '&' ? "" : " &");
+    job_background(j, true);
+    return 0;
+}
+
+int wait_builtin(char **args)
+{
+    // what came before the wait shows before what the jobs print meanwhile
+    fflush(stdout);
+    jobs_reap();
+    if (args[1] == NULL)
+    {
+        // every job that is running, stopped ones would never finish
+        struct job *next;
+        for (struct job *j = jobs; j != NULL; j = next)
+        {
+            next = j->next;
+            if (!wait_job(j, true))
+            {
+                return 128 + SIGINT;
+            }
+            if (job_state(j) == JOB_DONE && !interactive_shell)
+            {
+                remove_job(j);
+            }
+        }
+        return 0;
+    }
+
+    int status = 0;
+    for (int i = 1; args[i] != NULL; i++)
+    {
+        struct job *j = NULL;
+        struct process *p = NULL;
+        if (args[i][0] == '%')
+        {
+            j = find_job("wait", args[i]);
+        }
+        else
+        {
+            pid_t pid = atoi(args[i]);
+            for (struct job *k = jobs; k != NULL && j == NULL; k = k->next)
+            {
+                for (int n = 0; n < k->count; n++)
+                {
+                    if (k->procs[n].pid == pid)
+                    {
+                        j = k;
+                        p = &k->procs[n];
+                        break;
+                    }
+                }
+            }
+            if (j == NULL)
+            {
+                fprintf(stderr, "wait: pid %s is not a child of this shell\n", args[i]);
+            }
+        }
+        if (j == NULL)
+        {
+            status = 127;
+            continue;
+        }
+
+        if (!wait_job(j, true))
+        {
+            return 128 + SIGINT;
+        }
+        status = p != NULL ? exit_code(p->status) : job_status(j);
+
+        // its status has been collected, nobody needs to hear about it again
+        if (job_state(j) == JOB_DONE)
+        {
+            remove_job(j);
+        }
+    }
+    return status;
+}
+
+static int signal_number(const char *name)
+{
+    if (name[0] >= '0' && name[0] <= '9')
+    {
+        return atoi(name);
+    }
+    if (strncmp(name, "SIG", 3) == 0)
+    {
+        name += 3;
+    }
+    for (size_t i = 0; i < sizeof(signal_names) / sizeof(signal_names[0]); i++)
+    {
+        if (strcmp(name, signal_names[i].name) == 0)
+        {
+            return signal_names[i].number;
+        }
+    }
+    return -1;
+}
+
+int kill_builtin(char **args)
+{
+    int sig = SIGTERM;
+    int i = 1;
+    if (args[i] != NULL && strcmp(args[i], "-l") == 0)
+    {
+        for (size_t k = 0; k < sizeof(signal_names) / sizeof(signal_names[0]); k++)
+        {
+            printf("%2d) SIG%s\n", signal_names[k].number, signal_names[k].name);
+        }
+        return 0;
+    }
+    if (args[i] != NULL && strcmp(args[i], "-s") == 0 && args[i + 1] != NULL)
+    {
+        sig = signal_number(args[i + 1]);
+        i += 2;
+    }
+    else if (args[i] != NULL && args[i][0] == '-' && strcmp(args[i], "--") != 0)
+    {
+        sig = signal_number(args[i] + 1);
+        i++;
+    }
+    else if (args[i] != NULL && strcmp(args[i], "--") == 0)
+    {
+        i++;
+    }
+    if (sig < 0)
+    {
+        fprintf(stderr, "kill: %s: invalid signal specification\n", args[i - 1]);
+        return 1;
+    }
+    if (args[i] == NULL)
+    {
+        fprintf(stderr, "usage: kill [-s sigspec | -sigspec] %%job | pid ...\n");
+        return 2;
+    }
+
+    jobs_reap();
+    int status = 0;
+    for (; args[i] != NULL; i++)
+    {
+        if (args[i][0] == '%')
+        {
+            struct job *j = find_job("kill", args[i]);
+            if (j == NULL || j->pgid == 0)
+            {
+                status = 1;
+                continue;
+            }
+            if (signal_job(j, sig) == -1)
+            {
+                fprintf(stderr, "kill: %s: %s\n", args[i], strerror(errno));
+                status = 1;
+            }
+            // a stopped job only acts on the signal once it runs
+            else if (job_state(j) == JOB_STOPPED && (sig == SIGTERM || sig == SIGHUP))
+            {
+                continue_job(j);
+            }
+            continue;
+        }
+
+        char *end;
+        long pid = strtol(args[i], &end, 10);
+        if (*end != '\0' || end == args[i])
+        {
+            fprintf(stderr, "kill: %s: arguments must be process or job IDs\n", args[i]);
+            status = 1;
+        }
+        else if (kill((pid_t)pid, sig) == -1)
+        {
+            fprintf(stderr, "kill: (%ld) - %s\n", pid, strerror(errno));
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,66 @@
+// Job control
+// Every pipeline the shell starts is a job with its own process group. The
+// SIGCHLD handler only writes a byte to a pipe; the shell reaps children and
+// updates the table when it gets back to its main loop, so no wait can take a
+// child away from the code that waits for it.
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+struct job;
+
+// takes a process group and the terminal when interactive, installs the
+// SIGCHLD handler
+void jobs_init(bool interactive);
+
+// start over in a forked copy of the shell: no jobs, no terminal, and
+// commands stay in the process group of the copy
+void jobs_subshell(void);
+
+// read end of the SIGCHLD pipe, readable when some child changed state
+int jobs_fd(void);
+
+// a new job of count processes for command, entered in the table
+struct job *job_create(const char *command, int count);
+
+// record the process of a stage, -1 when it could not be started
+// the first process started leads the job's process group
+void job_add_process(struct job *j, int stage, pid_t pid);
+
+// record a stage that was not started and ended with exit status status
+void job_add_failed(struct job *j, int stage, int status);
+
+// process group a new process of the job joins: 0 to lead a new one, or
+// -1 to stay in the shell's when there is no job control
+pid_t job_pgid(const struct job *j);
+
+// hand the terminal to the job so it gets the keyboard signals, for a
+// shell that has work of its own to do before it waits
+void job_give_terminal(struct job *j);
+
+// run the job in the foreground, continuing it first if cont, until it
+// finishes or stops; returns its exit status, 128+signal when stopped
+int job_foreground(struct job *j, bool cont);
+
+// leave the job running in the background, continuing it first if cont
+void job_background(struct job *j, bool cont);
+
+// collect every pending status change without blocking
+void jobs_reap(void);
+
+// report jobs that finished or stopped since the last call, and drop the
+// finished ones
+void jobs_notify(void);
+
+// builtins: jobs [-l], fg [%job], bg [%job], wait [%job|pid...],
+// kill [-s sig|-sig] %job|pid... and kill -l
+int jobs_builtin(char **args);
+int fg_builtin(char **args);
+int bg_builtin(char **args);
+int wait_builtin(char **args);
+int kill_builtin(char **args);
+
+#endif
@@ -0,0 +1,210 @@
+// Process launcher
+// posix_spawn shares the shell's memory with the child until it execs, so
+// its cost does not grow with the size of the shell. Pipes and redirections
+// become spawn file actions and the signal setup becomes spawn attributes.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <spawn.h>
+#include "launch.h"
+#include "redirect.h"
+#include "vars.h"
+
+enum launch_mode launch_mode = LAUNCH_SPAWN;
+
+// signals the shell ignores or catches for itself
+static const int shell_signals[] = {SIGINT, SIGCHLD, SIGPIPE, SIGTSTP, SIGTTIN, SIGTTOU};
+
+void launch_exec(const struct launch *l)
+{
+    if (l->pgid != -1)
+    {
+        setpgid(0, l->pgid);
+    }
+    for (size_t i = 0; i < sizeof(shell_signals) / sizeof(shell_signals[0]); i++)
+    {
+        signal(shell_signals[i], SIG_DFL);
+    }
+    sigprocmask(SIG_SETMASK, l->mask, NULL);
+
+    // connect the pipes, the originals are O_CLOEXEC and vanish on exec
+    if (l->in != -1)
+    {
+        dup2(l->in, STDIN_FILENO);
+    }
+    if (l->out != -1)
+    {
+        dup2(l->out, STDOUT_FILENO);
+    }
+    if (l->err != -1)
+    {
+        dup2(l->err, STDERR_FILENO);
+    }
+
+    // handle redirections
+    for (const struct redirect *r = l->redirects; r != NULL; r = r->next)
+    {
+        if (redirect_apply(l->redirects, r) == -1)
+        {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // execute command
+    execve(l->path, l->args, l->envp != NULL ? l->envp : vars_environ());
+}
+
+// fork+exec, the child sets itself up the same way the spawn attributes would
+static pid_t launch_fork(const struct launch *l)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+    {
+        return pid;
+    }
+    launch_exec(l);
+
+    // exit child process
+    perror("execve() error");
+    exit(EXIT_FAILURE);
+}
+
+// whether fd is open in the child when it reaches redirection r, after the
+// pipes and the redirections before r were applied
+static bool child_has_fd(const struct launch *l, const struct redirect *r, int fd)
+{
+    int state = -1; // unknown, 0 closed, 1 open
+    if ((fd == STDIN_FILENO && l->in != -1) || (fd == STDOUT_FILENO && l->out != -1) || (fd == STDERR_FILENO && l->err != -1))
+    {
+        state = 1;
+    }
+    for (const struct redirect *p = l->redirects; p != r; p = p->next)
+    {
+        if (p->fd == fd)
+        {
+            state = p->type != REDIRECT_DUP || p->from != -1;
+        }
+    }
+    return state != -1 ? state : !redirect_is_private(fd) && fcntl(fd, F_GETFD) != -1;
+}
+
+// posix_spawn with the redirections expressed as file actions. Files are
+// opened here and copied into place, so a target that cannot be opened is
+// reported by its name, as the child of launch_fork would, rather than
+// failing the spawn as if the command were missing.
+// returns 0, an error number like posix_spawn itself, or -1 after printing
+// the error of a redirection
+static int launch_spawn(const struct launch *l, pid_t *pid)
+{
+    int files[redirect_count(l->redirects) + 1];
+    int file_count = 0;
+    int err = 0;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    if (l->in != -1)
+    {
+        posix_spawn_file_actions_adddup2(&actions, l->in, STDIN_FILENO);
+    }
+    if (l->out != -1)
+    {
+        posix_spawn_file_actions_adddup2(&actions, l->out, STDOUT_FILENO);
+    }
+    if (l->err != -1)
+    {
+        posix_spawn_file_actions_adddup2(&actions, l->err, STDERR_FILENO);
+    }
+    for (const struct redirect *r = l->redirects; r != NULL; r = r->next)
+    {
+        if (r->type == REDIRECT_INPUT || r->type == REDIRECT_OUTPUT || r->type == REDIRECT_APPEND)
+        {
+            int fd = redirect_open(r);
+            if (fd == -1)
+            {
+                fprintf(stderr, "%s: %s\n", r->target, strerror(errno));
+                err = -1;
+                break;
+            }
+            files[file_count++] = fd;
+            posix_spawn_file_actions_adddup2(&actions, fd, r->fd);
+        }
+        else if (r->from == -1)
+        {
+            posix_spawn_file_actions_addclose(&actions, r->fd);
+        }
+        else if (r->type == REDIRECT_DUP && !child_has_fd(l, r, r->from))
+        {
+            fprintf(stderr, "%d: %s\n", r->from, strerror(EBADF));
+            err = -1;
+            break;
+        }
+        else
+        {
+            posix_spawn_file_actions_adddup2(&actions, r->from, r->fd);
+        }
+    }
+
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    for (size_t i = 0; i < sizeof(shell_signals) / sizeof(shell_signals[0]); i++)
+    {
+        sigaddset(&defaults, shell_signals[i]);
+    }
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setsigmask(&attr, l->mask);
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    if (l->pgid != -1)
+    {
+        posix_spawnattr_setpgroup(&attr, l->pgid);
+        flags |= POSIX_SPAWN_SETPGROUP;
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    if (err == 0)
+    {
+        err = posix_spawn(pid, l->path, &actions, &attr, l->args, l->envp != NULL ? l->envp : vars_environ());
+    }
+
+    // the child has its own copies
+    for (int i = 0; i < file_count; i++)
+    {
+        close(files[i]);
+    }
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return err;
+}
+
+pid_t launch_command(const struct launch *l)
+{
+    if (launch_mode == LAUNCH_SPAWN)
+    {
+        pid_t pid;
+        int err = launch_spawn(l, &pid);
+        if (err == 0)
+        {
+            return pid;
+        }
+        if (err == -1)
+        {
+            return LAUNCH_REDIRECT_FAILED;
+        }
+
+        // anything but a missing spawn implementation is a real failure
+        if (err != ENOSYS)
+        {
+            errno = err;
+            return -1;
+        }
+        launch_mode = LAUNCH_FORK;
+    }
+    return launch_fork(l);
+}
@@ -0,0 +1,51 @@
+// Process launcher
+// Starts external commands with posix_spawn, which glibc implements with
+// clone(CLONE_VM|CLONE_VFORK), so no page tables are copied. fork+exec is
+// kept as the fallback.
+
+#ifndef LAUNCH_H
+#define LAUNCH_H
+
+#include <signal.h>
+#include <sys/types.h>
+#include "parser.h"
+
+enum launch_mode
+{
+    LAUNCH_SPAWN, // posix_spawn, fork only when it is unsupported
+    LAUNCH_FORK   // always fork+exec
+};
+
+// everything the child needs before it runs the command
+struct launch
+{
+    const char *path; // resolved location of args[0]
+    char **args;
+    int in;  // descriptor to use as stdin, or -1
+    int out; // descriptor to use as stdout, or -1
+    int err; // descriptor to use as stderr, or -1
+    const struct redirect *redirects; // applied after the pipes, in order
+    pid_t pgid;           // process group to join, 0 to lead a new one,
+                          // -1 to stay in the shell's
+    const sigset_t *mask; // signal mask of the child
+    char **envp;          // environment, NULL for the exported variables
+};
+
+// selected from $SHELL_LAUNCH ("fork" or "spawn") at startup
+extern enum launch_mode launch_mode;
+
+// returned by launch_command when a redirection failed, after printing its
+// error; the command's status is 1, as when a forked child finds out
+#define LAUNCH_REDIRECT_FAILED -2
+
+// start the command described by l
+// returns the child's pid, LAUNCH_REDIRECT_FAILED, or -1 with errno set
+// when it could not be started
+pid_t launch_command(const struct launch *l);
+
+// become the command described by l, for a process that has nothing left
+// to do after it; exits when a redirection fails
+// returns only when exec failed, with errno set
+void launch_exec(const struct launch *l);
+
+#endif
@@ -0,0 +1,378 @@
+// Command line lexer
+// Words are unquoted straight into one arena buffer as they are scanned. A
+// word never gets longer than its source text, so one buffer of twice the
+// line length holds every word and its terminator. A variable reference
+// leaves no text behind, only its position and the interned variable. A
+// word with a wildcard or variable that is not quoted is scanned a second
+// time for its pattern, where the characters that were quoted are escaped.
+
+#include <stdio.h>
+#include <string.h>
+#include "lexer.h"
+
+#define IO_NUMBER_MAX 9999 // larger numbers before < or > stay words
+
+static const char *token_names[] = {
+    [TOKEN_WORD] = "word",
+    [TOKEN_PIPE] = "|",
+    [TOKEN_AND_IF] = "&&",
+    [TOKEN_OR_IF] = "||",
+    [TOKEN_SEMI] = ";",
+    [TOKEN_AMP] = "&",
+    [TOKEN_LESS] = "<",
+    [TOKEN_GREAT] = ">",
+    [TOKEN_DGREAT] = ">>",
+    [TOKEN_LESS_AND] = "<&",
+    [TOKEN_GREAT_AND] = ">&",
+    [TOKEN_DLESS] = "<<",
+    [TOKEN_DLESS_DASH] = "<<-",
+    [TOKEN_TLESS] = "<<<",
+    [TOKEN_AND_GREAT] = "&>",
+    [TOKEN_AND_DGREAT] = "&>>",
+    [TOKEN_LPAREN] = "(",
+    [TOKEN_RPAREN] = ")",
+    [TOKEN_NEWLINE] = "newline",
+};
+
+static struct var *(*intern_name)(const char *name, size_t len);
+
+void lex_variables(struct var *(*intern)(const char *name, size_t len))
+{
+    intern_name = intern;
+}
+
+const char *token_name(enum token_type type)
+{
+    return token_names[type];
+}
+
+// characters that end an unquoted word
+static bool is_delimiter(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '|' || c == '&' || c == ';' || c == '<' || c == '>' || c == '(' || c == ')';
+}
+
+static bool is_name_start(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool is_name_char(char c)
+{
+    return is_name_start(c) || (c >= '0' && c <= '9');
+}
+
+// length of the $NAME, ${NAME}, $? or $n reference at p, 0 when the $ is
+// just a $; *name and *name_len are set to the name inside it
+static size_t reference(const char *p, const char *end, const char **name, size_t *name_len)
+{
+    const char *s = p + 1;
+    bool braces = s < end && *s == '{';
+    s += braces;
+    *name = s;
+    if (s < end && is_name_start(*s))
+    {
+        while (s < end && is_name_char(*s))
+        {
+            s++;
+        }
+    }
+    else if (s < end && ((*s >= '0' && *s <= '9') || *s == '?' || *s == '$'))
+    {
+        s++;
+    }
+    *name_len = s - *name;
+    if (*name_len == 0 || (braces && (s == end || *s++ != '}')))
+    {
+        return 0;
+    }
+    return s - p;
+}
+
+// the reference at p as an expansion of word t, whose text ends at out;
+// when scanning the word again for its pattern the expansion made the
+// first time is at **tail and only learns where it goes in the pattern
+// returns the bytes it took, 0 when it is not one
+static size_t expansion(struct arena *arena, struct token *t, struct expansion ***tail, const char *p, const char *end, const char *out, bool quoted, bool pattern)
+{
+    const char *name;
+    size_t name_len;
+    size_t len = intern_name != NULL ? reference(p, end, &name, &name_len) : 0;
+    if (len == 0)
+    {
+        return 0;
+    }
+    if (pattern)
+    {
+        struct expansion *e = **tail;
+        e->pattern_offset = out - t->pattern;
+        *tail = &e->next;
+        return len;
+    }
+    struct expansion *e = arena_alloc(arena, sizeof(struct expansion));
+    e->offset = out - t->text;
+    e->pattern_offset = 0;
+    e->var = intern_name(name, name_len);
+    e->quoted = quoted;
+    e->next = NULL;
+    **tail = e;
+    *tail = &e->next;
+    return len;
+}
+
+// a character of a word; in its pattern a quoted one that would be taken
+// as a wildcard keeps a backslash in front
+static char *put(char *out, char c, bool quoted, bool pattern)
+{
+    if (pattern && quoted && strchr("*?[]!^-\\", c) != NULL && c != '\0')
+    {
+        *out++ = '\\';
+    }
+    *out++ = c;
+    return out;
+}
+
+// copy the word at p to *out, resolving quotes and backslashes, or to its
+// pattern; *glob is set when a *, ? or [ or a variable is not quoted
+// returns where the word ends, NULL with *error set
+static const char *scan_word(struct arena *arena, struct token *t, const char *p, const char *end, char **out, bool pattern, bool *glob, const char **error)
+{
+    char *o = *out;
+    struct expansion **tail = &t->expansions;
+    size_t taken;
+    while (p < end && !is_delimiter(*p))
+    {
+        if (*p == '$' && (taken = expansion(arena, t, &tail, p, end, o, false, pattern)) > 0)
+        {
+            // its value may hold wildcards
+            *glob = true;
+            p += taken;
+        }
+        else if (*p == '\\')
+        {
+            t->quoted = true;
+            if (++p < end)
+            {
+                o = put(o, *p++, true, pattern);
+            }
+        }
+        else if (*p == '\'')
+        {
+            t->quoted = true;
+            const char *close = memchr(p + 1, '\'', end - p - 1);
+            if (close == NULL)
+            {
+                *error = "unterminated single quote";
+                return NULL;
+            }
+            for (p++; pattern && p < close; p++)
+            {
+                o = put(o, *p, true, true);
+            }
+            memcpy(o, p, close - p);
+            o += close - p;
+            p = close + 1;
+        }
+        else if (*p == '"')
+        {
+            t->quoted = true;
+            p++;
+            while (p < end && *p != '"')
+            {
+                if (*p == '$' && (taken = expansion(arena, t, &tail, p, end, o, true, pattern)) > 0)
+                {
+                    p += taken;
+                    continue;
+                }
+                // inside double quotes a backslash only escapes these
+                if (*p == '\\' && p + 1 < end && strchr("\\\"$`", p[1]) != NULL)
+                {
+                    p++;
+                }
+                o = put(o, *p++, true, pattern);
+            }
+            if (p == end)
+            {
+                *error = "unterminated double quote";
+                return NULL;
+            }
+            p++;
+        }
+        else
+        {
+            *glob = *glob || *p == '*' || *p == '?' || *p == '[';
+            *o++ = *p++;
+        }
+    }
+    *out = o;
+    return p;
+}
+
+void lex_heredoc(struct arena *arena, const char *body, size_t len, struct token *t)
+{
+    memset(t, 0, sizeof(*t));
+    t->type = TOKEN_WORD;
+    t->quoted = true;
+    t->io_number = -1;
+    t->text = arena_alloc(arena, len + 1);
+    char *o = t->text;
+    struct expansion **tail = &t->expansions;
+    const char *p = body;
+    const char *end = body + len;
+    size_t taken;
+    while (p < end)
+    {
+        if (*p == '$' && (taken = expansion(arena, t, &tail, p, end, o, true, false)) > 0)
+        {
+            p += taken;
+        }
+        else if (*p == '\\' && p + 1 < end && p[1] == '\n')
+        {
+            p += 2;
+        }
+        else
+        {
+            if (*p == '\\' && p + 1 < end && strchr("\\$`", p[1]) != NULL)
+            {
+                p++;
+            }
+            *o++ = *p++;
+        }
+    }
+    *o = '\0';
+    t->len = o - t->text;
+}
+
+int lex_line(struct arena *arena, const char *line, size_t len, struct token **tokens, const char **error)
+{
+    size_t capacity = 16;
+    int count = 0;
+    struct token *list = arena_alloc(arena, capacity * sizeof(struct token));
+    char *out = arena_alloc(arena, 2 * len + 1);
+
+    const char *p = line;
+    const char *end = line + len;
+    while (true)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+        {
+            p++;
+        }
+        if (p < end && *p == '#')
+        {
+            // a comment runs to the end of its line
+            const char *newline = memchr(p, '\n', end - p);
+            p = newline != NULL ? newline : end;
+        }
+        if (p == end)
+        {
+            break;
+        }
+
+        if ((size_t)count == capacity)
+        {
+            list = arena_grow(arena, list, capacity * sizeof(struct token), 2 * capacity * sizeof(struct token));
+            capacity *= 2;
+        }
+        struct token *t = &list[count++];
+        t->text = NULL;
+        t->len = 0;
+        t->quoted = false;
+        t->start = p - line;
+        t->expansions = NULL;
+        t->pattern = NULL;
+
+        // digits right before < or > name the descriptor to redirect
+        t->io_number = -1;
+        const char *digits = p;
+        int n = 0;
+        while (digits < end && *digits >= '0' && *digits <= '9' && n <= IO_NUMBER_MAX)
+        {
+            n = n * 10 + (*digits++ - '0');
+        }
+        if (digits > p && n <= IO_NUMBER_MAX && digits < end && (*digits == '<' || *digits == '>'))
+        {
+            t->io_number = n;
+            p = digits;
+        }
+
+        char next = p + 1 < end ? p[1] : '\0';
+        char third = p + 2 < end ? p[2] : '\0';
+        size_t op_len = 1;
+        switch (*p)
+        {
+        case '|':
+            t->type = next == '|' ? TOKEN_OR_IF : TOKEN_PIPE;
+            op_len = next == '|' ? 2 : 1;
+            break;
+        case '&':
+            if (next == '>')
+            {
+                t->type = third == '>' ? TOKEN_AND_DGREAT : TOKEN_AND_GREAT;
+                op_len = third == '>' ? 3 : 2;
+                break;
+            }
+            t->type = next == '&' ? TOKEN_AND_IF : TOKEN_AMP;
+            op_len = next == '&' ? 2 : 1;
+            break;
+        case '>':
+            t->type = next == '>' ? TOKEN_DGREAT : next == '&' ? TOKEN_GREAT_AND : TOKEN_GREAT;
+            op_len = next == '>' || next == '&' || next == '|' ? 2 : 1;
+            break;
+        case '<':
+            if (next == '<')
+            {
+                t->type = third == '<' ? TOKEN_TLESS : third == '-' ? TOKEN_DLESS_DASH : TOKEN_DLESS;
+                op_len = third == '<' || third == '-' ? 3 : 2;
+                break;
+            }
+            t->type = next == '&' ? TOKEN_LESS_AND : TOKEN_LESS;
+            op_len = next == '&' ? 2 : 1;
+            break;
+        case ';':
+            t->type = TOKEN_SEMI;
+            break;
+        case '(':
+            t->type = TOKEN_LPAREN;
+            break;
+        case ')':
+            t->type = TOKEN_RPAREN;
+            break;
+        case '\n':
+            t->type = TOKEN_NEWLINE;
+            break;
+        default:
+            op_len = 0;
+        }
+        if (op_len > 0)
+        {
+            p += op_len;
+            t->end = p - line;
+            continue;
+        }
+
+        // a word, quotes and backslashes are resolved while copying
+        t->type = TOKEN_WORD;
+        t->text = out;
+        const char *word = p;
+        bool glob = false;
+        p = scan_word(arena, t, word, end, &out, false, &glob, error);
+        if (p == NULL)
+        {
+            return -1;
+        }
+        t->len = out - t->text;
+        *out++ = '\0';
+        t->end = p - line;
+        if (glob)
+        {
+            // scanned again for the pattern, escapes can double its length
+            char *pattern = t->pattern = arena_alloc(arena, 2 * (p - word) + 1);
+            scan_word(arena, t, word, end, &pattern, true, &glob, error);
+            *pattern = '\0';
+        }
+    }
+
+    *tokens = list;
+    return count;
+}
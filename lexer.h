@@ -0,0 +1,79 @@
+// Command line lexer
+// Turns a line into typed tokens in a single pass, with quotes and
+// backslashes already resolved, so nothing after it rescans the text.
+
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "arena.h"
+
+struct var;
+
+// a $NAME, ${NAME} or $? in a word; the name is resolved here, the value
+// is filled in when the command runs
+struct expansion
+{
+    size_t offset;         // where the value goes in the word's text
+    size_t pattern_offset; // and in its pattern
+    struct var *var;
+    bool quoted; // inside double quotes, so it is not split into fields
+    struct expansion *next;
+};
+
+enum token_type
+{
+    TOKEN_WORD,
+    TOKEN_PIPE,      // |
+    TOKEN_AND_IF,    // &&
+    TOKEN_OR_IF,     // ||
+    TOKEN_SEMI,      // ;
+    TOKEN_AMP,       // &
+    TOKEN_LESS,       // <
+    TOKEN_GREAT,      // > or >|
+    TOKEN_DGREAT,     // >>
+    TOKEN_LESS_AND,   // <&
+    TOKEN_GREAT_AND,  // >&
+    TOKEN_DLESS,      // <<
+    TOKEN_DLESS_DASH, // <<-
+    TOKEN_TLESS,      // <<<
+    TOKEN_AND_GREAT,  // &>
+    TOKEN_AND_DGREAT, // &>>
+    TOKEN_LPAREN,     // (
+    TOKEN_RPAREN,     // )
+    TOKEN_NEWLINE,    // end of a line inside a longer command
+};
+
+struct token
+{
+    enum token_type type;
+    char *text;  // unquoted text of a word, NULL for operators
+    size_t len;  // length of text
+    bool quoted; // the word contained quotes or backslashes
+    int io_number; // n written right before a < or > operator, -1 if none
+    size_t start;  // where the token is in the line
+    size_t end;    // and the offset just past it
+    struct expansion *expansions; // in order, NULL when the word has none
+    char *pattern; // the word for pathname expansion, with the quoted
+                   // characters escaped, NULL when it has no wildcard
+                   // or variable outside quotes
+};
+
+// split line into tokens allocated in the arena
+// returns the number of tokens, or -1 with *error describing the problem
+int lex_line(struct arena *arena, const char *line, size_t len, struct token **tokens, const char **error);
+
+// the body of a heredoc whose delimiter was not quoted, as word t: its
+// variables are expanded, a backslash only escapes $, ` and \ and joins
+// lines, and quotes are ordinary characters
+void lex_heredoc(struct arena *arena, const char *body, size_t len, struct token *t);
+
+// have $NAME recognised in words, the names interned by intern; without
+// it a $ is an ordinary character
+void lex_variables(struct var *(*intern)(const char *name, size_t len));
+
+// how an operator is written, for error messages
+const char *token_name(enum token_type type);
+
+#endif
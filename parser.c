@@ -0,0 +1,482 @@
+// Command parser
+// Recursive descent over the tokens, one function per level:
+//   list     := and_or ((";" | "&" | newline) and_or)*
+//   and_or   := pipeline (("&&" | "||") pipeline)*
+//   pipeline := stage ("|" stage)*
+//   stage    := (word | redirection)+ | ("{" list "}" | "(" list ")") redirection*
+// "{" and "}" are only reserved where a command starts. A list put in the
+// background that is not a single pipeline becomes the only stage of one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parser.h"
+#include "lexer.h"
+
+struct parser
+{
+    struct arena *arena;
+    const char *line;
+    struct token *tokens;
+    int count;
+    int pos;
+    struct redirect **heredoc_tail;
+    bool incomplete; // the tokens ran out where more were needed
+    bool failed;     // a syntax error was printed
+};
+
+static int syntax_error(const char *message, const char *near)
+{
+    if (near != NULL)
+    {
+        fprintf(stderr, "Syntax error: %s `%s'\n", message, near);
+    }
+    else
+    {
+        fprintf(stderr, "Syntax error: %s\n", message);
+    }
+    return -1;
+}
+
+static struct redirect *new_redirect(struct arena *arena, struct redirect ***tail, enum redirect_type type, int fd)
+{
+    struct redirect *r = arena_alloc(arena, sizeof(struct redirect));
+    r->type = type;
+    r->fd = fd;
+    r->target = NULL;
+    r->target_len = 0;
+    r->from = -1;
+    r->word = NULL;
+    r->strip_tabs = false;
+    r->next = NULL;
+    r->next_heredoc = NULL;
+    **tail = r;
+    *tail = &r->next;
+    return r;
+}
+
+// the token as a word to expand when the command runs, NULL when it names
+// no variables
+static struct word *written(struct arena *arena, const struct token *t)
+{
+    if (t->expansions == NULL)
+    {
+        return NULL;
+    }
+    struct word *w = arena_alloc(arena, sizeof(struct word));
+    *w = (struct word){t->text, t->expansions, NULL, t->quoted};
+    return w;
+}
+
+// the redirection written as op word, added to the stage's list
+// returns 0, or -1 after printing a syntax error
+static int add_redirect(struct parser *p, struct redirect ***tail, const struct token *op, const struct token *word)
+{
+    struct arena *arena = p->arena;
+    int fd = op->io_number;
+    bool to_number = word->len > 0 && strspn(word->text, "0123456789") == word->len;
+    struct redirect *r;
+    switch (op->type)
+    {
+    case TOKEN_LESS:
+        r = new_redirect(arena, tail, REDIRECT_INPUT, fd != -1 ? fd : 0);
+        break;
+    case TOKEN_GREAT:
+        r = new_redirect(arena, tail, REDIRECT_OUTPUT, fd != -1 ? fd : 1);
+        break;
+    case TOKEN_DGREAT:
+        r = new_redirect(arena, tail, REDIRECT_APPEND, fd != -1 ? fd : 1);
+        break;
+    case TOKEN_LESS_AND:
+    case TOKEN_GREAT_AND:
+        if (op->type == TOKEN_GREAT_AND && fd == -1 && !to_number && strcmp(word->text, "-") != 0)
+        {
+            // >&file is &>file
+            r = new_redirect(arena, tail, REDIRECT_OUTPUT, 1);
+            r->target = word->text;
+            r->word = written(arena, word);
+            new_redirect(arena, tail, REDIRECT_DUP, 2)->from = 1;
+            return 0;
+        }
+        if (!to_number && strcmp(word->text, "-") != 0)
+        {
+            return syntax_error("descriptor number or - expected after", token_name(op->type));
+        }
+        r = new_redirect(arena, tail, REDIRECT_DUP, fd != -1 ? fd : op->type == TOKEN_LESS_AND ? 0 : 1);
+        r->from = to_number ? atoi(word->text) : -1;
+        break;
+    case TOKEN_DLESS:
+    case TOKEN_DLESS_DASH:
+        r = new_redirect(arena, tail, REDIRECT_HEREDOC, fd != -1 ? fd : 0);
+        r->strip_tabs = op->type == TOKEN_DLESS_DASH;
+        *p->heredoc_tail = r;
+        p->heredoc_tail = &r->next_heredoc;
+        break;
+    case TOKEN_TLESS:
+    {
+        // the string is fed with a newline, like bash does
+        r = new_redirect(arena, tail, REDIRECT_STRING, fd != -1 ? fd : 0);
+        char *text = arena_alloc(arena, word->len + 2);
+        memcpy(text, word->text, word->len);
+        memcpy(text + word->len, "\n", 2);
+        r->target = text;
+        r->target_len = word->len + 1;
+        r->word = written(arena, word);
+        return 0;
+    }
+    case TOKEN_AND_GREAT:
+    case TOKEN_AND_DGREAT:
+        r = new_redirect(arena, tail, op->type == TOKEN_AND_GREAT ? REDIRECT_OUTPUT : REDIRECT_APPEND, 1);
+        r->target = word->text;
+        r->word = written(arena, word);
+        new_redirect(arena, tail, REDIRECT_DUP, 2)->from = 1;
+        return 0;
+    default:
+        return syntax_error("unexpected", token_name(op->type));
+    }
+    r->target = word->text;
+    r->target_len = word->len;
+    if (r->type != REDIRECT_HEREDOC)
+    {
+        r->word = written(arena, word);
+    }
+    return 0;
+}
+
+static const struct token *peek(const struct parser *p)
+{
+    return p->pos < p->count ? &p->tokens[p->pos] : NULL;
+}
+
+static bool at(const struct parser *p, enum token_type type)
+{
+    return p->pos < p->count && p->tokens[p->pos].type == type;
+}
+
+// an unquoted word, as reserved words are written
+static bool at_word(const struct parser *p, const char *word)
+{
+    const struct token *t = peek(p);
+    return t != NULL && t->type == TOKEN_WORD && !t->quoted && strcmp(t->text, word) == 0;
+}
+
+// the end of a list: ")" or "}" for the groups, nothing for a whole line
+static bool at_closer(const struct parser *p, char closer)
+{
+    return closer == ')' ? at(p, TOKEN_RPAREN) : closer == '}' ? at_word(p, "}") : false;
+}
+
+static void skip_newlines(struct parser *p)
+{
+    while (at(p, TOKEN_NEWLINE))
+    {
+        p->pos++;
+    }
+}
+
+// the current token cannot go here; at the end of the tokens the command
+// may simply go on in the next line
+static void unexpected(struct parser *p)
+{
+    const struct token *t = peek(p);
+    if (t == NULL)
+    {
+        p->incomplete = true;
+        return;
+    }
+    syntax_error("unexpected", t->type == TOKEN_WORD ? t->text : token_name(t->type));
+    p->failed = true;
+}
+
+static struct node *new_node(struct parser *p, enum node_type type, struct node *left, struct node *right)
+{
+    struct node *n = arena_alloc(p->arena, sizeof(struct node));
+    n->type = type;
+    n->pipeline = (struct pipeline){NULL, 0, false, NULL};
+    n->left = left;
+    n->right = right;
+    return n;
+}
+
+static struct node *parse_list(struct parser *p, char closer);
+
+// length of NAME when the word is written NAME=value, 0 otherwise; the
+// name cannot come from quotes or a variable
+static size_t assignment_name(const struct parser *p, const struct token *t)
+{
+    const char *s = p->line + t->start;
+    const char *end = p->line + t->end;
+    const char *c = s;
+    while (c < end && ((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || *c == '_' || (c > s && *c >= '0' && *c <= '9')))
+    {
+        c++;
+    }
+    return c > s && c < end && *c == '=' ? (size_t)(c - s) : 0;
+}
+
+// a simple command, or a group and the redirections after it
+// returns 0, or -1 after an error
+static int parse_stage(struct parser *p, struct stage *stage)
+{
+    stage->args = NULL;
+    stage->argc = 0;
+    stage->words = NULL;
+    stage->word_count = 0;
+    stage->assignments = NULL;
+    stage->compound = NULL;
+    stage->redirects = NULL;
+    struct redirect **tail = &stage->redirects;
+    struct assignment **assignment_tail = &stage->assignments;
+
+    if (at(p, TOKEN_LPAREN) || at_word(p, "{"))
+    {
+        char closer = at(p, TOKEN_LPAREN) ? ')' : '}';
+        p->pos++;
+        struct node *body = parse_list(p, closer);
+        if (body == NULL || !at_closer(p, closer))
+        {
+            if (!p->failed)
+            {
+                unexpected(p);
+            }
+            return -1;
+        }
+        p->pos++;
+        stage->compound = new_node(p, closer == ')' ? NODE_SUBSHELL : NODE_GROUP, body, NULL);
+    }
+    else if (at_word(p, "}"))
+    {
+        unexpected(p);
+        return -1;
+    }
+
+    size_t capacity = 0;
+    for (const struct token *t; (t = peek(p)) != NULL; p->pos++)
+    {
+        if (t->type == TOKEN_WORD && stage->compound == NULL)
+        {
+            size_t name_len = assignment_name(p, t);
+            if (stage->argc == 0 && name_len > 0)
+            {
+                struct assignment *a = arena_alloc(p->arena, sizeof(struct assignment));
+                a->name = arena_strndup(p->arena, t->text, name_len);
+                a->value = (struct word){t->text + name_len + 1, t->expansions, NULL, t->quoted};
+                for (struct expansion *e = t->expansions; e != NULL; e = e->next)
+                {
+                    e->offset -= name_len + 1;
+                }
+                a->next = NULL;
+                *assignment_tail = a;
+                assignment_tail = &a->next;
+                continue;
+            }
+
+            // keep room for the terminating NULL
+            if ((size_t)stage->argc + 1 >= capacity)
+            {
+                size_t grown = capacity == 0 ? 8 : 2 * capacity;
+                stage->args = arena_grow(p->arena, stage->args, capacity * sizeof(char *), grown * sizeof(char *));
+                if (stage->words != NULL)
+                {
+                    stage->words = arena_grow(p->arena, stage->words, capacity * sizeof(struct word), grown * sizeof(struct word));
+                }
+                capacity = grown;
+            }
+            if ((t->expansions != NULL || t->pattern != NULL) && stage->words == NULL)
+            {
+                // the words before it are kept as they are
+                stage->words = arena_alloc(p->arena, capacity * sizeof(struct word));
+                for (int i = 0; i < stage->argc; i++)
+                {
+                    stage->words[i] = (struct word){stage->args[i], NULL, NULL, true};
+                }
+            }
+            if (stage->words != NULL)
+            {
+                stage->words[stage->argc] = (struct word){t->text, t->expansions, t->pattern, t->quoted};
+                stage->word_count = stage->argc + 1;
+            }
+            stage->args[stage->argc++] = t->text;
+            continue;
+        }
+
+        switch (t->type)
+        {
+        case TOKEN_LESS:
+        case TOKEN_GREAT:
+        case TOKEN_DGREAT:
+        case TOKEN_LESS_AND:
+        case TOKEN_GREAT_AND:
+        case TOKEN_DLESS:
+        case TOKEN_DLESS_DASH:
+        case TOKEN_TLESS:
+        case TOKEN_AND_GREAT:
+        case TOKEN_AND_DGREAT:
+            if (p->pos + 1 == p->count || p->tokens[p->pos + 1].type != TOKEN_WORD)
+            {
+                syntax_error("missing word after", token_name(t->type));
+                p->failed = true;
+                return -1;
+            }
+            if (add_redirect(p, &tail, t, &p->tokens[++p->pos]) == -1)
+            {
+                p->failed = true;
+                return -1;
+            }
+            continue;
+        default:
+            break;
+        }
+        break;
+    }
+
+    if (stage->compound == NULL && stage->argc == 0 && stage->assignments == NULL)
+    {
+        if (stage->redirects != NULL)
+        {
+            syntax_error("empty command", NULL);
+            p->failed = true;
+        }
+        else
+        {
+            unexpected(p);
+        }
+        return -1;
+    }
+    if (stage->args != NULL)
+    {
+        stage->args[stage->argc] = NULL;
+    }
+    return 0;
+}
+
+static struct node *parse_pipeline(struct parser *p)
+{
+    struct node *n = new_node(p, NODE_PIPELINE, NULL, NULL);
+    struct pipeline *pipeline = &n->pipeline;
+    size_t start = p->tokens[p->pos].start;
+    int capacity = 0;
+    while (true)
+    {
+        if (pipeline->count == capacity)
+        {
+            int grown = capacity == 0 ? 2 : 2 * capacity;
+            pipeline->stages = arena_grow(p->arena, pipeline->stages, capacity * sizeof(struct stage), grown * sizeof(struct stage));
+            capacity = grown;
+        }
+        if (parse_stage(p, &pipeline->stages[pipeline->count++]) == -1)
+        {
+            return NULL;
+        }
+        if (!at(p, TOKEN_PIPE))
+        {
+            break;
+        }
+        p->pos++;
+        skip_newlines(p);
+        if (peek(p) == NULL)
+        {
+            p->incomplete = true;
+            return NULL;
+        }
+    }
+    pipeline->text = arena_strndup(p->arena, p->line + start, p->tokens[p->pos - 1].end - start);
+    return n;
+}
+
+static struct node *parse_and_or(struct parser *p)
+{
+    struct node *left = parse_pipeline(p);
+    while (left != NULL && (at(p, TOKEN_AND_IF) || at(p, TOKEN_OR_IF)))
+    {
+        enum node_type type = at(p, TOKEN_AND_IF) ? NODE_AND : NODE_OR;
+        p->pos++;
+        skip_newlines(p);
+        if (peek(p) == NULL)
+        {
+            p->incomplete = true;
+            return NULL;
+        }
+        struct node *right = parse_pipeline(p);
+        left = right != NULL ? new_node(p, type, left, right) : NULL;
+    }
+    return left;
+}
+
+// n followed by &: a pipeline goes to the background as it is, anything
+// else as the only stage of one, written as start to the current token
+static struct node *background(struct parser *p, struct node *n, size_t start)
+{
+    if (n->type != NODE_PIPELINE)
+    {
+        struct node *wrapper = new_node(p, NODE_PIPELINE, NULL, NULL);
+        wrapper->pipeline.stages = arena_alloc(p->arena, sizeof(struct stage));
+        wrapper->pipeline.stages[0] = (struct stage){.compound = n};
+        wrapper->pipeline.count = 1;
+        wrapper->pipeline.text = arena_strndup(p->arena, p->line + start, p->tokens[p->pos - 1].end - start);
+        n = wrapper;
+    }
+    n->pipeline.background = true;
+    return n;
+}
+
+// and-or lists up to closer, NULL when there are none or after an error
+static struct node *parse_list(struct parser *p, char closer)
+{
+    struct node *list = NULL;
+    while (true)
+    {
+        skip_newlines(p);
+        if (peek(p) == NULL || at_closer(p, closer))
+        {
+            return list;
+        }
+
+        size_t start = peek(p)->start;
+        struct node *item = parse_and_or(p);
+        if (item == NULL)
+        {
+            return NULL;
+        }
+        if (at(p, TOKEN_AMP))
+        {
+            item = background(p, item, start);
+            p->pos++;
+        }
+        else if (at(p, TOKEN_SEMI) || at(p, TOKEN_NEWLINE))
+        {
+            p->pos++;
+        }
+        else if (peek(p) != NULL && !at_closer(p, closer))
+        {
+            unexpected(p);
+            return NULL;
+        }
+        list = list == NULL ? item : new_node(p, NODE_SEQUENCE, list, item);
+    }
+}
+
+int parse_command(struct arena *arena, const char *line, size_t len, struct node **tree, struct redirect **heredocs)
+{
+    struct token *tokens;
+    const char *error;
+    int count = lex_line(arena, line, len, &tokens, &error);
+    if (count < 0)
+    {
+        return syntax_error(error, NULL);
+    }
+
+    *heredocs = NULL;
+    struct parser p = {arena, line, tokens, count, 0, heredocs, false, false};
+    *tree = parse_list(&p, '\0');
+    if (!p.failed && !p.incomplete && p.pos < count)
+    {
+        // only a ) without its ( stops a whole line early
+        unexpected(&p);
+    }
+    if (p.failed)
+    {
+        return -1;
+    }
+    return p.incomplete ? PARSE_INCOMPLETE : 0;
+}
@@ -0,0 +1,105 @@
+// Command parser
+// Builds the tree of a command line from the lexer's tokens: pipelines
+// joined by ;, &, && and ||, whose stages are simple commands or { } and
+// ( ) groups of such lists.
+
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <stdbool.h>
+#include "arena.h"
+#include "lexer.h"
+
+enum redirect_type
+{
+    REDIRECT_INPUT,   // n< file
+    REDIRECT_OUTPUT,  // n> file
+    REDIRECT_APPEND,  // n>> file
+    REDIRECT_DUP,     // n>&m or n<&m, n>&- closes n
+    REDIRECT_HEREDOC, // n<< word, the lines after the command up to word
+    REDIRECT_STRING,  // n<<< word
+};
+
+// a word as written, with the variables to fill in when the command runs
+struct word
+{
+    const char *text;
+    struct expansion *expansions;
+    const char *pattern; // to match file names against, or NULL
+    bool quoted; // written with quotes, so it stays a word even if empty
+};
+
+struct redirect
+{
+    enum redirect_type type;
+    int fd;             // descriptor being redirected
+    const char *target; // file name, here-string, or heredoc body once read
+    size_t target_len;  // length of a here-string or heredoc body
+    int from;              // descriptor copied to fd, for REDIRECT_DUP and
+                           // the memfd of a heredoc or here-string; -1 closes
+    const struct word *word; // a target that names variables, else NULL
+    bool strip_tabs;       // <<-, leading tabs of the heredoc are dropped
+    struct redirect *next; // in the order they were written
+    struct redirect *next_heredoc; // heredocs of the whole line, in order
+};
+
+struct node;
+
+// NAME=value written before a command
+struct assignment
+{
+    const char *name;
+    struct word value;
+    struct assignment *next;
+};
+
+// one stage of a pipeline
+struct stage
+{
+    char **args; // NULL for a compound stage
+    int argc;
+    struct word *words; // the args as written when one names a variable
+                        // or has a wildcard
+    int word_count;
+    struct assignment *assignments;
+    struct node *compound; // a { } or ( ) group, or a list run with &
+    struct redirect *redirects;
+};
+
+struct pipeline
+{
+    struct stage *stages;
+    int count;
+    bool background;
+    const char *text; // as written, the name of its job
+};
+
+enum node_type
+{
+    NODE_PIPELINE, // pipeline
+    NODE_AND,      // left && right
+    NODE_OR,       // left || right
+    NODE_SEQUENCE, // left ; right, or left & right
+    NODE_GROUP,    // { left; }, run by the shell itself
+    NODE_SUBSHELL, // ( left ), run by a copy of the shell
+};
+
+struct node
+{
+    enum node_type type;
+    struct pipeline pipeline;
+    struct node *left;
+    struct node *right;
+};
+
+// parse_command results besides 0 and -1
+#define PARSE_INCOMPLETE 1 // the line ends inside a group or after && || |
+
+// parse line into a tree allocated in the arena, NULL for an empty line;
+// *heredocs lists the heredoc redirections, whose target is the delimiter
+// until the body is read
+// returns 0, PARSE_INCOMPLETE when the command goes on in the next line,
+// or -1 after printing a syntax error
+int parse_command(struct arena *arena, const char *line, size_t len, struct node **tree, struct redirect **heredocs);
+
+#endif
@@ -0,0 +1,266 @@
+// Command location cache
+// An open addressing table from command name to the absolute path it was
+// found at. A hit skips the $PATH walk, so no execve is tried in the wrong
+// directories. Entries are dropped when $PATH changes, or when the mtime of
+// the entry's directory or of a directory before it in $PATH changes, since
+// that is when a file could have been removed or shadowed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "pathcache.h"
+#include "vars.h"
+
+#define DEFAULT_PATH "/bin:/usr/bin"
+#define INITIAL_CAPACITY 64
+
+struct path_dir
+{
+    char *path;
+    struct timespec mtime;
+};
+
+struct path_entry
+{
+    char *name; // NULL for an empty slot
+    char *path;
+    int dir; // index of the $PATH directory it was found in
+    unsigned hits;
+};
+
+static char *cached_path_var; // $PATH the directories were parsed from
+static struct path_dir *dirs;
+static int dir_count;
+
+static struct path_entry *table;
+static size_t capacity;
+static size_t used;
+
+// FNV-1a
+static uint32_t hash_name(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (; *name; name++)
+    {
+        h = (h ^ (unsigned char)*name) * 16777619u;
+    }
+    return h;
+}
+
+// slot holding name, or the empty slot where it belongs
+static struct path_entry *find_slot(struct path_entry *slots, size_t size, const char *name)
+{
+    size_t i = hash_name(name) & (size - 1);
+    while (slots[i].name != NULL && strcmp(slots[i].name, name) != 0)
+    {
+        i = (i + 1) & (size - 1);
+    }
+    return &slots[i];
+}
+
+static void insert(const char *name, const char *path, int dir, unsigned hits)
+{
+    if ((used + 1) * 2 > capacity)
+    {
+        size_t new_capacity = capacity ? capacity * 2 : INITIAL_CAPACITY;
+        struct path_entry *new_table = calloc(new_capacity, sizeof(struct path_entry));
+        if (new_table == NULL)
+        {
+            return;
+        }
+        for (size_t i = 0; i < capacity; i++)
+        {
+            if (table[i].name != NULL)
+            {
+                *find_slot(new_table, new_capacity, table[i].name) = table[i];
+            }
+        }
+        free(table);
+        table = new_table;
+        capacity = new_capacity;
+    }
+
+    struct path_entry *e = find_slot(table, capacity, name);
+    if (e->name == NULL)
+    {
+        e->name = strdup(name);
+        used++;
+    }
+    else
+    {
+        free(e->path);
+    }
+    e->path = strdup(path);
+    e->dir = dir;
+    e->hits = hits;
+}
+
+// stat the directory and report whether its mtime moved since last time
+static bool dir_changed(struct path_dir *d)
+{
+    struct stat st;
+    if (stat(d->path, &st) == -1)
+    {
+        st.st_mtim.tv_sec = 0;
+        st.st_mtim.tv_nsec = 0;
+    }
+    bool changed = st.st_mtim.tv_sec != d->mtime.tv_sec || st.st_mtim.tv_nsec != d->mtime.tv_nsec;
+    d->mtime = st.st_mtim;
+    return changed;
+}
+
+void path_forget_all(void)
+{
+    for (size_t i = 0; i < capacity; i++)
+    {
+        free(table[i].name);
+        free(table[i].path);
+        table[i].name = NULL;
+        table[i].path = NULL;
+    }
+    used = 0;
+
+    // start over from the directories as they are now
+    for (int i = 0; i < dir_count; i++)
+    {
+        dir_changed(&dirs[i]);
+    }
+}
+
+// split $PATH into directories, an empty component means the current one
+static void load_path(const char *path_var)
+{
+    for (int i = 0; i < dir_count; i++)
+    {
+        free(dirs[i].path);
+    }
+    free(dirs);
+    free(cached_path_var);
+
+    cached_path_var = strdup(path_var);
+    dir_count = 1;
+    for (const char *p = path_var; *p; p++)
+    {
+        dir_count += *p == ':';
+    }
+    dirs = calloc(dir_count, sizeof(struct path_dir));
+
+    const char *start = path_var;
+    for (int i = 0; i < dir_count; i++)
+    {
+        const char *end = strchr(start, ':');
+        size_t len = end ? (size_t)(end - start) : strlen(start);
+        dirs[i].path = len ? strndup(start, len) : strdup(".");
+        start = end ? end + 1 : start + len;
+    }
+
+    path_forget_all();
+}
+
+// walk $PATH for an executable regular file
+// returns the index of the directory it was found in, or -1
+static int search_path(const char *name, char *buf, size_t size)
+{
+    for (int i = 0; i < dir_count; i++)
+    {
+        struct stat st;
+        snprintf(buf, size, "%s/%s", dirs[i].path, name);
+        if (stat(buf, &st) == 0 && S_ISREG(st.st_mode) && access(buf, X_OK) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *path_lookup(const char *name)
+{
+    if (strchr(name, '/') != NULL)
+    {
+        return name;
+    }
+
+    const char *path_var = vars_get("PATH");
+    if (path_var == NULL)
+    {
+        path_var = DEFAULT_PATH;
+    }
+    if (cached_path_var == NULL || strcmp(cached_path_var, path_var) != 0)
+    {
+        load_path(path_var);
+    }
+
+    struct path_entry *e = capacity ? find_slot(table, capacity, name) : NULL;
+    if (e != NULL && e->name != NULL)
+    {
+        bool stale = false;
+        for (int i = 0; i <= e->dir; i++)
+        {
+            stale |= dir_changed(&dirs[i]);
+        }
+        if (!stale)
+        {
+            e->hits++;
+            return e->path;
+        }
+        path_forget_all();
+    }
+
+    char buf[PATH_MAX];
+    int dir = search_path(name, buf, sizeof(buf));
+    if (dir == -1)
+    {
+        return NULL;
+    }
+    insert(name, buf, dir, 1);
+    return find_slot(table, capacity, name)->path;
+}
+
+int hash_builtin(char **args)
+{
+    if (args[1] == NULL)
+    {
+        if (used == 0)
+        {
+            printf("hash: hash table empty\n");
+            return 0;
+        }
+        printf("hits\tcommand\n");
+        for (size_t i = 0; i < capacity; i++)
+        {
+            if (table[i].name != NULL)
+            {
+                printf("%4u\t%s\n", table[i].hits, table[i].path);
+            }
+        }
+        return 0;
+    }
+
+    int status = 0;
+    for (int i = 1; args[i] != NULL; i++)
+    {
+        if (strcmp(args[i], "-r") == 0)
+        {
+            path_forget_all();
+            continue;
+        }
+
+        // look the name up now without counting it as a use
+        if (path_lookup(args[i]) == NULL)
+        {
+            fprintf(stderr, "hash: %s: not found\n", args[i]);
+            status = 1;
+            continue;
+        }
+        if (strchr(args[i], '/') == NULL)
+        {
+            find_slot(table, capacity, args[i])->hits--;
+        }
+    }
+    return status;
+}
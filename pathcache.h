@@ -0,0 +1,17 @@
+// Command location cache
+// Remembers where each command was found in $PATH, like bash's hash table.
+
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+// absolute path of the command, or NULL if it is not in $PATH
+// names containing a "/" are returned unchanged
+const char *path_lookup(const char *name);
+
+// forget every remembered location
+void path_forget_all(void);
+
+// the "hash" builtin: hash, hash -r, hash name...
+int hash_builtin(char **args);
+
+#endif
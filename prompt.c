@@ -0,0 +1,291 @@
+// Prompt
+// The template is split into segments once. Escapes whose text cannot
+// change during the session, \u, \h, \H and \$, are resolved then and
+// merged into the literal text around them, so only \w, \W and \t are left
+// to fill in. The rendered prompt is kept and reused until the directory
+// changes, unless the template shows the time.
+// The directory is asked for when first needed and once after each cd. When
+// getcwd fails, as it does past PATH_MAX, the path is worked out from the
+// old one and the argument of cd instead, the way $PWD is kept.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include <pwd.h>
+#include "prompt.h"
+#include "vars.h"
+
+// the shell's own prompt, in colour
+#define DEFAULT_PS1 "\\[\\e[1;32m\\]muktadir\\[\\e[0m\\]👌\\[\\e[36m\\]\\w\\[\\e[0m\\]$ "
+
+enum segment_type
+{
+    SEGMENT_TEXT,
+    SEGMENT_CWD,      // \w, $HOME shown as ~
+    SEGMENT_CWD_BASE, // \W
+    SEGMENT_TIME,     // \t
+};
+
+struct segment
+{
+    enum segment_type type;
+    size_t start; // text of a SEGMENT_TEXT in literals
+    size_t len;
+};
+
+static struct segment *segments;
+static size_t segment_count;
+static char *literals;
+static size_t literals_len;
+static bool shows_time;
+
+static char *cwd;
+static const char *home;
+
+static char *rendered;
+static size_t rendered_len;
+static size_t rendered_cap;
+static bool rendered_valid;
+
+static void *xrealloc(void *p, size_t size)
+{
+    p = realloc(p, size);
+    if (p == NULL)
+    {
+        perror("realloc() error");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void add_segment(enum segment_type type)
+{
+    segments = xrealloc(segments, (segment_count + 1) * sizeof(struct segment));
+    segments[segment_count++] = (struct segment){type, literals_len, 0};
+}
+
+// literal text, joined to the segment before when that is text too
+static void add_text(const char *s, size_t n)
+{
+    if (segment_count == 0 || segments[segment_count - 1].type != SEGMENT_TEXT)
+    {
+        add_segment(SEGMENT_TEXT);
+    }
+    literals = xrealloc(literals, literals_len + n);
+    memcpy(literals + literals_len, s, n);
+    literals_len += n;
+    segments[segment_count - 1].len += n;
+}
+
+static void compile(const char *template)
+{
+    char host[256];
+    if (gethostname(host, sizeof(host)) == -1)
+    {
+        host[0] = '\0';
+    }
+    host[sizeof(host) - 1] = '\0';
+    struct passwd *pw = getpwuid(geteuid());
+    const char *user = pw != NULL ? pw->pw_name : "";
+
+    for (const char *p = template; *p; p++)
+    {
+        if (*p != '\\' || p[1] == '\0')
+        {
+            add_text(p, 1);
+            continue;
+        }
+        p++;
+        switch (*p)
+        {
+        case 'u':
+            add_text(user, strlen(user));
+            break;
+        case 'h':
+            add_text(host, strcspn(host, "."));
+            break;
+        case 'H':
+            add_text(host, strlen(host));
+            break;
+        case '$':
+            add_text(geteuid() == 0 ? "#" : "$", 1);
+            break;
+        case 'n':
+            add_text("\n", 1);
+            break;
+        case 'e':
+            add_text("\033", 1);
+            break;
+        case '\\':
+            add_text("\\", 1);
+            break;
+        case '[':
+        case ']':
+            // the line editor sees escape sequences without being told
+            break;
+        case 'w':
+            add_segment(SEGMENT_CWD);
+            break;
+        case 'W':
+            add_segment(SEGMENT_CWD_BASE);
+            break;
+        case 't':
+            add_segment(SEGMENT_TIME);
+            shows_time = true;
+            break;
+        default:
+            add_text(p - 1, 2);
+            break;
+        }
+    }
+}
+
+// resolve . and .. in an absolute path, in place
+static void normalize(char *path)
+{
+    char *out = path;
+    const char *p = path;
+    while (*p)
+    {
+        while (*p == '/')
+        {
+            p++;
+        }
+        const char *end = strchrnul(p, '/');
+        size_t len = end - p;
+        if (len == 0 || (len == 1 && p[0] == '.'))
+        {
+            // nothing
+        }
+        else if (len == 2 && p[0] == '.' && p[1] == '.')
+        {
+            while (out > path && *--out != '/')
+                ;
+        }
+        else
+        {
+            *out++ = '/';
+            memmove(out, p, len);
+            out += len;
+        }
+        p = end;
+    }
+    if (out == path)
+    {
+        *out++ = '/';
+    }
+    *out = '\0';
+}
+
+void prompt_init(void)
+{
+    const char *template = vars_get("SHELL_PS1");
+    compile(template != NULL ? template : DEFAULT_PS1);
+    // a copy, the variable's own string moves when it is set again
+    home = vars_get("HOME") != NULL ? strdup(vars_get("HOME")) : NULL;
+}
+
+void prompt_chdir(const char *path)
+{
+    char *now = getcwd(NULL, 0);
+    if (now == NULL && cwd != NULL)
+    {
+        // too deep for getcwd, follow the path from where the shell was
+        size_t len = strlen(cwd) + strlen(path) + 2;
+        now = malloc(len);
+        if (now == NULL)
+        {
+            perror("malloc() error");
+            exit(EXIT_FAILURE);
+        }
+        snprintf(now, len, "%s/%s", path[0] == '/' ? "" : cwd, path);
+        normalize(now);
+    }
+    // NULL is looked up again when it is needed
+    free(cwd);
+    cwd = now;
+    rendered_valid = false;
+}
+
+const char *prompt_cwd(void)
+{
+    if (cwd == NULL)
+    {
+        cwd = getcwd(NULL, 0);
+    }
+    if (cwd == NULL)
+    {
+        const char *pwd = vars_get("PWD");
+        cwd = strdup(pwd != NULL && pwd[0] == '/' ? pwd : "?");
+    }
+    return cwd;
+}
+
+static void append(const char *s, size_t n)
+{
+    if (rendered_len + n > rendered_cap)
+    {
+        rendered_cap = (rendered_len + n) * 2;
+        rendered = xrealloc(rendered, rendered_cap);
+    }
+    memcpy(rendered + rendered_len, s, n);
+    rendered_len += n;
+}
+
+const char *prompt_render(size_t *len)
+{
+    if (!rendered_valid || shows_time)
+    {
+        prompt_cwd();
+        rendered_len = 0;
+        for (size_t i = 0; i < segment_count; i++)
+        {
+            struct segment *s = &segments[i];
+            switch (s->type)
+            {
+            case SEGMENT_TEXT:
+                append(literals + s->start, s->len);
+                break;
+            case SEGMENT_CWD:
+            {
+                size_t home_len = home != NULL ? strlen(home) : 0;
+                if (home_len > 1 && strncmp(cwd, home, home_len) == 0 && (cwd[home_len] == '/' || cwd[home_len] == '\0'))
+                {
+                    append("~", 1);
+                    append(cwd + home_len, strlen(cwd + home_len));
+                }
+                else
+                {
+                    append(cwd, strlen(cwd));
+                }
+                break;
+            }
+            case SEGMENT_CWD_BASE:
+            {
+                const char *base = strrchr(cwd, '/');
+                base = base != NULL && base[1] != '\0' ? base + 1 : cwd;
+                append(base, strlen(base));
+                break;
+            }
+            case SEGMENT_TIME:
+            {
+                char buf[16];
+                time_t now = time(NULL);
+                struct tm tm;
+                localtime_r(&now, &tm);
+                append(buf, strftime(buf, sizeof(buf), "%H:%M:%S", &tm));
+                break;
+            }
+            }
+        }
+        append("", 1);
+        rendered_len--;
+        rendered_valid = true;
+    }
+    *len = rendered_len;
+    return rendered;
+}
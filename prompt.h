@@ -0,0 +1,24 @@
+// Prompt
+// $SHELL_PS1 is a template with bash's PS1 escapes, compiled once into a
+// list of segments. The working directory is cached and only looked up
+// again after cd.
+
+#ifndef PROMPT_H
+#define PROMPT_H
+
+#include <stddef.h>
+
+// compile $SHELL_PS1, or the default prompt
+void prompt_init(void);
+
+// the directory changed through cd to path
+void prompt_chdir(const char *path);
+
+// the working directory, looked up on the first call and after cd
+const char *prompt_cwd(void);
+
+// the rendered prompt, valid until the next call; rendered again only when
+// the directory changed or the template shows the time
+const char *prompt_render(size_t *len);
+
+#endif
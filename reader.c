@@ -0,0 +1,120 @@
+// Buffered line reader
+// One read(2) fills a block that usually holds many lines, and lines are
+// handed out in place, so a script costs a syscall per block, not per line.
+// A line longer than the buffer makes it grow, there is no length limit.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "reader.h"
+
+void reader_open_fd(struct reader *r, int fd)
+{
+    r->fd = fd;
+    r->size = READER_BLOCK_SIZE;
+    r->buf = malloc(r->size);
+    r->start = 0;
+    r->end = 0;
+    r->eof = r->buf == NULL;
+}
+
+void reader_open_string(struct reader *r, const char *text)
+{
+    r->fd = -1;
+    r->end = strlen(text);
+    r->size = r->end + 1;
+    r->buf = malloc(r->size);
+    r->start = 0;
+    r->eof = true;
+    if (r->buf == NULL)
+    {
+        r->end = 0;
+        return;
+    }
+    memcpy(r->buf, text, r->end);
+}
+
+// move the unread tail to the front and read another block after it
+static bool fill(struct reader *r)
+{
+    if (r->start > 0)
+    {
+        memmove(r->buf, r->buf + r->start, r->end - r->start);
+        r->end -= r->start;
+        r->start = 0;
+    }
+    if (r->size - r->end < READER_BLOCK_SIZE / 2)
+    {
+        char *grown = realloc(r->buf, r->size * 2);
+        if (grown == NULL)
+        {
+            perror("realloc() error");
+            return false;
+        }
+        r->buf = grown;
+        r->size *= 2;
+    }
+
+    ssize_t n;
+    do
+    {
+        // keep one byte free for the terminator of a last line without newline
+        n = read(r->fd, r->buf + r->end, r->size - r->end - 1);
+    } while (n == -1 && errno == EINTR);
+
+    if (n <= 0)
+    {
+        if (n == -1)
+        {
+            perror("read() error");
+        }
+        r->eof = true;
+        return false;
+    }
+    r->end += n;
+    return true;
+}
+
+char *reader_line(struct reader *r, size_t *len)
+{
+    size_t scanned = r->start;
+    while (true)
+    {
+        char *nl = memchr(r->buf + scanned, '\n', r->end - scanned);
+        if (nl != NULL)
+        {
+            char *line = r->buf + r->start;
+            *nl = '\0';
+            *len = nl - line;
+            r->start = nl - r->buf + 1;
+            return line;
+        }
+
+        // fill() shifts the data to the front of the buffer
+        size_t pending = r->end - r->start;
+        if (r->eof || !fill(r))
+        {
+            break;
+        }
+        scanned = pending;
+    }
+
+    // last line without a newline
+    if (r->end > r->start)
+    {
+        char *line = r->buf + r->start;
+        r->buf[r->end] = '\0';
+        *len = r->end - r->start;
+        r->start = r->end;
+        return line;
+    }
+    return NULL;
+}
+
+void reader_close(struct reader *r)
+{
+    free(r->buf);
+    r->buf = NULL;
+}
@@ -0,0 +1,34 @@
+// Buffered line reader
+// Reads input in large blocks and hands out one line at a time.
+
+#ifndef READER_H
+#define READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define READER_BLOCK_SIZE (64 * 1024)
+
+struct reader
+{
+    int fd; // -1 when reading from a string
+    char *buf;
+    size_t size;  // allocated size of buf
+    size_t start; // first byte not handed out yet
+    size_t end;   // end of the buffered data
+    bool eof;
+};
+
+// read from a file descriptor
+void reader_open_fd(struct reader *r, int fd);
+
+// read from a string, as given to -c
+void reader_open_string(struct reader *r, const char *text);
+
+// next line without its newline, NULL at the end of the input
+// the line stays valid until the next call
+char *reader_line(struct reader *r, size_t *len);
+
+void reader_close(struct reader *r);
+
+#endif
@@ -0,0 +1,281 @@
+// Redirections
+// Every descriptor the shell opens for a redirection is close-on-exec: a
+// child only gets what was copied onto its own numbers. A heredoc's text is
+// written to a memfd and read back by the command from the start. Kernels
+// without memfds get a pipe, grown to hold the text when it is large.
+// Builtins and { } groups run inside the shell, so their redirections are
+// applied to the shell's own descriptors: each one that is redirected is
+// first copied out of the way, and put back afterwards. stdio buffers are
+// flushed on both sides so output lands on the descriptor it was meant for.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include "redirect.h"
+
+#define PRIVATE_FD_MAX 1024 // higher descriptors are not tracked
+
+static bool private_fds[PRIVATE_FD_MAX];
+
+// open(2) flags for each kind of file redirection
+static const int open_flags[] = {
+    [REDIRECT_INPUT] = O_RDONLY,
+    [REDIRECT_OUTPUT] = O_WRONLY | O_TRUNC | O_CREAT,
+    [REDIRECT_APPEND] = O_WRONLY | O_APPEND | O_CREAT,
+};
+
+int redirect_open(const struct redirect *r)
+{
+    return open(r->target, open_flags[r->type] | O_CLOEXEC, REDIRECT_MODE);
+}
+
+int redirect_private(int fd)
+{
+    if (fd >= 0 && fd < PRIVATE_FD_MIN)
+    {
+        int moved = fcntl(fd, F_DUPFD_CLOEXEC, PRIVATE_FD_MIN);
+        if (moved != -1)
+        {
+            close(fd);
+            fd = moved;
+        }
+    }
+    if (fd >= 0 && fd < PRIVATE_FD_MAX)
+    {
+        private_fds[fd] = true;
+    }
+    return fd;
+}
+
+void redirect_close_private(int fd)
+{
+    if (fd >= 0 && fd < PRIVATE_FD_MAX)
+    {
+        private_fds[fd] = false;
+    }
+    close(fd);
+}
+
+void redirect_forget_private(void)
+{
+    memset(private_fds, 0, sizeof(private_fds));
+}
+
+bool redirect_is_private(int fd)
+{
+    return fd >= 0 && fd < PRIVATE_FD_MAX && private_fds[fd];
+}
+
+// whether r copies a private descriptor that no redirection before it in
+// list replaced
+static bool copies_private(const struct redirect *list, const struct redirect *r)
+{
+    if (r->type != REDIRECT_DUP || !redirect_is_private(r->from))
+    {
+        return false;
+    }
+    for (const struct redirect *p = list; p != r; p = p->next)
+    {
+        if (p->fd == r->from)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int write_all(int fd, const char *text, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, text, len);
+        if (n == -1)
+        {
+            return -1;
+        }
+        text += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// a descriptor to read text from
+static int text_fd(const char *text, size_t len)
+{
+    int fd = memfd_create("heredoc", MFD_CLOEXEC);
+    if (fd != -1)
+    {
+        if (write_all(fd, text, len) == -1 || lseek(fd, 0, SEEK_SET) == -1)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    int pipefd[2];
+    if (pipe2(pipefd, O_CLOEXEC) == -1)
+    {
+        return -1;
+    }
+    // the text is written before anyone reads, so it has to fit
+    if (len > (size_t)fcntl(pipefd[1], F_GETPIPE_SZ) && fcntl(pipefd[1], F_SETPIPE_SZ, (int)len) == -1)
+    {
+        close(pipefd[0]);
+        close(pipefd[1]);
+        errno = EFBIG;
+        return -1;
+    }
+    int result = write_all(pipefd[1], text, len);
+    close(pipefd[1]);
+    if (result == -1)
+    {
+        close(pipefd[0]);
+        return -1;
+    }
+    return pipefd[0];
+}
+
+int redirect_prepare(struct redirect *list)
+{
+    for (struct redirect *r = list; r != NULL; r = r->next)
+    {
+        if (r->type != REDIRECT_HEREDOC && r->type != REDIRECT_STRING)
+        {
+            continue;
+        }
+        r->from = text_fd(r->target, r->target_len);
+        if (r->from == -1)
+        {
+            fprintf(stderr, "%s: %s\n", r->type == REDIRECT_HEREDOC ? "here-document" : "here-string", strerror(errno));
+            redirect_release(list);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void redirect_release(struct redirect *list)
+{
+    for (struct redirect *r = list; r != NULL; r = r->next)
+    {
+        if ((r->type == REDIRECT_HEREDOC || r->type == REDIRECT_STRING) && r->from != -1)
+        {
+            close(r->from);
+            r->from = -1;
+        }
+    }
+}
+
+int redirect_apply(const struct redirect *list, const struct redirect *r)
+{
+    int fd = r->from;
+    if (copies_private(list, r))
+    {
+        fprintf(stderr, "%d: %s\n", r->from, strerror(EBADF));
+        return -1;
+    }
+    if (r->type == REDIRECT_INPUT || r->type == REDIRECT_OUTPUT || r->type == REDIRECT_APPEND)
+    {
+        fd = redirect_open(r);
+        if (fd == -1)
+        {
+            fprintf(stderr, "%s: %s\n", r->target, strerror(errno));
+            return -1;
+        }
+    }
+    else if (fd == -1)
+    {
+        // n>&-
+        close(r->fd);
+        return 0;
+    }
+
+    // the same number, it only has to survive exec
+    int result = fd == r->fd ? fcntl(fd, F_SETFD, 0) : dup2(fd, r->fd);
+    int err = errno;
+    if (fd != r->fd && fd != r->from)
+    {
+        close(fd);
+    }
+    if (result == -1)
+    {
+        fprintf(stderr, "%d: %s\n", r->type == REDIRECT_DUP ? r->from : r->fd, strerror(err));
+        return -1;
+    }
+    return 0;
+}
+
+int redirect_count(const struct redirect *list)
+{
+    int count = 0;
+    for (const struct redirect *r = list; r != NULL; r = r->next)
+    {
+        count++;
+    }
+    return count;
+}
+
+int redirect_save(const struct redirect *list, struct saved_fd *saved)
+{
+    int count = 0;
+    fflush(stdout);
+    fflush(stderr);
+    for (const struct redirect *r = list; r != NULL; r = r->next)
+    {
+        // a descriptor redirected twice is saved once, before the first
+        bool seen = false;
+        for (int i = 0; i < count; i++)
+        {
+            seen = seen || saved[i].fd == r->fd;
+        }
+        if (!seen)
+        {
+            int copy = fcntl(r->fd, F_DUPFD_CLOEXEC, PRIVATE_FD_MIN);
+            if (copy == -1 && errno != EBADF)
+            {
+                perror("fcntl() error");
+                redirect_restore(saved, count);
+                return -1;
+            }
+            saved[count++] = (struct saved_fd){r->fd, copy != -1 ? redirect_private(copy) : -1, redirect_is_private(r->fd)};
+            if (r->fd < PRIVATE_FD_MAX)
+            {
+                private_fds[r->fd] = false;
+            }
+        }
+
+        if (redirect_apply(list, r) == -1)
+        {
+            redirect_restore(saved, count);
+            return -1;
+        }
+    }
+    return count;
+}
+
+void redirect_restore(struct saved_fd *saved, int count)
+{
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = count - 1; i >= 0; i--)
+    {
+        if (saved[i].private)
+        {
+            private_fds[saved[i].fd] = true;
+        }
+        if (saved[i].copy == -1)
+        {
+            close(saved[i].fd);
+            continue;
+        }
+        // a private descriptor stays close-on-exec
+        dup3(saved[i].copy, saved[i].fd, saved[i].private ? O_CLOEXEC : 0);
+        redirect_close_private(saved[i].copy);
+    }
+}
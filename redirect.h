@@ -0,0 +1,72 @@
+// Redirections
+// Files, descriptor copies, heredocs and here-strings, applied in the order
+// they were written. Heredocs and here-strings are handed to the command
+// through a memfd holding the text, so no temporary file is written.
+
+#ifndef REDIRECT_H
+#define REDIRECT_H
+
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "parser.h"
+
+// permissions of a created file, less the umask
+#define REDIRECT_MODE (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)
+
+// open the file of a file redirection, close-on-exec
+// returns the descriptor, or -1 with errno set
+int redirect_open(const struct redirect *r);
+
+// descriptors the shell keeps for itself, for signals, logs and the
+// script it reads, are moved to PRIVATE_FD_MIN or above, out of the way of
+// the numbers scripts use, and a redirection that copies one fails with
+// EBADF as if it were closed
+#define PRIVATE_FD_MIN 10
+
+// move fd to PRIVATE_FD_MIN or above, close-on-exec, and mark it private
+// returns the descriptor to use, fd itself when it could not be moved
+int redirect_private(int fd);
+
+// close the private descriptor fd
+void redirect_close_private(int fd);
+
+// forget every private descriptor, for a forked copy of the shell that
+// closed them
+void redirect_forget_private(void);
+
+// whether fd is a private descriptor of the shell
+bool redirect_is_private(int fd);
+
+// give every heredoc and here-string of the list a descriptor to read from
+// returns 0, or -1 after printing an error
+int redirect_prepare(struct redirect *list);
+
+// close the descriptors redirect_prepare made
+void redirect_release(struct redirect *list);
+
+// apply r, one of list, to the descriptors of this process; r may copy a
+// private descriptor only when a redirection before it in list replaced it
+// returns 0, or -1 after printing an error
+int redirect_apply(const struct redirect *list, const struct redirect *r);
+
+// a descriptor of the shell and where it was kept while redirected
+struct saved_fd
+{
+    int fd;
+    int copy;     // -1 when fd was not open
+    bool private; // fd was a private descriptor, the redirection's meanwhile
+};
+
+// number of redirections in list, the room redirect_save needs
+int redirect_count(const struct redirect *list);
+
+// apply list to the shell's own descriptors for a builtin or { } group,
+// copying each one it replaces into saved first
+// returns how many were saved, or -1 after printing an error with
+// everything put back
+int redirect_save(const struct redirect *list, struct saved_fd *saved);
+
+// put back what redirect_save kept, the last saved first
+void redirect_restore(struct saved_fd *saved, int count);
+
+#endif
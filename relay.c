@@ -0,0 +1,183 @@
+// In-shell pipe relay
+// The shell sits between two stages, holding the read end of the upstream
+// pipe and the write end of the downstream one. splice(2) moves the pipe
+// buffers from one to the other without copying them, and tee(2) duplicates
+// them into a tap file when one was requested.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include "relay.h"
+
+#define RELAY_CHUNK (1 << 20)
+
+// close the shell's ends of a finished junction
+static void close_junction(struct relay_junction *j)
+{
+    close(j->src);
+    close(j->dst);
+    j->src = -1;
+    j->dst = -1;
+    if (j->tap_pipe[0] >= 0)
+    {
+        close(j->tap_pipe[0]);
+        close(j->tap_pipe[1]);
+        j->tap_pipe[0] = j->tap_pipe[1] = -1;
+    }
+}
+
+// move teed bytes from the tap pipe into the tap file
+static void drain_tap(struct relay_junction *j, ssize_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = splice(j->tap_pipe[0], NULL, j->tap, NULL, len, SPLICE_F_MOVE);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            // the tap is best effort, never stall the pipeline for it
+            perror("splice() tap error");
+            close(j->tap_pipe[0]);
+            close(j->tap_pipe[1]);
+            j->tap_pipe[0] = j->tap_pipe[1] = -1;
+            return;
+        }
+        len -= n;
+    }
+}
+
+// move as much as possible through one junction
+// returns 1 on progress, 0 when it would block and -1 when the junction is done
+static int pump(struct relay_junction *j)
+{
+    if (j->pending == 0 && j->tap_pipe[0] >= 0)
+    {
+        ssize_t t = tee(j->src, j->tap_pipe[1], RELAY_CHUNK, SPLICE_F_NONBLOCK);
+        if (t == 0)
+        {
+            return -1;
+        }
+        if (t < 0)
+        {
+            return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+        }
+        drain_tap(j, t);
+        j->pending = t;
+    }
+
+    size_t len = j->pending ? j->pending : RELAY_CHUNK;
+    ssize_t n = splice(j->src, NULL, j->dst, NULL, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n > 0)
+    {
+        j->moved += n;
+        j->pending -= (size_t)n < j->pending ? (size_t)n : j->pending;
+        return 1;
+    }
+    if (n == 0)
+    {
+        return -1;
+    }
+    if (errno == EAGAIN || errno == EINTR)
+    {
+        return 0;
+    }
+    if (errno != EPIPE)
+    {
+        perror("splice() error");
+    }
+    return -1;
+}
+
+void relay_pipeline(struct relay_junction *junctions, int count)
+{
+    struct pollfd *fds = malloc(sizeof(struct pollfd) * count);
+    if (fds == NULL)
+    {
+        perror("malloc() error");
+        return;
+    }
+
+    int open_count = 0;
+    for (int i = 0; i < count; i++)
+    {
+        struct relay_junction *j = &junctions[i];
+        j->moved = 0;
+        j->pending = 0;
+        j->blocked = false;
+        j->tap_pipe[0] = j->tap_pipe[1] = -1;
+        if (j->tap >= 0 && pipe2(j->tap_pipe, O_CLOEXEC) == -1)
+        {
+            perror("pipe() error");
+        }
+
+        // only the shell's ends become non-blocking, the stages keep theirs
+        fcntl(j->src, F_SETFL, fcntl(j->src, F_GETFL) | O_NONBLOCK);
+        fcntl(j->dst, F_SETFL, fcntl(j->dst, F_GETFL) | O_NONBLOCK);
+        open_count++;
+    }
+
+    while (open_count > 0)
+    {
+        // wait on the source, or on the destination once it has filled up
+        for (int i = 0; i < count; i++)
+        {
+            struct relay_junction *j = &junctions[i];
+            fds[i].fd = j->blocked ? j->dst : j->src;
+            fds[i].events = j->blocked ? POLLOUT : POLLIN;
+            fds[i].revents = 0;
+        }
+
+        if (poll(fds, count, -1) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("poll() error");
+            break;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            struct relay_junction *j = &junctions[i];
+            if (j->src < 0 || fds[i].revents == 0)
+            {
+                continue;
+            }
+
+            int r;
+            while ((r = pump(j)) > 0)
+                ;
+            if (r < 0)
+            {
+                // downstream sees EOF, upstream gets SIGPIPE on its next write
+                close_junction(j);
+                open_count--;
+            }
+            else
+            {
+                // data still queued upstream means the destination is full
+                int avail = 0;
+                ioctl(j->src, FIONREAD, &avail);
+                j->blocked = avail > 0 || j->pending > 0;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (junctions[i].src >= 0)
+        {
+            close_junction(&junctions[i]);
+        }
+    }
+    free(fds);
+}
@@ -0,0 +1,29 @@
+// In-shell pipe relay
+// Moves data between pipeline stages with splice(2)/tee(2) so the
+// bytes never get copied through userspace.
+
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+// one junction between two pipeline stages
+struct relay_junction
+{
+    int src;         // read end of the upstream stage's stdout pipe
+    int dst;         // write end of the downstream stage's stdin pipe
+    int tap;         // file the stream is copied into with tee(2), or -1
+    long long moved; // total bytes moved through this junction
+
+    // internal state
+    int tap_pipe[2];
+    size_t pending; // bytes already teed but not yet spliced to dst
+    bool blocked;   // waiting for dst to drain
+};
+
+// relay every junction until all upstream writers are closed
+// or all downstream readers are gone, then close the shell's ends
+void relay_pipeline(struct relay_junction *junctions, int count);
+
+#endif
@@ -1,2 +1 @@
-gcc shell.c -o ./bin/shell
-./bin/shell
+make && ./build/release/shell
@@ -1,6 +1,7 @@
 // Custom Shell
 // Author: Muktadir Hassan
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
@@ -10,12 +11,29 @@
 #include <string.h>
 #include <signal.h>
 #include <time.h>
-#include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
-
-#define MAX_COMMAND_LENGTH 100
+#include <errno.h>
+#include <dirent.h>
+#include "relay.h"
+#include "launch.h"
+#include "pathcache.h"
+#include "reader.h"
+#include "arena.h"
+#include "lexer.h"
+#include "parser.h"
+#include "jobs.h"
+#include "usage.h"
+#include "history.h"
+#include "editor.h"
+#include "complete.h"
+#include "prompt.h"
+#include "builtins.h"
+#include "redirect.h"
+#include "vars.h"
+#include "glob.h"
+#include "trace.h"
 
 // ANSI color codes
 #define RED "\x1B[31m"
@@ -38,10 +56,27 @@
 #define RIGHT "\033[1C"
 #define LEFT "\033[1D"
 
+// shown while the lines of a heredoc, or of a command that goes on past its
+// first line, are read
+#define CONTINUATION_PROMPT "> "
+
 // Function declarations
-void listFiles();
 void current_directory();
 
+// false when running a script or -c, no prompt, banner or colours then
+bool interactive = true;
+
+// where command lines come from: the line editor on a terminal, the
+// reader otherwise
+static struct reader input;
+static struct editor editor;
+static bool editing = false;
+
+// exit status of the last command, also $?, and whether exit was run
+int last_status = 0;
+static struct var *status_var;
+bool exiting = false;
+
 // Global variable to track if Ctrl+C was pressed
 volatile sig_atomic_t ctrlCPressed = 0;
 
@@ -54,346 +89,987 @@ void sigintHandler(int signum)
 void clear_screen()
 {
     const char *CLEAR_SCREEN_ANSI = "\e[1;1H\e[2J";
-    write(STDOUT_FILENO, CLEAR_SCREEN_ANSI, 12);
+    write(STDOUT_FILENO, CLEAR_SCREEN_ANSI, strlen(CLEAR_SCREEN_ANSI));
 }
 
-// print prompt
-void print_prompt()
+// print the welcome banner, once when the shell starts
+void print_banner()
 {
-    static int first_time = 1;
-    char cwd[1024];
-    if (first_time)
+    // clear screen
+    clear_screen();
+    printf(CYAN BOLD UNDERLINE "Welcome to Muktadir's Shell\n" RESET);
+    printf(BOLD "Type \"exit\" to exit the shell\n" RESET);
+    printf(BOLD "Type \"clear\" to clear the screen\n" RESET);
+    printf(BOLD "Type \"ls\" to list files in the current directory\n" RESET);
+    printf(BOLD "Type \"pwd\" to print the current directory\n" RESET);
+    printf(BOLD "Type \"cd <directory>\" to change the current directory\n" RESET);
+    printf(BOLD "Type \"<command> &\" to run the command in the background\n" RESET);
+    printf(BOLD "Type \"<command> < <input_file>\" to redirect input from a file\n" RESET);
+    printf(BOLD "Type \"<command> > <output_file>\" to redirect output to a file\n" RESET);
+    printf(BOLD "Type \"<command> | <command>\" to pipe one command into the next\n" RESET);
+    printf(BOLD "Type \"a; b\", \"a && b\" or \"a || b\" to run commands in turn, \"{ a; b; }\" or \"(a; b)\" to group them\n" RESET);
+    printf(BOLD "Type \"hash\" to list remembered command locations, \"hash -r\" to forget them\n" RESET);
+    printf(BOLD "Type \"bench -n <runs> -- <command> [-- <command>]\" to time a command, or compare two\n" RESET);
+    printf(BOLD "Type \"parallel -j <jobs> <command> {} ::: <items>\" to run a command for many items at once\n" RESET);
+    printf(BOLD "Type \"echo\", \"printf\", \"test\", \"true\" or \"false\" for the builtin versions, run in the shell\n" RESET);
+    printf(BOLD "Type \"history\" to list past commands, \"!!\", \"!n\" or \"!prefix\" to run one again\n" RESET);
+    printf(BOLD "Use \"NAME=value\" and \"$NAME\" for variables, \"export NAME\" and \"unset NAME\" to manage them\n" RESET);
+    printf(BOLD "Use \"*\", \"?\", \"[...]\" and \"**\" to match file names, as in \"logs/**/*.gz\"\n" RESET);
+    printf(BOLD "Type \"stats\" to see how long each phase of running a command takes, set SHELL_TRACE=<file> for a Chrome trace\n" RESET);
+    printf(BOLD "Type \"jobs\" to list jobs, \"fg %%n\", \"bg %%n\", \"wait\" and \"kill %%n\" to control them\n" RESET);
+    printf(BOLD "Use the arrow keys to edit the line and browse history, Ctrl+R to search it, Tab to complete\n" RESET);
+    fflush(stdout);
+}
+
+static void release_redirects(struct stage *stages, int count)
+{
+    for (int s = 0; s < count; s++)
     {
-        // clear screen
-        clear_screen();
-        first_time = 0;
-        printf(CYAN BOLD UNDERLINE "Welcome to Muktadir's Shell\n" RESET);
-        printf(BOLD "Type \"exit\" to exit the shell\n" RESET);
-        printf(BOLD "Type \"clear\" to clear the screen\n" RESET);
-        printf(BOLD "Type \"ls\" to list files in the current directory\n" RESET);
-        printf(BOLD "Type \"pwd\" to print the current directory\n" RESET);
-        printf(BOLD "Type \"cd <directory>\" to change the current directory\n" RESET);
-        printf(BOLD "Type \"<command> &\" to run the command in the background\n" RESET);
-        printf(BOLD "Type \"<command> < <input_file>\" to redirect input from a file\n" RESET);
-        printf(BOLD "Type \"<command> > <output_file>\" to redirect output to a file\n" RESET);
+        redirect_release(stages[s].redirects);
     }
+}
 
-    if (getcwd(cwd, sizeof(cwd)) == NULL)
+static int execute_node(struct arena *arena, struct node *node, bool tail);
+
+// what exec would do for a copy of the shell: every descriptor the shell
+// keeps for itself is close-on-exec, so only the command's own stay open
+static void close_cloexec(void)
+{
+    DIR *dir = opendir("/proc/self/fd");
+    if (dir == NULL)
     {
-        perror("getcwd() error");
+        for (int fd = STDERR_FILENO + 1; fd < 1024; fd++)
+        {
+            if (fcntl(fd, F_GETFD) > 0)
+            {
+                close(fd);
+            }
+        }
         return;
     }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        int fd = atoi(entry->d_name);
+        if (fd > STDERR_FILENO && fd != dirfd(dir) && fcntl(fd, F_GETFD) > 0)
+        {
+            close(fd);
+        }
+    }
+    closedir(dir);
+}
+
+// run a compound stage, or builtin with the stage's arguments, in a forked
+// copy of the shell, reading in and writing out when they are not -1, in
+// process group pgid, see struct launch
+// returns the copy's pid, or -1 when fork failed
+static pid_t start_subshell(struct arena *arena, const struct stage *stage, const struct builtin *builtin, int in, int out, pid_t pgid, const sigset_t *mask)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+    {
+        return pid;
+    }
+
+    // the copy is a command like any other to the terminal and the pipes
+    if (pgid != -1)
+    {
+        setpgid(0, pgid);
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+    signal(SIGTTIN, SIG_DFL);
+    signal(SIGTTOU, SIG_DFL);
+    sigprocmask(SIG_SETMASK, mask, NULL);
+    if (in != -1)
+    {
+        dup2(in, STDIN_FILENO);
+    }
+    if (out != -1)
+    {
+        dup2(out, STDOUT_FILENO);
+    }
+    for (const struct redirect *r = stage->redirects; r != NULL; r = r->next)
+    {
+        if (redirect_apply(stage->redirects, r) == -1)
+        {
+            exit(EXIT_FAILURE);
+        }
+    }
+    close_cloexec();
+    redirect_forget_private();
+    jobs_subshell();
+    usage_init(false);
+    trace_child();
+    interactive = false;
+    editing = false;
 
-    printf("\033[1;32m");
-    printf("muktadir");
-    printf("\033[0m");
-    printf("👌");
-    printf(CYAN "%s", cwd);
-    printf("\033[0m");
-    printf("$ ");
+    int status = builtin != NULL ? builtin_call(builtin, stage->args) : execute_node(arena, stage->compound, true);
     fflush(stdout);
+    trace_flush();
+    _exit(status);
 }
 
-// signal handler for SIGCHLD
-void sigchldHandler(int signum)
+// run a { } group, or a ( ) one in a copy of the shell that has nothing
+// else to do, in this process with the stage's redirections around it
+static int run_group(struct arena *arena, const struct stage *stage, bool tail)
 {
-    int status;
-    while (waitpid(-1, &status, WNOHANG) > 0)
-        ;
+    int count = redirect_count(stage->redirects);
+    if (count == 0)
+    {
+        return execute_node(arena, stage->compound, tail);
+    }
+    struct saved_fd saved[count];
+    int saved_count = redirect_save(stage->redirects, saved);
+    if (saved_count == -1)
+    {
+        return 1;
+    }
+    int status = execute_node(arena, stage->compound, false);
+    redirect_restore(saved, saved_count);
+    return status;
 }
 
-// parse command into arguments
-void parse_command(char *command, char **args, bool *background)
+static void set_status(int status)
 {
-    // remove newline character
-    command[strlen(command) - 1] = '\0';
+    char text[16];
+    snprintf(text, sizeof(text), "%d", status);
+    last_status = status;
+    vars_set(status_var, text);
+}
+
+// the words and redirection targets of the stage with the variables filled
+// in, afresh each time it runs
+static void expand_stage(struct arena *arena, struct stage *stage)
+{
+    if (stage->words != NULL)
+    {
+        stage->argc = vars_expand(arena, stage->words, stage->word_count, &stage->args);
+    }
+    for (struct redirect *r = stage->redirects; r != NULL; r = r->next)
+    {
+        if (r->word == NULL)
+        {
+            continue;
+        }
+        char *target = vars_expand_word(arena, r->word);
+        size_t len = strlen(target);
+        if (r->type == REDIRECT_STRING)
+        {
+            // the string is fed with a newline, like bash does
+            target = arena_grow(arena, target, len + 1, len + 2);
+            target[len++] = '\n';
+            target[len] = '\0';
+        }
+        r->target = target;
+        r->target_len = len;
+    }
+}
 
-    // split command into arguments
-    char *token = strtok(command, " ");
+// "NAME=value" for each assignment written before the command
+static char **assignment_entries(struct arena *arena, const struct stage *stage, int *count)
+{
+    *count = 0;
+    for (const struct assignment *a = stage->assignments; a != NULL; a = a->next)
+    {
+        (*count)++;
+    }
+    char **entries = arena_alloc(arena, (*count + 1) * sizeof(char *));
     int i = 0;
-    while (token != NULL)
+    for (const struct assignment *a = stage->assignments; a != NULL; a = a->next)
     {
-        args[i++] = token;
-        token = strtok(NULL, " ");
+        const char *value = vars_expand_word(arena, &a->value);
+        size_t name_len = strlen(a->name), value_len = strlen(value);
+        char *entry = arena_alloc(arena, name_len + value_len + 2);
+        memcpy(entry, a->name, name_len);
+        entry[name_len] = '=';
+        memcpy(entry + name_len + 1, value, value_len + 1);
+        entries[i++] = entry;
     }
-    args[i] = NULL;
+    entries[i] = NULL;
+    return entries;
+}
 
-    // check if command should be run in the background
-    if (i > 0 && strcmp(args[i - 1], "&") == 0)
+// the environment of an external command: the exported variables, with its
+// own assignments patched in when it has any
+static char **command_environ(struct arena *arena, const struct stage *stage)
+{
+    if (stage->assignments == NULL)
     {
-        *background = true;
-        args[i - 1] = NULL; // remove & from arguments
+        return NULL;
     }
+    int count;
+    char **entries = assignment_entries(arena, stage, &count);
+    return vars_environ_with(arena, entries, count);
 }
 
-// first argument is the command
-// rest are options such as -l, -a, -r
-// execute command and measure time taken
-void execute_command(char **args, bool background)
+// set the stage's assignments as shell variables; with a builtin they only
+// last while it runs and the old values are put back
+static int run_assignments(struct arena *arena, const struct builtin *builtin, const struct stage *stage)
 {
-    printf("\n\n");
-    printf(BOLD CYAN "Command " RESET);
-    for (int i = 0; args[i] != NULL; i++)
+    int count;
+    char **entries = assignment_entries(arena, stage, &count);
+    struct var *vars[count + 1];
+    const char *saved[count + 1];
+    for (int i = 0; i < count; i++)
     {
-        printf("%s ", args[i]);
+        const char *eq = strchr(entries[i], '=');
+        vars[i] = vars_intern(entries[i], eq - entries[i]);
+        const char *old = var_value(vars[i]);
+        saved[i] = old != NULL ? arena_strndup(arena, old, strlen(old)) : NULL;
+        vars_set(vars[i], eq + 1);
+    }
+    if (builtin == NULL)
+    {
+        return 0;
     }
-    printf("\n\n");
 
-    if (strcmp(args[0], "cd") == 0)
+    int status = builtin_run(builtin, stage);
+    for (int i = count - 1; i >= 0; i--)
     {
-        if (args[1] == NULL)
+        if (saved[i] != NULL)
         {
-            printf("cd: expected argument to \"cd\"\n");
+            vars_set(vars[i], saved[i]);
         }
         else
         {
-            if (chdir(args[1]) != 0)
-            {
-                perror("chdir() error");
-            }
+            vars_unset(vars[i]);
         }
-        return;
     }
+    return status;
+}
+
+// first argument is the command
+// rest are options such as -l, -a, -r
+// commands separated by "|" form a pipeline, one process per stage
+// execute command, its time and resource usage are reported when it ends
+// tail says nothing runs after it in this copy of the shell, so a lone
+// command can take the copy's place instead of being started from it
+// returns the exit status of the command
+int execute_command(struct arena *arena, struct pipeline *pipeline, bool tail)
+{
+    struct stage *stages = pipeline->stages;
+    int count = pipeline->count;
+    bool background = pipeline->background;
+    // commands before this one may have changed the directories
+    uint64_t start = trace_now();
+    glob_reset();
+    for (int s = 0; s < count; s++)
+    {
+        expand_stage(arena, &stages[s]);
+    }
+    // builtin dispatch is timed from here, the lookup is part of it
+    start = trace_end(TRACE_EXPAND, start, pipeline->text);
+    char **args = stages[0].args;
 
-    // check for redirection
-    int in = 0, out = 0; // file descriptors for input and output files
-    char *input_file = NULL, *output_file = NULL;
-    for (int i = 0; args[i] != NULL; i++)
+    // a builtin runs in the shell, except in a pipeline, and with & unless
+    // it changes the shell itself
+    // heredocs and here-strings are read from descriptors made here
+    for (int s = 0; s < count; s++)
     {
-        if (strcmp(args[i], "<") == 0)
+        if (redirect_prepare(stages[s].redirects) == -1)
         {
-            input_file = args[i + 1];
-            args[i] = NULL;
-        }
-        else if (strcmp(args[i], ">") == 0)
-        {
-            output_file = args[i + 1];
-            args[i] = NULL;
+            release_redirects(stages, s);
+            return 1;
         }
     }
 
-    // fork child process
-    pid_t pid = fork();
+    // NAME=value alone sets shell variables, its redirections are still
+    // made like for a command that does nothing
+    struct node *compound = stages[0].compound;
+    if (count == 1 && compound == NULL && stages[0].argc == 0)
+    {
+        run_assignments(arena, NULL, &stages[0]);
+        int status = builtin_run(builtin_lookup("true"), &stages[0]);
+        release_redirects(stages, count);
+        return status;
+    }
 
-    // execute command and measure time taken
-    struct timespec start, end;
-    clock_gettime(CLOCK_MONOTONIC, &start);
+    const struct builtin *builtin = count == 1 && compound == NULL ? builtin_lookup(args[0]) : NULL;
+    if (builtin != NULL && (!background || builtin->flags & BUILTIN_SHELL))
+    {
+        int status = stages[0].assignments != NULL ? run_assignments(arena, builtin, &stages[0]) : builtin_run(builtin, &stages[0]);
+        trace_end(TRACE_BUILTIN, start, builtin->name);
+        release_redirects(stages, count);
+        return status;
+    }
 
-    if (pid == 0)
+    // a { } group runs in the shell, a ( ) group forks once below
+    if (count == 1 && !background && compound != NULL && (compound->type == NODE_GROUP || tail))
     {
+        int status = run_group(arena, &stages[0], tail);
+        release_redirects(stages, count);
+        return status;
+    }
+
+    // the children start with our signal mask
+    sigset_t mask;
+    sigprocmask(SIG_SETMASK, NULL, &mask);
+
+    // children must not see our buffered output
+    fflush(stdout);
+
+    if (tail && count == 1 && !background && compound == NULL)
+    {
+        const char *path = path_lookup(args[0]);
+        if (path == NULL)
+        {
+            fprintf(stderr, "%s: command not found\n", args[0]);
+            return 127;
+        }
+        struct launch l = {path, args, -1, -1, -1, stages[0].redirects, getpgrp(), &mask, command_environ(arena, &stages[0])};
+        trace_flush();
+        launch_exec(&l);
+        fprintf(stderr, "%s: %s\n", args[0], strerror(errno));
+        return 126;
+    }
+
+    // the relay keeps the shell between the stages, so only foreground pipelines use it
+    bool relay = !background && count > 1 && vars_get("SHELL_PIPE_RELAY") != NULL;
+    const char *tap_prefix = relay ? vars_get("SHELL_PIPE_TAP") : NULL;
+    struct relay_junction *junctions = arena_alloc(arena, count * sizeof(struct relay_junction));
 
-        // handle input redirection
-        if (input_file != NULL)
+    // execute command, the job measures its time and resources from here
+    // every stage joins the process group of the first one
+    struct job *job = job_create(pipeline->text, count);
+    int prev_read = -1;
+    for (int s = 0; s < count; s++)
+    {
+        int pipefd[2] = {-1, -1};
+        int next_read = -1;
+        if (s < count - 1)
         {
-            in = open(input_file, O_RDONLY);
-            if (in == -1)
+            if (pipe2(pipefd, O_CLOEXEC) == -1)
             {
-                perror("open() error");
+                perror("pipe() error");
                 exit(EXIT_FAILURE);
             }
-            dup2(in, STDIN_FILENO);
-            close(in);
+            next_read = pipefd[0];
+
+            if (relay)
+            {
+                // the stage writes into one pipe, the next reads from another,
+                // and the shell keeps the two ends in between
+                int downstream[2];
+                if (pipe2(downstream, O_CLOEXEC) == -1)
+                {
+                    perror("pipe() error");
+                    exit(EXIT_FAILURE);
+                }
+                junctions[s].src = pipefd[0];
+                junctions[s].dst = downstream[1];
+                junctions[s].tap = -1;
+                next_read = downstream[0];
+
+                if (tap_prefix != NULL)
+                {
+                    char tap_file[1024];
+                    snprintf(tap_file, sizeof(tap_file), "%s.%d", tap_prefix, s + 1);
+                    junctions[s].tap = open(tap_file, O_WRONLY | O_TRUNC | O_CREAT | O_CLOEXEC, 0644);
+                    if (junctions[s].tap == -1)
+                    {
+                        perror("open() tap error");
+                    }
+                }
+            }
         }
 
-        // handle output redirection
-        if (output_file != NULL)
+        // launch child process, a copy of the shell for a compound stage
+        // and for a builtin that has no command of the same name
+        const char *path = NULL;
+        const struct builtin *stage_builtin = NULL;
+        if (stages[s].argc > 0)
+        {
+            path = path_lookup(stages[s].args[0]);
+            stage_builtin = path == NULL ? builtin_lookup(stages[s].args[0]) : NULL;
+        }
+        pid_t pid;
+        start = trace_now();
+        if (stages[s].compound != NULL || stage_builtin != NULL)
         {
-            out = open(output_file, O_WRONLY | O_TRUNC | O_CREAT, S_IRUSR | S_IRGRP | S_IWGRP | S_IWUSR);
-            if (out == -1)
+            pid = start_subshell(arena, &stages[s], stage_builtin, prev_read, pipefd[1], job_pgid(job), &mask);
+            if (pid == -1)
             {
-                perror("open() error");
-                exit(EXIT_FAILURE);
+                perror("fork() error");
+            }
+        }
+        else if (stages[s].argc == 0)
+        {
+            // nothing to run, its assignments would be lost with it anyway
+            pid = -1;
+        }
+        else
+        {
+            struct launch l = {path, stages[s].args, prev_read, pipefd[1], -1, stages[s].redirects, job_pgid(job), &mask, command_environ(arena, &stages[s])};
+            pid = path ? launch_command(&l) : -1;
+            if (path == NULL)
+            {
+                fprintf(stderr, "%s: command not found\n", stages[s].args[0]);
+            }
+            else if (pid == -1)
+            {
+                fprintf(stderr, "%s: %s\n", stages[s].args[0], strerror(errno));
+            }
+        }
+        if (pid == LAUNCH_REDIRECT_FAILED)
+        {
+            job_add_failed(job, s, 1);
+        }
+        else
+        {
+            if (pid != -1)
+            {
+                trace_end(TRACE_SPAWN, start, stages[s].argc > 0 ? stages[s].args[0] : NULL);
             }
-            dup2(out, STDOUT_FILENO);
-            close(out);
+            job_add_process(job, s, pid);
         }
 
-        // execute command
-        execvp(args[0], args);
+        if (prev_read != -1)
+        {
+            close(prev_read);
+        }
+        if (pipefd[1] != -1)
+        {
+            close(pipefd[1]);
+        }
+        prev_read = next_read;
+    }
+    // the children have their own copies
+    release_redirects(stages, count);
 
-        // exit child process
-        perror("execvp() error");
-        exit(EXIT_FAILURE);
+    // check if command should be run in the background
+    if (background)
+    {
+        job_background(job, false);
+        return 0;
+    }
+
+    if (relay)
+    {
+        // the pipeline gets the terminal while the shell moves its data
+        job_give_terminal(job);
+        relay_pipeline(junctions, count - 1);
     }
-    else if (pid > 0)
+
+    // the exit status of a pipeline is the one of its last stage
+    start = trace_now();
+    int exit_status = job_foreground(job, false);
+    trace_end(TRACE_WAIT, start, pipeline->text);
+    if (exit_status == 128 + SIGINT)
     {
+        ctrlCPressed = 1;
+    }
 
-        // check if command should be run in the background
-        if (background)
+    if (relay)
+    {
+        for (int s = 0; s < count - 1; s++)
         {
-            printf("Process running in background\n");
-            return;
+            if (junctions[s].tap != -1)
+            {
+                close(junctions[s].tap);
+            }
         }
+    }
 
-        int status;
-        waitpid(pid, &status, 0);
-        // calculate time taken in milliseconds
-        clock_gettime(CLOCK_MONOTONIC, &end);
-        double time_taken = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
-
-        // print time taken with color
-        printf(BOLD YELLOW "Time taken: %f ms\n" RESET, time_taken);
+    if (!interactive)
+    {
+        return exit_status;
+    }
 
-        // check if command executed successfully
-        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
-        {
-            printf(BOLD GREEN "Command executed successfully\n" RESET);
-        }
-        else
+    if (relay)
+    {
+        for (int s = 0; s < count - 1; s++)
         {
-            printf(BOLD RED "Command execution failed\n" RESET);
+            printf(BOLD YELLOW "Relayed %lld bytes from stage %d to %d\n" RESET, junctions[s].moved, s + 1, s + 2);
         }
     }
+
+    // check if command executed successfully
+    if (exit_status == 0)
+    {
+        printf(BOLD GREEN "Command executed successfully\n" RESET);
+    }
     else
     {
-        // fork failed
-        perror("fork() error");
-        exit(EXIT_FAILURE);
+        printf(BOLD RED "Command execution failed\n" RESET);
     }
+    return exit_status;
 }
 
-int main(void)
+int cd_builtin(char **args)
 {
+    const char *dir = args[1] != NULL ? args[1] : vars_get("HOME");
+    if (dir == NULL)
+    {
+        fprintf(stderr, "cd: HOME not set\n");
+        return 1;
+    }
+    char *old = strdup(prompt_cwd());
+    if (chdir(dir) != 0)
+    {
+        perror("chdir() error");
+        free(old);
+        return 1;
+    }
+    prompt_chdir(dir);
+    vars_set(vars_intern("OLDPWD", 6), old);
+    vars_set(vars_intern("PWD", 3), prompt_cwd());
+    free(old);
+    // relative listings of the completion cache name other files now
+    complete_forget_cwd();
+    return 0;
+}
 
-    // register signal handler for SIGINT (Ctrl+C)
-    signal(SIGINT, sigintHandler);
-    // register signal handler for SIGCHLD
-    signal(SIGCHLD, sigchldHandler);
+int pwd_builtin(char **args)
+{
+    current_directory();
+    return 0;
+}
 
-    while (true)
+int clear_builtin(char **args)
+{
+    if (interactive)
     {
+        clear_screen();
+    }
+    return 0;
+}
 
-        // print prompt
-        print_prompt();
+// exit [status], the shell ends once the command line is done
+int exit_builtin(char **args)
+{
+    exiting = true;
+    if (args[1] == NULL)
+    {
+        return last_status;
+    }
+    char *end;
+    long n = strtol(args[1], &end, 10);
+    if (end == args[1] || *end != '\0')
+    {
+        fprintf(stderr, "exit: %s: numeric argument required\n", args[1]);
+        return 2;
+    }
+    return n & 0xff;
+}
 
-        // read and store command
-        char command[MAX_COMMAND_LENGTH];
-        fgets(command, MAX_COMMAND_LENGTH, stdin);
+// when read_line() last got a line, parsing it is timed from there
+static uint64_t line_read_at;
 
-        // Exit if "exit" is entered
-        if (strcmp(command, "exit\n") == 0)
-        {
-            printf("Exiting shell...\n" RESET);
-            printf(BOLD CYAN "Bye!\n" RESET);
+// next line of input, after the prompt when there is a user to see it, or
+// the continuation prompt for the lines of a heredoc
+// returns NULL at the end of the input
+static char *read_line(bool continuation, size_t *len)
+{
+    uint64_t start = trace_now();
+    char *line;
+    if (!editing && !interactive)
+    {
+        line = reader_line(&input, len);
+        line_read_at = trace_end(TRACE_READ, start, NULL);
+        return line;
+    }
+    size_t prompt_len = strlen(CONTINUATION_PROMPT);
+    const char *prompt = continuation ? CONTINUATION_PROMPT : prompt_render(&prompt_len);
+    if (!continuation)
+    {
+        start = trace_end(TRACE_PROMPT, start, NULL);
+    }
+    if (editing)
+    {
+        line = editor_line(&editor, prompt, prompt_len, len);
+    }
+    else
+    {
+        // anything printf left behind goes first, then the prompt in one write
+        fflush(stdout);
+        write(STDOUT_FILENO, prompt, prompt_len);
+        line = reader_line(&input, len);
+    }
+    line_read_at = trace_end(TRACE_READ, start, NULL);
+    return line;
+}
 
-            break;
-        }
+struct heredoc_body
+{
+    char *text;
+    size_t len;
+    bool expand; // the delimiter was not quoted, variables are filled in
+};
 
-        if (strcmp(command, "clear\n") == 0)
+// read the bodies of the heredocs started in line from the lines after it,
+// adding them to bodies in the order they were written
+static void read_heredocs(struct arena *arena, const char *line, size_t line_len, struct heredoc_body **bodies, int *count)
+{
+    struct token *tokens;
+    const char *error;
+    int token_count = lex_line(arena, line, line_len, &tokens, &error);
+    for (int i = 0; i + 1 < token_count; i++)
+    {
+        if ((tokens[i].type != TOKEN_DLESS && tokens[i].type != TOKEN_DLESS_DASH) || tokens[i + 1].type != TOKEN_WORD)
         {
-            clear_screen();
             continue;
         }
+        bool strip_tabs = tokens[i].type == TOKEN_DLESS_DASH;
+        const char *delimiter = tokens[i + 1].text;
+        size_t delimiter_len = tokens[i + 1].len;
+        size_t capacity = 256, len = 0;
+        char *body = arena_alloc(arena, capacity);
+        while (true)
+        {
+            size_t next_len;
+            char *next = read_line(true, &next_len);
+            if (next == NULL)
+            {
+                fprintf(stderr, "warning: here-document ended by the end of input (wanted `%s')\n", delimiter);
+                break;
+            }
+            while (strip_tabs && next_len > 0 && next[0] == '\t')
+            {
+                next++;
+                next_len--;
+            }
+            if (next_len == delimiter_len && memcmp(next, delimiter, next_len) == 0)
+            {
+                break;
+            }
+            if (len + next_len + 1 > capacity)
+            {
+                size_t grown = 2 * (len + next_len + 1);
+                body = arena_grow(arena, body, capacity, grown);
+                capacity = grown;
+            }
+            memcpy(body + len, next, next_len);
+            len += next_len;
+            body[len++] = '\n';
+        }
+        *bodies = arena_grow(arena, *bodies, *count * sizeof(struct heredoc_body), (*count + 1) * sizeof(struct heredoc_body));
+        (*bodies)[(*count)++] = (struct heredoc_body){body, len, !tokens[i + 1].quoted};
+    }
+}
 
-        if (strcmp(command, "\n") == 0)
+// stop running the rest of a command line after exit or Ctrl+C
+static bool interrupted(void)
+{
+    return exiting || ctrlCPressed;
+}
+
+// run the tree of a command line, && and || only run their right side when
+// the left one succeeded or failed; tail says nothing runs after it in this
+// process, see execute_command()
+// returns the exit status of the last pipeline that ran
+static int execute_node(struct arena *arena, struct node *node, bool tail)
+{
+    int status;
+    switch (node->type)
+    {
+    case NODE_PIPELINE:
+        status = execute_command(arena, &node->pipeline, tail);
+        set_status(status);
+        return status;
+    case NODE_AND:
+    case NODE_OR:
+        status = execute_node(arena, node->left, false);
+        if (interrupted() || (status == 0) != (node->type == NODE_AND))
         {
-            continue;
+            return status;
+        }
+        return execute_node(arena, node->right, tail);
+    case NODE_SEQUENCE:
+        status = execute_node(arena, node->left, false);
+        if (interrupted())
+        {
+            return status;
         }
+        return execute_node(arena, node->right, tail);
+    case NODE_GROUP:
+    case NODE_SUBSHELL:
+        // the stage holding the group decided where it runs
+        return execute_node(arena, node->left, tail);
+    }
+    return 0;
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: shell [-i] [-c command | script]\n");
+    exit(2);
+}
 
-        if (strcmp(command, "ls\n") == 0)
+int main(int argc, char **argv)
+{
+    // pick the input: -c string, script file, or stdin
+    const char *command_string = NULL;
+    bool force_interactive = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "+ic:")) != -1)
+    {
+        switch (opt)
         {
-            listFiles();
-            continue;
+        case 'i':
+            force_interactive = true;
+            break;
+        case 'c':
+            command_string = optarg;
+            break;
+        default:
+            usage();
         }
+    }
 
-        if (strcmp(command, "pwd\n") == 0)
+    if (command_string != NULL)
+    {
+        reader_open_string(&input, command_string);
+        interactive = false;
+    }
+    else if (optind < argc)
+    {
+        int fd = open(argv[optind], O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
         {
-            current_directory();
-            continue;
+            perror(argv[optind]);
+            return 127;
         }
+        reader_open_fd(&input, redirect_private(fd));
+        interactive = false;
+    }
+    else
+    {
+        // commands started by the shell share stdin, so it stays open and
+        // not close-on-exec, and anything already buffered is not theirs
+        reader_open_fd(&input, STDIN_FILENO);
+        interactive = isatty(STDIN_FILENO);
+    }
+    interactive = interactive || force_interactive;
 
-        // parse command into arguments
-        char *args[MAX_COMMAND_LENGTH];
-        bool background = false;
-        parse_command(command, args, &background);
+    // variables start out as the environment; $0 is the script, or the
+    // first argument after -c, and the arguments after it are $1 to $9;
+    // without any, $0 is the shell itself and the options are not $1 on
+    extern char **environ;
+    vars_init(environ);
+    lex_variables(vars_intern);
+    status_var = vars_intern("?", 1);
+    set_status(0);
+    char number[16];
+    snprintf(number, sizeof(number), "%d", (int)getpid());
+    vars_set(vars_intern("$", 1), number);
+    char *shell_only[] = {argv[0], NULL};
+    char **params = optind < argc ? &argv[optind] : shell_only;
+    for (int i = 0; i <= 9 && params[i] != NULL; i++)
+    {
+        snprintf(number, sizeof(number), "%d", i);
+        vars_set(vars_intern(number, 1), params[i]);
+    }
 
-        // Reset Ctrl+C flag
-        ctrlCPressed = 0;
+    // without a terminal to watch, output is fully buffered: a builtin's
+    // output goes out in one write once it has finished
+    static char output_buffer[READER_BLOCK_SIZE];
+    if (!interactive)
+    {
+        setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer));
+    }
 
-        // execute command
-        execute_command(args, background);
+    // register signal handler for SIGINT (Ctrl+C), without SA_RESTART so
+    // it interrupts the wait builtin
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigintHandler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    // a closed pipe is reported through EPIPE, and taking the terminal
+    // back from a pipeline must not stop the shell
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN);
+    // process groups, the terminal and SIGCHLD
+    jobs_init(interactive);
+    // where job usage reports go
+    usage_init(interactive);
+    // and phases, when they are traced
+    trace_init();
+    if (interactive)
+    {
+        history_init();
+    }
 
-        // Check if Ctrl+C was pressed
-        if (ctrlCPressed)
-        {
-            printf(BOLD RED "Process terminated by Ctrl+C\n" RESET);
-        }
+    // posix_spawn unless forced back to fork+exec
+    const char *launch = vars_get("SHELL_LAUNCH");
+    if (launch != NULL && strcmp(launch, "fork") == 0)
+    {
+        launch_mode = LAUNCH_FORK;
     }
 
-    return 0;
-}
+    // everything one command line needs, released in one go after it ran
+    struct arena arena = ARENA_INIT;
 
-// implementation of ls command
-void listFiles()
-{
-    // open current directory
-    DIR *dir = opendir(".");
+    // a terminal on both ends gets the line editor, which reports jobs as
+    // they change while a line is being typed
+    editing = interactive && isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+    if (editing)
+    {
+        editor_init(&editor, STDIN_FILENO, STDOUT_FILENO);
+        editor_watch(&editor, jobs_fd(), jobs_notify);
+        editor_complete(&editor, complete_line);
+        complete_prefetch();
+    }
+    if (interactive)
+    {
+        prompt_init();
+        print_banner();
+    }
 
-    // read directory
-    struct dirent *entry;
-    printf("%-10s %-10s %-10s %-10s %-20s %-20s %-20s\n", "Permissions", "User", "Group", "Size", "Modified", "Accessed", "File Name");
-    while ((entry = readdir(dir)) != NULL)
+    while (true)
     {
-        // skip hidden files
-        if (entry->d_name[0] == '.')
+        arena_reset(&arena);
+
+        // report background jobs that finished or stopped
+        jobs_notify();
+
+        // print prompt and read command
+        size_t length;
+        char *command = read_line(false, &length);
+
+        // history expansion and recording, for people only
+        if (command != NULL && interactive)
+        {
+            int expanded = history_expand(&arena, &command, &length);
+            if (expanded == -1)
+            {
+                set_status(1);
+                continue;
+            }
+            if (expanded == 1)
+            {
+                printf("%s\n", command);
+            }
+            history_add(command, length);
+        }
+
+        // the input ended
+        if (command == NULL)
+        {
+            break;
+        }
+
+        if (length == 0 || command[0] == '#')
         {
             continue;
         }
 
-        struct stat file_stat;
-        char access_time[20], modification_time[20], change_time[20];
-
-        // get file details
-        stat(entry->d_name, &file_stat);
-        strftime(access_time, sizeof(access_time), "%b %d %Y %H:%M:%S", localtime(&file_stat.st_atime));
-        strftime(modification_time, sizeof(modification_time), "%b %d %Y %H:%M:%S", localtime(&file_stat.st_mtime));
-        strftime(change_time, sizeof(change_time), "%b %d %Y %H:%M:%S", localtime(&file_stat.st_ctime));
-
-        // get file permissions
-        char permissions[11];
-        permissions[0] = (S_ISDIR(file_stat.st_mode)) ? 'd' : '-';
-        permissions[1] = (file_stat.st_mode & S_IRUSR) ? 'r' : '-';
-        permissions[2] = (file_stat.st_mode & S_IWUSR) ? 'w' : '-';
-        permissions[3] = (file_stat.st_mode & S_IXUSR) ? 'x' : '-';
-        permissions[4] = (file_stat.st_mode & S_IRGRP) ? 'r' : '-';
-        permissions[5] = (file_stat.st_mode & S_IWGRP) ? 'w' : '-';
-        permissions[6] = (file_stat.st_mode & S_IXGRP) ? 'x' : '-';
-        permissions[7] = (file_stat.st_mode & S_IROTH) ? 'r' : '-';
-        permissions[8] = (file_stat.st_mode & S_IWOTH) ? 'w' : '-';
-        permissions[9] = (file_stat.st_mode & S_IXOTH) ? 'x' : '-';
-        permissions[10] = '\0';
-
-        // get file extension
-        char *extension = strrchr(entry->d_name, '.');
-        char *color_code = "";
-        if (extension != NULL)
-        {
-            if (strcmp(extension, ".c") == 0 || strcmp(extension, ".cpp") == 0 || strcmp(extension, ".java") == 0 || strcmp(extension, ".py") == 0 || strcmp(extension, ".js") == 0 || strcmp(extension, ".php") == 0 || strcmp(extension, ".html") == 0 || strcmp(extension, ".css") == 0 || strcmp(extension, ".sh") == 0)
+        // parse command into a tree, a command that is not finished at the
+        // end of its line takes the next lines too; heredoc bodies are read
+        // right after the line their operator is on
+        struct node *tree;
+        struct redirect *heredocs;
+        struct heredoc_body *bodies = NULL;
+        int body_count = 0;
+        const char *line = command;
+        size_t line_len = length;
+        bool copied = false;
+        int parsed;
+        while (true)
+        {
+            if (memmem(line, line_len, "<<", 2) != NULL)
+            {
+                // the lines read next would overwrite the command in its buffer
+                if (!copied)
+                {
+                    command = arena_strndup(&arena, command, length);
+                    copied = true;
+                }
+                read_heredocs(&arena, line, line_len, &bodies, &body_count);
+            }
+            parsed = parse_command(&arena, command, length, &tree, &heredocs);
+            trace_end(TRACE_PARSE, line_read_at, command);
+            if (parsed != PARSE_INCOMPLETE)
+            {
+                break;
+            }
+            if (!copied)
             {
-                color_code = "\033[0;32m"; // green
+                command = arena_strndup(&arena, command, length);
+                copied = true;
             }
-            else if (strcmp(extension, ".h") == 0 || strcmp(extension, ".txt") == 0 || strcmp(extension, ".md") == 0 || strcmp(extension, ".json") == 0 || strcmp(extension, ".audio") == 0 || strcmp(extension, ".video") == 0)
+            line = read_line(true, &line_len);
+            if (line == NULL)
             {
-                color_code = "\033[0;34m"; // blue
+                fprintf(stderr, "Syntax error: unexpected end of input\n");
+                parsed = -1;
+                break;
+            }
+            char *joined = arena_alloc(&arena, length + line_len + 2);
+            memcpy(joined, command, length);
+            joined[length] = '\n';
+            memcpy(joined + length + 1, line, line_len);
+            length += line_len + 1;
+            joined[length] = '\0';
+            command = joined;
+        }
+        if (parsed == -1)
+        {
+            set_status(2);
+            continue;
+        }
+        if (tree == NULL)
+        {
+            continue;
+        }
+        int b = 0;
+        for (struct redirect *r = heredocs; r != NULL && b < body_count; r = r->next_heredoc, b++)
+        {
+            r->target = bodies[b].text;
+            r->target_len = bodies[b].len;
+            if (bodies[b].expand)
+            {
+                // scanned once, the values are filled in each time it runs
+                struct token body;
+                lex_heredoc(&arena, bodies[b].text, bodies[b].len, &body);
+                r->target = body.text;
+                r->target_len = body.len;
+                if (body.expansions != NULL)
+                {
+                    struct word *w = arena_alloc(&arena, sizeof(struct word));
+                    *w = (struct word){body.text, body.expansions, NULL, true};
+                    r->word = w;
+                }
             }
-            // Add more file extensions and color codes as needed
         }
 
-        // print file details in tabular format
-        printf("%-10s %-10d %-10d %-10ld %-20s %-20s %s%s%s\n", permissions, file_stat.st_uid, file_stat.st_gid, file_stat.st_size, modification_time, access_time, color_code, entry->d_name, "\033[0m");
+        // Reset Ctrl+C flag
+        ctrlCPressed = 0;
+
+        // execute command
+        if (interactive)
+        {
+            printf("\n\n");
+            printf(BOLD CYAN "Command " RESET "%s\n\n", command);
+        }
+        execute_node(&arena, tree, false);
+
+        // Check if Ctrl+C was pressed
+        if (ctrlCPressed && interactive)
+        {
+            printf(BOLD RED "Process terminated by Ctrl+C\n" RESET);
+        }
+        if (exiting)
+        {
+            break;
+        }
     }
 
-    // close directory
-    closedir(dir);
+    if (interactive)
+    {
+        printf("Exiting shell...\n" RESET);
+        printf(BOLD CYAN "Bye!\n" RESET);
+    }
+
+    arena_free(&arena);
+    reader_close(&input);
+    fflush(stdout);
+    return last_status;
 }
 
 void current_directory()
 {
-    char cwd[1024];
-    if (getcwd(cwd, sizeof(cwd)) == NULL)
-    {
-        perror("getcwd() error");
-        return;
-    }
-    printf("Current Directory: %s\n", cwd);
+    printf("Current Directory: %s\n", prompt_cwd());
 }
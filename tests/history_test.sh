@@ -0,0 +1,35 @@
+#!/bin/bash
+# Tests for history expansion
+# Feeds lines to an interactive shell with an empty history file and checks
+# the lines it recorded, which are the lines after expansion.
+#
+# usage: tests/history_test.sh [shell]
+
+SHELL_BIN=$(realpath -m "${1:-./build/release/shell}")
+FILE=$(mktemp)
+trap 'rm -f "$FILE"' EXIT
+FAILED=0
+
+# check <name> <input lines> <expected history>
+check() {
+    local name=$1 input=$2 expected=$3 got
+    : > "$FILE"
+    got=$(printf '%s\nhistory\nexit\n' "$input" | SHELL_HISTFILE=$FILE "$SHELL_BIN" -i 2> /dev/null |
+        awk '$1 ~ /^[0-9]+$/ && $2 != "history" { $1 = ""; sub(/^ +/, ""); print }')
+    if [ "$got" = "$expected" ]; then
+        echo "ok      $name"
+    else
+        echo "FAILED  $name"
+        printf '  expected:\n%s\n  got:\n%s\n' "$expected" "$got"
+        FAILED=1
+    fi
+}
+
+check "!! runs the last line" $'echo one\n!! two' $'echo one\necho one two'
+check "!prefix runs the last match" $'echo one\ntrue\n!ec' $'echo one\ntrue\necho one'
+check "!n runs line n" $'echo one\necho two\n!1' $'echo one\necho two\necho one'
+check "! before a quote stays" $'echo one\necho "hi!"' $'echo one\necho "hi!"'
+check "! before an operator stays" $'echo one\necho a!;echo b!|cat' $'echo one\necho a!;echo b!|cat'
+check "! in single quotes stays" $'echo one\necho \'!!\'' $'echo one\necho \'!!\''
+
+exit $FAILED
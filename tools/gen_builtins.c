@@ -0,0 +1,88 @@
+// Generator of the builtin table
+// Looks for a seed for builtin_hash under which every name in builtins.def
+// lands in a slot of its own, with twice as many slots as builtins, more
+// when no seed is found, and writes the slots as a C header.
+//
+// build: gcc -O2 -I. tools/gen_builtins.c -o bin/gen_builtins
+// usage: bin/gen_builtins > builtins_table.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "builtins.h"
+
+#define MAX_SEEDS 1000000 // tried per table size
+
+static const char *names[] = {
+#define BUILTIN(name, run, flags) name,
+#include "builtins.def"
+#undef BUILTIN
+};
+
+#define COUNT (sizeof(names) / sizeof(names[0]))
+
+// the table holds indexes as signed chars
+_Static_assert(COUNT < 128, "too many builtins for builtin_slots");
+
+// slot of each name under seed, false when two share one
+static bool place(uint32_t seed, uint32_t slots, int *table)
+{
+    for (uint32_t i = 0; i < slots; i++)
+    {
+        table[i] = -1;
+    }
+    for (size_t i = 0; i < COUNT; i++)
+    {
+        uint32_t slot = builtin_hash(names[i], seed) & (slots - 1);
+        if (table[slot] != -1)
+        {
+            return false;
+        }
+        table[slot] = i;
+    }
+    return true;
+}
+
+int main()
+{
+    uint32_t slots = 2;
+    while (slots < 2 * COUNT)
+    {
+        slots *= 2;
+    }
+    uint32_t max_slots = slots * 64;
+
+    int *table = malloc(sizeof(int) * max_slots);
+    if (table == NULL)
+    {
+        perror("malloc() error");
+        return 1;
+    }
+    for (; slots <= max_slots; slots *= 2)
+    {
+        for (uint32_t seed = 0; seed < MAX_SEEDS; seed++)
+        {
+            if (!place(seed, slots, table))
+            {
+                continue;
+            }
+
+            printf("// generated by tools/gen_builtins.c from builtins.def, do not edit\n");
+            printf("#define BUILTIN_COUNT %zu\n", COUNT);
+            printf("#define BUILTIN_SEED %uu\n", seed);
+            printf("#define BUILTIN_SLOTS %u\n\n", slots);
+            printf("// index into builtins of the name hashed to each slot, -1 for none\n");
+            printf("static const signed char builtin_slots[BUILTIN_SLOTS] = {");
+            for (uint32_t i = 0; i < slots; i++)
+            {
+                printf("%s%d", i % 16 == 0 ? "\n    " : " ", table[i]);
+                printf(i + 1 < slots ? "," : "\n");
+            }
+            printf("};\n");
+            return 0;
+        }
+    }
+    fprintf(stderr, "gen_builtins: no seed separates the names\n");
+    return 1;
+}
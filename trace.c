@@ -0,0 +1,287 @@
+// Tracing
+// Histograms are log-linear like HdrHistogram: every power of two is split
+// into 16 buckets, so a latency is kept to within about 6% from a
+// nanosecond to hours in under 8 KB per phase. Only the shell's own thread
+// records, so a count is a plain increment and nothing takes a lock, and a
+// forked copy simply carries on with its own. Trace events are formatted
+// into a buffer that goes out in single write()s on an O_APPEND
+// descriptor, so forked copies of the shell add theirs to the same file
+// without interleaving. The file is a JSON array: the shell that opened it
+// writes the opening [ and, when it exits, the closing ].
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "trace.h"
+#include "vars.h"
+#include "redirect.h"
+
+#define SUB_BITS 4
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define BUCKETS ((64 - SUB_BITS + 1) * SUB_BUCKETS)
+#define TRACE_BUFFER (64 * 1024)
+#define EVENT_MAX 1024 // room an event may take in the buffer
+#define DETAIL_MAX 256 // bytes of detail written per event
+
+struct histogram
+{
+    uint64_t counts[BUCKETS];
+    uint64_t count;
+    uint64_t sum; // nanoseconds
+    uint64_t min;
+    uint64_t max;
+};
+
+static struct histogram histograms[TRACE_PHASES];
+
+static const char *phase_names[] = {
+    [TRACE_PROMPT] = "prompt",
+    [TRACE_READ] = "read",
+    [TRACE_PARSE] = "parse",
+    [TRACE_EXPAND] = "expand",
+    [TRACE_BUILTIN] = "builtin",
+    [TRACE_SPAWN] = "spawn",
+    [TRACE_WAIT] = "wait",
+    [TRACE_REAP] = "reap",
+};
+
+static int trace_fd = -1;
+static pid_t trace_pid;
+static pid_t owner; // the shell that opened the file closes the array
+static char buffer[TRACE_BUFFER];
+static size_t buffer_len;
+
+// values below 16 get a bucket each, above that 16 per power of two
+static int bucket_of(uint64_t v)
+{
+    if (v < SUB_BUCKETS)
+    {
+        return (int)v;
+    }
+    int shift = 63 - __builtin_clzll(v) - SUB_BITS;
+    return (shift + 1) * SUB_BUCKETS + (int)((v >> shift) - SUB_BUCKETS);
+}
+
+// the middle of the values that fall in bucket i
+static uint64_t bucket_middle(int i)
+{
+    if (i < SUB_BUCKETS)
+    {
+        return i;
+    }
+    int shift = i / SUB_BUCKETS - 1;
+    return ((uint64_t)(SUB_BUCKETS + i % SUB_BUCKETS) << shift) + ((1ull << shift) >> 1);
+}
+
+static void record(struct histogram *h, uint64_t ns)
+{
+    h->counts[bucket_of(ns)]++;
+    h->sum += ns;
+    h->min = h->count == 0 || ns < h->min ? ns : h->min;
+    h->max = ns > h->max ? ns : h->max;
+    h->count++;
+}
+
+static void write_buffer(void)
+{
+    if (buffer_len > 0 && write(trace_fd, buffer, buffer_len) != (ssize_t)buffer_len)
+    {
+        perror("write() trace error");
+    }
+    buffer_len = 0;
+}
+
+void trace_flush(void)
+{
+    if (trace_fd != -1)
+    {
+        write_buffer();
+    }
+}
+
+// the process that opened the file ends the array
+static void trace_close(void)
+{
+    if (trace_fd == -1)
+    {
+        return;
+    }
+    if (getpid() == owner)
+    {
+        buffer_len += snprintf(buffer + buffer_len, sizeof(buffer) - buffer_len, "\n]\n");
+    }
+    write_buffer();
+}
+
+void trace_init(void)
+{
+    const char *path = vars_get("SHELL_TRACE");
+    if (path == NULL || path[0] == '\0')
+    {
+        return;
+    }
+    trace_fd = open(path, O_WRONLY | O_APPEND | O_TRUNC | O_CREAT | O_CLOEXEC, 0644);
+    if (trace_fd == -1)
+    {
+        perror("open() trace error");
+        return;
+    }
+    trace_fd = redirect_private(trace_fd);
+    owner = trace_pid = getpid();
+    // written now, forked copies may add events before this shell does
+    buffer_len = snprintf(buffer, sizeof(buffer), "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"shell\"}}", (int)owner);
+    write_buffer();
+    atexit(trace_close);
+}
+
+void trace_child(void)
+{
+    buffer_len = 0;
+    trace_pid = getpid();
+    // its descriptors were closed, the file is opened again without
+    // truncating it
+    const char *path = vars_get("SHELL_TRACE");
+    if (trace_fd != -1 && path != NULL)
+    {
+        trace_fd = redirect_private(open(path, O_WRONLY | O_APPEND | O_CLOEXEC));
+    }
+}
+
+// s as a JSON string literal of at most DETAIL_MAX bytes
+static size_t json_string(char *out, const char *s)
+{
+    size_t n = 0;
+    out[n++] = '"';
+    for (const char *start = s; *s != '\0' && s - start < DETAIL_MAX; s++)
+    {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+        {
+            out[n++] = '\\';
+            out[n++] = c;
+        }
+        else if (c < 0x20)
+        {
+            n += sprintf(out + n, "\\u%04x", c);
+        }
+        else
+        {
+            out[n++] = c;
+        }
+    }
+    out[n++] = '"';
+    return n;
+}
+
+// a complete event: name, start and duration in microseconds
+static void write_event(enum trace_phase phase, uint64_t start, uint64_t ns, const char *detail)
+{
+    if (buffer_len + EVENT_MAX + DETAIL_MAX * 6 > sizeof(buffer))
+    {
+        write_buffer();
+    }
+    char *out = buffer + buffer_len;
+    size_t n = sprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"shell\",\"ph\":\"X\",\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":%d,\"tid\":%d",
+                       phase_names[phase], (unsigned long long)(start / 1000), (unsigned)(start % 1000), (unsigned long long)(ns / 1000),
+                       (unsigned)(ns % 1000), (int)trace_pid, (int)trace_pid);
+    if (detail != NULL)
+    {
+        n += sprintf(out + n, ",\"args\":{\"detail\":");
+        n += json_string(out + n, detail);
+        out[n++] = '}';
+    }
+    out[n++] = '}';
+    buffer_len += n;
+}
+
+uint64_t trace_end(enum trace_phase phase, uint64_t start, const char *detail)
+{
+    uint64_t end = trace_now();
+    record(&histograms[phase], end - start);
+    if (trace_fd != -1)
+    {
+        write_event(phase, start, end - start, detail);
+    }
+    return end;
+}
+
+// ns in the unit that keeps it readable
+static void print_time(uint64_t ns)
+{
+    if (ns < 1000)
+    {
+        printf(" %7lluns", (unsigned long long)ns);
+    }
+    else if (ns < 1000000)
+    {
+        printf(" %7.1fus", ns / 1e3);
+    }
+    else if (ns < 1000000000)
+    {
+        printf(" %7.1fms", ns / 1e6);
+    }
+    else
+    {
+        printf(" %8.2fs", ns / 1e9);
+    }
+}
+
+// the value at or below which the fraction q of them fall, as the middle
+// of its bucket kept within the smallest and largest seen
+static uint64_t quantile(const struct histogram *h, uint64_t count, double q)
+{
+    uint64_t rank = (uint64_t)(q * count + 0.5);
+    rank = rank ? rank : 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++)
+    {
+        seen += h->counts[i];
+        if (seen >= rank)
+        {
+            uint64_t middle = bucket_middle(i);
+            middle = middle > h->min ? middle : h->min;
+            return middle < h->max ? middle : h->max;
+        }
+    }
+    return h->max;
+}
+
+int stats_builtin(char **args)
+{
+    if (args[1] != NULL && strcmp(args[1], "-r") == 0)
+    {
+        memset(histograms, 0, sizeof(histograms));
+        return 0;
+    }
+    if (args[1] != NULL)
+    {
+        fprintf(stderr, "stats: usage: stats [-r]\n");
+        return 2;
+    }
+
+    printf("%-8s %8s %9s %9s %9s %9s %9s %9s %9s\n", "phase", "count", "min", "mean", "p50", "p90", "p99", "p99.9", "max");
+    for (int p = 0; p < TRACE_PHASES; p++)
+    {
+        const struct histogram *h = &histograms[p];
+        uint64_t count = h->count;
+        printf("%-8s %8llu", phase_names[p], (unsigned long long)count);
+        if (count == 0)
+        {
+            printf("\n");
+            continue;
+        }
+        print_time(h->min);
+        print_time(h->sum / count);
+        print_time(quantile(h, count, 0.5));
+        print_time(quantile(h, count, 0.9));
+        print_time(quantile(h, count, 0.99));
+        print_time(quantile(h, count, 0.999));
+        print_time(h->max);
+        printf("\n");
+    }
+    return 0;
+}
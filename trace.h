@@ -0,0 +1,53 @@
+// Tracing
+// Each phase of running a command line is timed on the monotonic clock and
+// its latency counted in a histogram, which the stats builtin prints. When
+// $SHELL_TRACE names a file, every phase is also written to it as a Chrome
+// trace event, for chrome://tracing or Perfetto.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <time.h>
+
+enum trace_phase
+{
+    TRACE_PROMPT,  // rendering the prompt
+    TRACE_READ,    // reading a line, the typing included
+    TRACE_PARSE,   // lexing and parsing it
+    TRACE_EXPAND,  // variables and wildcards of a pipeline
+    TRACE_BUILTIN, // a builtin run by the shell itself
+    TRACE_SPAWN,   // starting a process, up to its exec under posix_spawn
+    TRACE_WAIT,    // a foreground job, from its last launch until it ends
+    TRACE_REAP,    // collecting children that changed state
+    TRACE_PHASES,
+};
+
+// nanoseconds on the monotonic clock
+static inline uint64_t trace_now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// open the trace file named by $SHELL_TRACE
+void trace_init(void);
+
+// a phase that started at start has ended; detail says what it worked on,
+// for the trace file, or is NULL
+// returns the time it ended, where a phase right after it starts
+uint64_t trace_end(enum trace_phase phase, uint64_t start, const char *detail);
+
+// in a forked copy of the shell, once its descriptors are closed: events
+// the parent has not written yet are its own, and new ones carry the
+// copy's pid
+void trace_child(void);
+
+// write out the events kept so far, before the process exits or execs
+void trace_flush(void);
+
+// stats [-r]: latency of every phase, -r starts over
+int stats_builtin(char **args);
+
+#endif
@@ -0,0 +1,142 @@
+// Resource accounting
+// A JSON record is formatted into one buffer and written with a single
+// write() on an O_APPEND descriptor, so shells sharing a log never
+// interleave their lines.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include "usage.h"
+#include "vars.h"
+#include "redirect.h"
+
+#define BOLD_YELLOW "\x1B[1m\x1B[33m"
+#define RESET "\x1B[0m"
+
+static int log_fd = -1;
+static bool report_terminal;
+
+void usage_init(bool interactive)
+{
+    report_terminal = interactive;
+    const char *path = vars_get("SHELL_RUSAGE_LOG");
+    if (path == NULL || path[0] == '\0')
+    {
+        return;
+    }
+    log_fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (log_fd == -1)
+    {
+        perror("open() rusage log error");
+        return;
+    }
+    log_fd = redirect_private(log_fd);
+}
+
+static void add_time(struct timeval *sum, const struct timeval *t)
+{
+    sum->tv_sec += t->tv_sec;
+    sum->tv_usec += t->tv_usec;
+    if (sum->tv_usec >= 1000000)
+    {
+        sum->tv_sec++;
+        sum->tv_usec -= 1000000;
+    }
+}
+
+void usage_add(struct job_usage *u, const struct rusage *r)
+{
+    add_time(&u->utime, &r->ru_utime);
+    add_time(&u->stime, &r->ru_stime);
+    if (r->ru_maxrss > u->maxrss)
+    {
+        u->maxrss = r->ru_maxrss;
+    }
+    u->minflt += r->ru_minflt;
+    u->majflt += r->ru_majflt;
+    u->nvcsw += r->ru_nvcsw;
+    u->nivcsw += r->ru_nivcsw;
+}
+
+static double ms(const struct timeval *t)
+{
+    return t->tv_sec * 1000.0 + t->tv_usec / 1000.0;
+}
+
+// copy s as a JSON string literal, truncated to fit
+static size_t json_string(char *out, size_t size, const char *s)
+{
+    size_t n = 0;
+    out[n++] = '"';
+    for (; *s != '\0' && n + 8 < size; s++)
+    {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+        {
+            out[n++] = '\\';
+            out[n++] = c;
+        }
+        else if (c < 0x20)
+        {
+            n += snprintf(out + n, size - n, "\\u%04x", c);
+        }
+        else
+        {
+            out[n++] = c;
+        }
+    }
+    out[n++] = '"';
+    return n;
+}
+
+void usage_report(const struct job_usage *u, const char *command, int id, bool background, int status)
+{
+    if (log_fd != -1)
+    {
+        char line[8192];
+        size_t n = snprintf(line, sizeof(line), "{\"command\":");
+        n += json_string(line + n, sizeof(line) - n - 512, command);
+        n += snprintf(line + n, sizeof(line) - n,
+                      ",\"job\":%d,\"background\":%s,\"status\":%d,\"start\":%ld.%09ld,\"wall_ms\":%.3f,\"user_ms\":%.3f,\"sys_ms\":%.3f,"
+                      "\"max_rss_kb\":%ld,\"minor_faults\":%ld,\"major_faults\":%ld,\"voluntary_switches\":%ld,\"involuntary_switches\":%ld}\n",
+                      id, background ? "true" : "false", status, (long)u->start.tv_sec, u->start.tv_nsec, u->wall_ms, ms(&u->utime), ms(&u->stime),
+                      u->maxrss, u->minflt, u->majflt, u->nvcsw, u->nivcsw);
+        if (write(log_fd, line, n) != (ssize_t)n)
+        {
+            perror("write() rusage log error");
+        }
+        return;
+    }
+
+    if (!report_terminal)
+    {
+        return;
+    }
+    if (background)
+    {
+        printf(BOLD_YELLOW "[%d] %s\n" RESET, id, command);
+    }
+    printf(BOLD_YELLOW "Time taken: %f ms\n" RESET, u->wall_ms);
+    printf(BOLD_YELLOW "CPU: user %.3f ms, sys %.3f ms; max RSS %ld KB; page faults %ld minor, %ld major; context switches %ld voluntary, %ld involuntary\n" RESET,
+           ms(&u->utime), ms(&u->stime), u->maxrss, u->minflt, u->majflt, u->nvcsw, u->nivcsw);
+}
+
+static void print_times(const struct timeval *user, const struct timeval *sys)
+{
+    printf("%ldm%ld.%03lds %ldm%ld.%03lds\n", (long)user->tv_sec / 60, (long)user->tv_sec % 60, (long)user->tv_usec / 1000,
+           (long)sys->tv_sec / 60, (long)sys->tv_sec % 60, (long)sys->tv_usec / 1000);
+}
+
+int times_builtin(char **args)
+{
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    print_times(&self.ru_utime, &self.ru_stime);
+    print_times(&children.ru_utime, &children.ru_stime);
+    return 0;
+}
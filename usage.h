@@ -0,0 +1,39 @@
+// Resource accounting
+// Jobs add up the rusage wait4() returns for each of their processes. When a
+// job finishes its usage is reported, as a line on the terminal or as a JSON
+// record appended to the file named by $SHELL_RUSAGE_LOG.
+
+#ifndef USAGE_H
+#define USAGE_H
+
+#include <stdbool.h>
+#include <time.h>
+#include <sys/resource.h>
+
+struct job_usage
+{
+    struct timespec start;      // wall clock when the job was created, before any launch
+    struct timespec start_mono; // the same moment on the monotonic clock
+    double wall_ms;
+    struct timeval utime;
+    struct timeval stime;
+    long maxrss; // kilobytes, the largest of the processes
+    long minflt;
+    long majflt;
+    long nvcsw;
+    long nivcsw;
+};
+
+// log file from $SHELL_RUSAGE_LOG, terminal reports only when interactive
+void usage_init(bool interactive);
+
+// add the usage of one finished process
+void usage_add(struct job_usage *u, const struct rusage *r);
+
+// report a finished job
+void usage_report(const struct job_usage *u, const char *command, int id, bool background, int status);
+
+// times: user and system time of the shell, then of its children
+int times_builtin(char **args);
+
+#endif
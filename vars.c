@@ -0,0 +1,482 @@
+// Shell variables
+// A variable keeps its value in one "NAME=value" string, which is also its
+// entry in the environment, so exporting copies nothing. The cached
+// environment points at those strings: a new value that fits is written in
+// place and the array stays valid; it is only rebuilt when an exported
+// variable is added, removed, or its string had to move. A command's own
+// NAME=value settings are patched into a copy of the array of pointers.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "vars.h"
+#include "glob.h"
+
+#define INITIAL_CAPACITY 128
+
+struct var
+{
+    char *name;
+    size_t name_len;
+    uint32_t hash;
+    char *entry;       // "NAME=value", kept while unset to be reused
+    size_t entry_size; // bytes allocated for entry
+    bool set;
+    bool exported;
+    int env_index; // position in the cached environment, -1 when not in it
+};
+
+static struct var **table;
+static size_t capacity;
+
+// every variable in the order it was created, the order of the environment
+static struct var **order;
+static size_t var_count;
+
+static char **environment;
+static size_t environment_count;
+static bool environment_stale = true;
+
+// FNV-1a
+static uint32_t hash_name(const char *name, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return h;
+}
+
+// slot holding name, or the empty slot where it belongs
+static struct var **find_slot(struct var **slots, size_t size, const char *name, size_t len, uint32_t hash)
+{
+    size_t i = hash & (size - 1);
+    while (slots[i] != NULL && (slots[i]->hash != hash || slots[i]->name_len != len || memcmp(slots[i]->name, name, len) != 0))
+    {
+        i = (i + 1) & (size - 1);
+    }
+    return &slots[i];
+}
+
+static struct var *find(const char *name, size_t len)
+{
+    return capacity != 0 ? *find_slot(table, capacity, name, len, hash_name(name, len)) : NULL;
+}
+
+static void *xrealloc(void *p, size_t size)
+{
+    p = realloc(p, size);
+    if (p == NULL)
+    {
+        perror("malloc() error");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+struct var *vars_intern(const char *name, size_t len)
+{
+    uint32_t hash = hash_name(name, len);
+    if (capacity != 0)
+    {
+        struct var *v = *find_slot(table, capacity, name, len, hash);
+        if (v != NULL)
+        {
+            return v;
+        }
+    }
+
+    if ((var_count + 1) * 2 > capacity)
+    {
+        size_t new_capacity = capacity ? capacity * 2 : INITIAL_CAPACITY;
+        struct var **new_table = calloc(new_capacity, sizeof(struct var *));
+        if (new_table == NULL)
+        {
+            perror("malloc() error");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < var_count; i++)
+        {
+            *find_slot(new_table, new_capacity, order[i]->name, order[i]->name_len, order[i]->hash) = order[i];
+        }
+        free(table);
+        table = new_table;
+        capacity = new_capacity;
+        order = xrealloc(order, capacity / 2 * sizeof(struct var *));
+    }
+
+    struct var *v = calloc(1, sizeof(struct var));
+    if (v == NULL || (v->name = strndup(name, len)) == NULL)
+    {
+        perror("malloc() error");
+        exit(EXIT_FAILURE);
+    }
+    v->name_len = len;
+    v->hash = hash;
+    v->env_index = -1;
+    *find_slot(table, capacity, name, len, hash) = v;
+    order[var_count++] = v;
+    return v;
+}
+
+const char *var_value(const struct var *v)
+{
+    return v->set ? v->entry + v->name_len + 1 : NULL;
+}
+
+const char *vars_get(const char *name)
+{
+    const struct var *v = find(name, strlen(name));
+    return v != NULL ? var_value(v) : NULL;
+}
+
+void vars_set(struct var *v, const char *value)
+{
+    size_t value_len = strlen(value);
+    size_t size = v->name_len + value_len + 2;
+    if (size > v->entry_size)
+    {
+        // value may point into the old string, so it goes last
+        size_t grown = size < 32 ? 32 : size + size / 2;
+        char *entry = xrealloc(NULL, grown);
+        memcpy(entry, v->name, v->name_len);
+        entry[v->name_len] = '=';
+        memcpy(entry + v->name_len + 1, value, value_len + 1);
+        free(v->entry);
+        v->entry = entry;
+        v->entry_size = grown;
+        environment_stale |= v->exported;
+    }
+    else
+    {
+        memmove(v->entry + v->name_len + 1, value, value_len + 1);
+    }
+    environment_stale |= v->exported && !v->set;
+    v->set = true;
+}
+
+void vars_unset(struct var *v)
+{
+    environment_stale |= v->exported && v->set;
+    v->set = false;
+    v->exported = false;
+}
+
+void vars_export(struct var *v)
+{
+    environment_stale |= !v->exported && v->set;
+    v->exported = true;
+}
+
+void vars_init(char **envp)
+{
+    for (char **e = envp; *e != NULL; e++)
+    {
+        const char *eq = strchr(*e, '=');
+        if (eq == NULL || eq == *e)
+        {
+            continue;
+        }
+        struct var *v = vars_intern(*e, eq - *e);
+        vars_set(v, eq + 1);
+        vars_export(v);
+    }
+}
+
+char **vars_environ(void)
+{
+    if (!environment_stale)
+    {
+        return environment;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < var_count; i++)
+    {
+        count += order[i]->set && order[i]->exported;
+    }
+    environment = xrealloc(environment, (count + 1) * sizeof(char *));
+    environment_count = 0;
+    for (size_t i = 0; i < var_count; i++)
+    {
+        struct var *v = order[i];
+        v->env_index = v->set && v->exported ? (int)environment_count : -1;
+        if (v->env_index != -1)
+        {
+            environment[environment_count++] = v->entry;
+        }
+    }
+    environment[environment_count] = NULL;
+    environment_stale = false;
+    return environment;
+}
+
+char **vars_environ_with(struct arena *arena, char **entries, int count)
+{
+    char **base = vars_environ();
+    char **env = arena_alloc(arena, (environment_count + count + 1) * sizeof(char *));
+    memcpy(env, base, environment_count * sizeof(char *));
+    size_t n = environment_count;
+    for (int i = 0; i < count; i++)
+    {
+        size_t len = strchr(entries[i], '=') - entries[i];
+        const struct var *v = find(entries[i], len);
+        if (v != NULL && v->env_index != -1)
+        {
+            env[v->env_index] = entries[i];
+            continue;
+        }
+        // a name given twice keeps the last value
+        size_t k = environment_count;
+        while (k < n && strncmp(env[k], entries[i], len + 1) != 0)
+        {
+            k++;
+        }
+        env[k] = entries[i];
+        n += k == n;
+    }
+    env[n] = NULL;
+    return env;
+}
+
+// fields of a command line being put together in the arena
+struct fields
+{
+    struct arglist list;
+    char *buf; // the field being built
+    size_t len;
+    size_t size;
+    bool started; // the field exists even if it is still empty
+    bool pattern; // the word has wildcards, its fields are matched against files
+};
+
+static void append(struct fields *f, const char *s, size_t len)
+{
+    if (f->len + len + 1 > f->size)
+    {
+        size_t grown = 2 * (f->len + len + 1);
+        f->buf = arena_grow(f->list.arena, f->buf, f->size, grown);
+        f->size = grown;
+    }
+    memcpy(f->buf + f->len, s, len);
+    f->len += len;
+    f->buf[f->len] = '\0';
+}
+
+// a variable's value; in a pattern a quoted one only matches itself, and
+// in one that is not quoted the wildcards work
+static void append_value(struct fields *f, const char *s, size_t len, bool quoted)
+{
+    if (!f->pattern)
+    {
+        append(f, s, len);
+        return;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        if (s[i] == '\\' || (quoted && strchr("*?[]!^-", s[i]) != NULL))
+        {
+            append(f, "\\", 1);
+        }
+        append(f, &s[i], 1);
+    }
+}
+
+static void end_field(struct fields *f)
+{
+    if (!f->started)
+    {
+        return;
+    }
+    if (f->pattern && f->len > 0)
+    {
+        glob_expand(&f->list, f->buf);
+    }
+    else
+    {
+        arglist_push(&f->list, arena_strndup(f->list.arena, f->buf, f->len));
+    }
+    f->len = 0;
+    f->started = false;
+}
+
+// a word with wildcards is put together from its pattern, where the
+// characters that were quoted are escaped
+static void expand_into(struct fields *f, const struct word *w, bool split)
+{
+    f->pattern = split && w->pattern != NULL;
+    const char *text = f->pattern ? w->pattern : w->text;
+    size_t pos = 0;
+    f->started = f->started || w->quoted;
+    for (const struct expansion *e = w->expansions; e != NULL; e = e->next)
+    {
+        size_t offset = f->pattern ? e->pattern_offset : e->offset;
+        if (offset > pos)
+        {
+            append(f, text + pos, offset - pos);
+            f->started = true;
+        }
+        pos = offset;
+
+        const char *value = var_value(e->var);
+        value = value != NULL ? value : "";
+        if (!split || e->quoted)
+        {
+            append_value(f, value, strlen(value), true);
+            continue;
+        }
+        // outside quotes blanks separate fields
+        while (*value != '\0')
+        {
+            size_t run = strcspn(value, " \t\n");
+            if (run == 0)
+            {
+                end_field(f);
+                value++;
+                continue;
+            }
+            append_value(f, value, run, false);
+            f->started = true;
+            value += run;
+        }
+    }
+    size_t rest = strlen(text + pos);
+    if (rest > 0)
+    {
+        append(f, text + pos, rest);
+        f->started = true;
+    }
+}
+
+int vars_expand(struct arena *arena, const struct word *words, int count, char ***args)
+{
+    struct fields f = {{arena, NULL, 0, 0}, NULL, 0, 0, false, false};
+    for (int i = 0; i < count; i++)
+    {
+        expand_into(&f, &words[i], true);
+        end_field(&f);
+    }
+    if (f.list.args == NULL)
+    {
+        f.list.args = arena_alloc(arena, sizeof(char *));
+    }
+    f.list.args[f.list.count] = NULL;
+    *args = f.list.args;
+    return f.list.count;
+}
+
+char *vars_expand_word(struct arena *arena, const struct word *w)
+{
+    struct fields f = {{arena, NULL, 0, 0}, NULL, 0, 0, false, false};
+    append(&f, "", 0);
+    expand_into(&f, w, false);
+    return f.buf;
+}
+
+static bool valid_name(const char *s, size_t len)
+{
+    if (len == 0 || (s[0] >= '0' && s[0] <= '9'))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        char c = s[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// export NAME="value", quoted so it can be read back in
+static void print_export(const struct var *v)
+{
+    printf("export %s", v->name);
+    const char *value = var_value(v);
+    if (value == NULL)
+    {
+        printf("\n");
+        return;
+    }
+    printf("=\"");
+    for (; *value != '\0'; value++)
+    {
+        if (strchr("\"\\$`", *value) != NULL)
+        {
+            putchar('\\');
+        }
+        putchar(*value);
+    }
+    printf("\"\n");
+}
+
+int export_builtin(char **args)
+{
+    int i = 1;
+    if (args[i] != NULL && strcmp(args[i], "-p") == 0)
+    {
+        i++;
+    }
+    if (args[i] == NULL)
+    {
+        for (size_t k = 0; k < var_count; k++)
+        {
+            if (order[k]->exported)
+            {
+                print_export(order[k]);
+            }
+        }
+        return 0;
+    }
+
+    int status = 0;
+    for (; args[i] != NULL; i++)
+    {
+        const char *eq = strchr(args[i], '=');
+        size_t len = eq != NULL ? (size_t)(eq - args[i]) : strlen(args[i]);
+        if (!valid_name(args[i], len))
+        {
+            fprintf(stderr, "export: `%s': not a valid identifier\n", args[i]);
+            status = 1;
+            continue;
+        }
+        struct var *v = vars_intern(args[i], len);
+        if (eq != NULL)
+        {
+            vars_set(v, eq + 1);
+        }
+        vars_export(v);
+    }
+    return status;
+}
+
+int unset_builtin(char **args)
+{
+    int i = 1;
+    if (args[i] != NULL && strcmp(args[i], "-v") == 0)
+    {
+        i++;
+    }
+    int status = 0;
+    for (; args[i] != NULL; i++)
+    {
+        size_t len = strlen(args[i]);
+        if (!valid_name(args[i], len))
+        {
+            fprintf(stderr, "unset: `%s': not a valid identifier\n", args[i]);
+            status = 1;
+            continue;
+        }
+        struct var *v = find(args[i], len);
+        if (v != NULL)
+        {
+            vars_unset(v);
+        }
+    }
+    return status;
+}
@@ -0,0 +1,52 @@
+// Shell variables
+// Every name is interned once in an open addressing table and never moves,
+// so the lexer resolves $NAME to its variable while it scans, and running
+// the command only reads the value. The environment given to commands is
+// built from the exported variables and kept until one of them changes.
+
+#ifndef VARS_H
+#define VARS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "arena.h"
+#include "parser.h"
+
+// import the environment the shell was started with, all exported
+void vars_init(char **envp);
+
+// the variable called name, created unset the first time
+struct var *vars_intern(const char *name, size_t len);
+
+// value of the variable, NULL when it is unset
+const char *var_value(const struct var *v);
+
+// value of the variable called name, NULL when it is unset, like getenv
+const char *vars_get(const char *name);
+
+void vars_set(struct var *v, const char *value);
+void vars_unset(struct var *v);
+void vars_export(struct var *v);
+
+// NULL terminated "NAME=value" list of the exported variables, valid until
+// one of them changes
+char **vars_environ(void);
+
+// the environment with the "NAME=value" entries put in, in the arena; the
+// strings themselves are shared, not copied
+char **vars_environ_with(struct arena *arena, char **entries, int count);
+
+// expand words into the fields of a command line: values outside quotes
+// are split at blanks, and such a word that ends up empty is dropped; a
+// field with wildcards is replaced by the file names it matches
+// returns the number of fields, *args is NULL terminated
+int vars_expand(struct arena *arena, const struct word *words, int count, char ***args);
+
+// a word expanded as one string, for assignments and redirection targets
+char *vars_expand_word(struct arena *arena, const struct word *w);
+
+// builtins: export [NAME[=value]...], unset NAME...
+int export_builtin(char **args);
+int unset_builtin(char **args);
+
+#endif